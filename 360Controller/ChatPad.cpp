@@ -23,24 +23,14 @@
 
 #include <IOKit/IOLib.h>
 #include "ChatPad.h"
-namespace HID_ChatPad {
-#include "chatpadhid.h"
-}
-#include "chatpadkeys.h"
+#include "chatpadkeyboard.h"
 #include "_60Controller.h"
 
 OSDefineMetaClassAndStructors(ChatPadKeyboardClass, IOHIDDevice)
 
 IOReturn ChatPadKeyboardClass::newReportDescriptor(IOMemoryDescriptor **descriptor) const
 {
-    IOBufferMemoryDescriptor *buffer;
-
-    buffer = IOBufferMemoryDescriptor::inTaskWithOptions(kernel_task, kIODirectionOut, sizeof(HID_ChatPad::ReportDescriptor));
-    if (buffer == NULL)
-		return kIOReturnNoResources;
-    buffer->writeBytes(0, HID_ChatPad::ReportDescriptor, sizeof(HID_ChatPad::ReportDescriptor));
-    *descriptor = buffer;
-    return kIOReturnSuccess;
+    return ChatPadNewReportDescriptor(descriptor);
 }
 
 IOReturn ChatPadKeyboardClass::setReport(IOMemoryDescriptor *report, IOHIDReportType reportType, IOOptionBits options)
@@ -56,34 +46,23 @@ IOReturn ChatPadKeyboardClass::getReport(IOMemoryDescriptor *report, IOHIDReport
 
 IOReturn ChatPadKeyboardClass::handleReport(IOMemoryDescriptor *report, IOHIDReportType reportType, IOOptionBits options)
 {
-	IOBufferMemoryDescriptor *realReport = OSDynamicCast(IOBufferMemoryDescriptor, report);
-	if (realReport != NULL)
-	{
-		unsigned char *data = (unsigned char*)realReport->getBytesNoCopy();
-		if (data[0] == 0x00)
-		{
-			for (int i = 2; i < 5; i++)
-			{
-				data[i] = ChatPad2USB(data[i]);
-			}
-		}
-	}
+	ChatPadTranslate(report);
 	return IOHIDDevice::handleReport(report, reportType, options);
 }
 
 OSNumber* ChatPadKeyboardClass::newPrimaryUsageNumber() const
 {
-    return OSNumber::withNumber(HID_ChatPad::ReportDescriptor[3], 8);
+    return ChatPadNewPrimaryUsageNumber();
 }
 
 OSNumber* ChatPadKeyboardClass::newPrimaryUsagePageNumber() const
 {
-    return OSNumber::withNumber(HID_ChatPad::ReportDescriptor[1], 8);
+    return ChatPadNewPrimaryUsagePageNumber();
 }
 
 OSString* ChatPadKeyboardClass::newProductString() const
 {
-    return OSString::withCString("ChatPad");
+    return ChatPadNewProductString();
 }
 
 OSString* ChatPadKeyboardClass::newTransportString() const
@@ -93,14 +72,12 @@ OSString* ChatPadKeyboardClass::newTransportString() const
 
 OSNumber* ChatPadKeyboardClass::newVendorIDNumber() const
 {
-	// Same as USB
-	return OSNumber::withNumber(100, 32);
+	return ChatPadNewVendorIDNumber();
 }
 
 OSNumber* ChatPadKeyboardClass::newProductIDNumber() const
 {
-	// Same as USB, plus one
-	return OSNumber::withNumber(100, 32);
+	return ChatPadNewProductIDNumber();
 }
 
 static IOHIDDevice* GetParent(const IOService *current)
@@ -122,29 +99,15 @@ bool ChatPadKeyboardClass::start(IOService *provider)
 
 OSString* ChatPadKeyboardClass::newManufacturerString() const
 {
-	IOHIDDevice *device = GetParent(this);
-	if (device == NULL)
-		return NULL;
-	return device->newManufacturerString();
+	return ChatPadNewManufacturerString(GetParent(this));
 }
 
 OSString* ChatPadKeyboardClass::newSerialNumberString() const
 {
-	IOHIDDevice *device = GetParent(this);
-	if (device == NULL)
-		return NULL;
-	return device->newSerialNumberString();
+	return ChatPadNewSerialNumberString(GetParent(this));
 }
 
 OSNumber* ChatPadKeyboardClass::newLocationIDNumber() const
 {
-	IOHIDDevice *device = GetParent(this);
-	if (device == NULL)
-		return NULL;
-	OSNumber *number = device->newLocationIDNumber();
-	if (number == NULL)
-		return NULL;
-	UInt32 value = number->unsigned32BitValue();
-	number->release();
-	return OSNumber::withNumber(value + 1, 32);
+	return ChatPadNewLocationIDNumber(GetParent(this), 1);
 }
@@ -0,0 +1,100 @@
+/*
+ MICE Xbox 360 Controller driver for Mac OS X
+ Copyright (C) 2006-2013 Colin Munro
+
+ chatpadkeyboard.cpp - parts of the ChatPad keyboard shared by the wired and wireless drivers
+
+ This file is part of Xbox360Controller.
+
+ Xbox360Controller is free software; you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation; either version 2 of the License, or
+ (at your option) any later version.
+
+ Xbox360Controller is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with Foobar; if not, write to the Free Software
+ Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include <IOKit/IOBufferMemoryDescriptor.h>
+#include "chatpadkeyboard.h"
+namespace HID_ChatPad {
+#include "chatpadhid.h"
+}
+#include "chatpadkeys.h"
+
+IOReturn ChatPadNewReportDescriptor(IOMemoryDescriptor **descriptor)
+{
+	IOBufferMemoryDescriptor *buffer;
+
+	buffer = IOBufferMemoryDescriptor::inTaskWithOptions(kernel_task, kIODirectionOut, sizeof(HID_ChatPad::ReportDescriptor));
+	if (buffer == NULL)
+		return kIOReturnNoResources;
+	buffer->writeBytes(0, HID_ChatPad::ReportDescriptor, sizeof(HID_ChatPad::ReportDescriptor));
+	*descriptor = buffer;
+	return kIOReturnSuccess;
+}
+
+// Turn the keys in a report into USB usages, in place
+void ChatPadTranslate(IOMemoryDescriptor *report)
+{
+	IOBufferMemoryDescriptor *realReport = OSDynamicCast(IOBufferMemoryDescriptor, report);
+	if (realReport != NULL)
+		ChatPadTranslateReport((unsigned char*)realReport->getBytesNoCopy(), (int)realReport->getLength());
+}
+
+OSNumber* ChatPadNewPrimaryUsageNumber(void)
+{
+	return OSNumber::withNumber(HID_ChatPad::ReportDescriptor[3], 8);
+}
+
+OSNumber* ChatPadNewPrimaryUsagePageNumber(void)
+{
+	return OSNumber::withNumber(HID_ChatPad::ReportDescriptor[1], 8);
+}
+
+OSNumber* ChatPadNewVendorIDNumber(void)
+{
+	return OSNumber::withNumber(CHATPAD_VENDOR_ID, 32);
+}
+
+OSNumber* ChatPadNewProductIDNumber(void)
+{
+	return OSNumber::withNumber(CHATPAD_PRODUCT_ID, 32);
+}
+
+OSString* ChatPadNewProductString(void)
+{
+	return OSString::withCString("ChatPad");
+}
+
+OSString* ChatPadNewManufacturerString(const IOHIDDevice *parent)
+{
+	if (parent == NULL)
+		return NULL;
+	return parent->newManufacturerString();
+}
+
+OSString* ChatPadNewSerialNumberString(const IOHIDDevice *parent)
+{
+	if (parent == NULL)
+		return NULL;
+	return parent->newSerialNumberString();
+}
+
+OSNumber* ChatPadNewLocationIDNumber(const IOHIDDevice *parent, UInt32 offset)
+{
+	if (parent == NULL)
+		return NULL;
+	OSNumber *number = parent->newLocationIDNumber();
+	if (number == NULL)
+		return NULL;
+	UInt32 value = number->unsigned32BitValue();
+	number->release();
+	return OSNumber::withNumber(value + offset, 32);
+}
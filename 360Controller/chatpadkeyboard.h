@@ -0,0 +1,41 @@
+/*
+ MICE Xbox 360 Controller driver for Mac OS X
+ Copyright (C) 2006-2013 Colin Munro
+
+ chatpadkeyboard.h - parts of the ChatPad keyboard shared by the wired and wireless drivers
+
+ This file is part of Xbox360Controller.
+
+ Xbox360Controller is free software; you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation; either version 2 of the License, or
+ (at your option) any later version.
+
+ Xbox360Controller is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with Foobar; if not, write to the Free Software
+ Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include <IOKit/hid/IOHIDDevice.h>
+
+// Each driver has its own keyboard class, as a class name can only be
+// registered by one kext, but they describe and translate reports the same way
+IOReturn ChatPadNewReportDescriptor(IOMemoryDescriptor **descriptor);
+void ChatPadTranslate(IOMemoryDescriptor *report);
+
+OSNumber* ChatPadNewPrimaryUsageNumber(void);
+OSNumber* ChatPadNewPrimaryUsagePageNumber(void);
+OSNumber* ChatPadNewVendorIDNumber(void);
+OSNumber* ChatPadNewProductIDNumber(void);
+OSString* ChatPadNewProductString(void);
+
+// The keyboard takes its strings from the controller it is attached to,
+// and sits at the controller's location plus offset
+OSString* ChatPadNewManufacturerString(const IOHIDDevice *parent);
+OSString* ChatPadNewSerialNumberString(const IOHIDDevice *parent);
+OSNumber* ChatPadNewLocationIDNumber(const IOHIDDevice *parent, UInt32 offset);
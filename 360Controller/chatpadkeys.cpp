@@ -51,3 +51,12 @@ unsigned char ChatPad2USB(unsigned char input)
 		return 0x00;
 	return columns[column].row[row];
 }
+
+// Turn a key report into the keyboard report the descriptor describes, in place
+void ChatPadTranslateReport(unsigned char *report, int length)
+{
+	if ((length < CHATPAD_REPORT_LENGTH) || (report[0] != 0x00))
+		return;
+	for (int i = 2; i < CHATPAD_REPORT_LENGTH; i++)
+		report[i] = ChatPad2USB(report[i]);
+}
@@ -21,4 +21,12 @@
  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
  */
 
+// A key report: a zero, the modifier bits, then up to three keys
+#define CHATPAD_REPORT_LENGTH	5
+
+// Shared by the wired and wireless ChatPad keyboards, which report as this device
+#define CHATPAD_VENDOR_ID		100
+#define CHATPAD_PRODUCT_ID		100
+
 unsigned char ChatPad2USB(unsigned char input);
+void ChatPadTranslateReport(unsigned char *report, int length);
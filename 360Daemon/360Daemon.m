@@ -133,6 +133,17 @@ static void ConfigureDevice(io_service_t object)
     }
 }
 
+// Slot the wireless receiver driver gave a controller (kIOWirelessSlot on its
+// WirelessDevice), or -1 for wired controllers and receivers without one
+static int GetWirelessSlot(io_service_t device)
+{
+    NSNumber *slot = CFBridgingRelease(IORegistryEntrySearchCFProperty(device, kIOServicePlane, CFSTR("WirelessSlot"), kCFAllocatorDefault, kIORegistryIterateRecursively | kIORegistryIterateParents));
+
+    if (![slot isKindOfClass:[NSNumber class]])
+        return -1;
+    return [slot intValue];
+}
+
 // Supported device - connecting - set settings?
 static void callbackConnected(void *param,io_iterator_t iterator)
 {
@@ -160,16 +171,25 @@ static void callbackConnected(void *param,io_iterator_t iterator)
             {
                 FFEFFESCAPE escape = {0};
                 unsigned char c;
-                int i;
+                int i, slot = GetWirelessSlot(object);
 
                 c = 0x0a;
-                if (serialNumber != nil)
+                if ((slot >= 0) && (slot < kDaemonLEDSlots))
+                {
+                    // Wireless controllers light the quadrant of their slot on the
+                    // receiver, and keep it while others come and go
+                    c = 0x06 + (slot % kDaemonLEDCount);
+                    if ((serialNumber != nil) && [leds serialNumberAtLEDIsBlank:slot])
+                        [leds setLED:slot toSerialNumber:serialNumber];
+                }
+                else if (serialNumber != nil)
                 {
-                    for (i = 0; i < 4; i++)
+                    for (i = 0; i < kDaemonLEDSlots; i++)
                     {
                         if ([leds serialNumberAtLEDIsBlank:i] || ([[leds serialNumberAtLED:i] caseInsensitiveCompare:serialNumber] == NSOrderedSame))
                         {
-                            c = 0x06 + i;
+                            // Slots beyond the fourth share the player LEDs in turn
+                            c = 0x06 + (i % kDaemonLEDCount);
                             if ([leds serialNumberAtLEDIsBlank:i]) {
                                 [leds setLED:i toSerialNumber:serialNumber];
                                 // NSLog(@"Added controller with LED %i", i);
@@ -235,7 +255,7 @@ static void callbackDisconnected(void *param, io_iterator_t iterator)
         serial = GetSerialNumber(object);
         if (serial != nil)
         {
-            for (i = 0; i < 4; i++)
+            for (i = 0; i < kDaemonLEDSlots; i++)
             {
                 if ([leds serialNumberAtLEDIsBlank:i])
                     continue;
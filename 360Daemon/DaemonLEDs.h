@@ -8,6 +8,10 @@
 
 #import <Foundation/Foundation.h>
 
+// Controllers tracked at once; the pads themselves only show four player LEDs
+#define kDaemonLEDSlots 16
+#define kDaemonLEDCount 4
+
 @interface DaemonLEDs : NSObject
 - (void)setLED:(int)theLED toSerialNumber:(NSString*)serialNum;
 - (NSString *)serialNumberAtLED:(int)theLED;
@@ -26,10 +26,12 @@
 #include "Feedback360.h"
 #include <mach/mach.h>
 #include <mach/mach_time.h>
+#include <unistd.h>
 using std::max;
 using std::min;
 
-#define LoopGranularity 10000 // Microseconds
+#define OutputInterval  4000  // Microseconds between motor reports at most
+#define OutputFull      0x10000 // Set in OutputMailbox while it holds unsent levels
 
 double CurrentTimeUsingMach()
 {
@@ -86,12 +88,9 @@ static IOForceFeedbackDeviceInterface functionMap360_IOForceFeedbackDeviceInterf
     &Feedback360::sStopEffect
 };
 
-Feedback360::Feedback360() : fRefCount(1),  EffectIndex(1), Stopped(true),
-Paused(false), PausedTime(0), LastTime(0), Gain(10000), PrvLeftLevel(0),
-PrvRightLevel(0), Actuator(true), Manual(false)
+Feedback360::Feedback360() : fRefCount(1), Engine(this), Manual(false),
+OutputMailbox(0), OutputScheduled(false), OutputClosed(false), OutputSent(0), OutputTime(0), OutputStats()
 {
-    EffectList = Feedback360EffectVector();
-
     iIOCFPlugInInterface.pseudoVTable = (IUnknownVTbl *) &functionMap360_IOCFPlugInInterface;
     iIOCFPlugInInterface.obj = this;
 
@@ -178,233 +177,27 @@ IOReturn Feedback360::Stop(void)
 
 HRESULT Feedback360::SetProperty(FFProperty property, void *value)
 {
-    if(property != FFPROP_FFGAIN) {
-        return FFERR_UNSUPPORTED;
-    }
-
-    UInt32 NewGain = *((UInt32*)value);
-    __block HRESULT Result = FF_OK;
-
-    dispatch_sync(Queue, ^{
-        if (1 <= NewGain && NewGain <= 10000)
-        {
-            Gain = NewGain;
-        } else {
-            Gain = max((UInt32)1, min(NewGain, (UInt32)10000));
-            Result = FF_TRUNCATED;
-        }
-    });
-
-    return Result;
+    return Engine.SetProperty(property, value);
 }
 
 HRESULT Feedback360::StartEffect(FFEffectDownloadID EffectHandle, FFEffectStartFlag Mode, UInt32 Count)
 {
-    dispatch_sync(Queue, ^{
-        for (Feedback360EffectIterator effectIterator = EffectList.begin() ; effectIterator != EffectList.end(); ++effectIterator)
-        {
-            if (effectIterator->Handle == EffectHandle)
-            {
-                effectIterator->Status  = FFEGES_PLAYING;
-                effectIterator->PlayCount = Count;
-                effectIterator->StartTime = CurrentTimeUsingMach();
-                Stopped = false;
-            } else {
-                if (Mode & FFES_SOLO) {
-                    effectIterator->Status = NULL;
-                }
-            }
-        }
-    });
-    return FF_OK;
+    return Engine.StartEffect(EffectHandle, Mode, Count);
 }
 
 HRESULT Feedback360::StopEffect(UInt32 EffectHandle)
 {
-    dispatch_sync(Queue, ^{
-        for (Feedback360EffectIterator effectIterator = EffectList.begin() ; effectIterator != EffectList.end(); ++effectIterator)
-        {
-            if (effectIterator->Handle == EffectHandle)
-            {
-                effectIterator->Status = NULL;
-                break;
-            }
-        }
-    });
-    return FF_OK;
+    return Engine.StopEffect(EffectHandle);
 }
 
 HRESULT Feedback360::DownloadEffect(CFUUIDRef EffectType, FFEffectDownloadID *EffectHandle, FFEFFECT *DiEffect, FFEffectParameterFlag Flags)
 {
-    __block HRESULT Result = FF_OK;
-
-    if (Flags & FFEP_NODOWNLOAD)
-    {
-        return FF_OK;
-    }
-
-    dispatch_sync(Queue, ^{
-        Feedback360Effect *Effect = NULL;
-        if (*EffectHandle == 0) {
-            EffectList.push_back(Feedback360Effect(EffectIndex++));
-            Effect = &(EffectList.back());
-            *EffectHandle = Effect->Handle;
-        } else {
-            for (LONG Index = 0; Index < EffectList.size(); Index++) {
-                if (EffectList[Index].Handle == *EffectHandle) {
-                    Effect = &(EffectList[Index]);
-                    break;
-                }
-            }
-        }
-
-        if (Effect == NULL || Result == -1) {
-            Result = FFERR_INTERNAL;
-        }
-        else {
-            Effect->Type = EffectType;
-            Effect->DiEffect.dwFlags = DiEffect->dwFlags;
-
-            if( Flags & FFEP_DURATION )
-            {
-                Effect->DiEffect.dwDuration = DiEffect->dwDuration;
-            }
-
-            if( Flags & FFEP_SAMPLEPERIOD )
-            {
-                Effect->DiEffect.dwSamplePeriod = DiEffect->dwSamplePeriod;
-            }
-
-            if( Flags & FFEP_GAIN )
-            {
-                Effect->DiEffect.dwGain = DiEffect->dwGain;
-            }
-
-            if( Flags & FFEP_TRIGGERBUTTON )
-            {
-                Effect->DiEffect.dwTriggerButton = DiEffect->dwTriggerButton;
-            }
-
-            if( Flags & FFEP_TRIGGERREPEATINTERVAL )
-            {
-                Effect->DiEffect.dwTriggerRepeatInterval = DiEffect->dwTriggerRepeatInterval;
-            }
-
-            if( Flags & FFEP_AXES )
-            {
-                Effect->DiEffect.cAxes  = DiEffect->cAxes;
-                Effect->DiEffect.rgdwAxes = NULL;
-            }
-
-            if( Flags & FFEP_DIRECTION )
-            {
-                Effect->DiEffect.cAxes   = DiEffect->cAxes;
-                Effect->DiEffect.rglDirection = NULL;
-            }
-
-            if( ( Flags & FFEP_ENVELOPE ) && DiEffect->lpEnvelope != NULL )
-            {
-                memcpy( &Effect->DiEnvelope, DiEffect->lpEnvelope, sizeof( FFENVELOPE ) );
-                if( Effect->DiEffect.dwDuration - Effect->DiEnvelope.dwFadeTime
-                   < Effect->DiEnvelope.dwAttackTime )
-                {
-                    Effect->DiEnvelope.dwFadeTime = Effect->DiEnvelope.dwAttackTime;
-                }
-                Effect->DiEffect.lpEnvelope = &Effect->DiEnvelope;
-            }
-
-            Effect->DiEffect.cbTypeSpecificParams = DiEffect->cbTypeSpecificParams;
-
-            if( Flags & FFEP_TYPESPECIFICPARAMS )
-            {
-                if(CFEqual(EffectType, kFFEffectType_CustomForce_ID)) {
-                    memcpy(
-                           &Effect->DiCustomForce
-                           ,DiEffect->lpvTypeSpecificParams
-                           ,DiEffect->cbTypeSpecificParams );
-                    Effect->DiEffect.lpvTypeSpecificParams = &Effect->DiCustomForce;
-                }
-
-                else if(CFEqual(EffectType, kFFEffectType_ConstantForce_ID)) {
-                    memcpy(
-                           &Effect->DiConstantForce
-                           ,DiEffect->lpvTypeSpecificParams
-                           ,DiEffect->cbTypeSpecificParams );
-                    Effect->DiEffect.lpvTypeSpecificParams = &Effect->DiConstantForce;
-                }
-                else if(CFEqual(EffectType, kFFEffectType_Square_ID) || CFEqual(EffectType, kFFEffectType_Sine_ID) || CFEqual(EffectType, kFFEffectType_Triangle_ID) || CFEqual(EffectType, kFFEffectType_SawtoothUp_ID) || CFEqual(EffectType, kFFEffectType_SawtoothDown_ID) ) {
-                    memcpy(
-                           &Effect->DiPeriodic
-                           ,DiEffect->lpvTypeSpecificParams
-                           ,DiEffect->cbTypeSpecificParams );
-                    Effect->DiEffect.lpvTypeSpecificParams = &Effect->DiPeriodic;
-                }
-                else if(CFEqual(EffectType, kFFEffectType_RampForce_ID)) {
-                    memcpy(
-                           &Effect->DiRampforce
-                           ,DiEffect->lpvTypeSpecificParams
-                           ,DiEffect->cbTypeSpecificParams );
-                    Effect->DiEffect.lpvTypeSpecificParams = &Effect->DiRampforce;
-                }
-            }
-
-            if( Flags & FFEP_STARTDELAY )
-            {
-                Effect->DiEffect.dwStartDelay = DiEffect->dwStartDelay;
-            }
-
-            if( Flags & FFEP_START )
-            {
-                Effect->Status  = FFEGES_PLAYING;
-                Effect->PlayCount = 1;
-                Effect->StartTime = CurrentTimeUsingMach();
-            }
-
-            if( Flags & FFEP_NORESTART )
-            {
-                ;
-            }
-            Result = FF_OK;
-        }
-    });
-    return Result;
+    return Engine.DownloadEffect(EffectType, EffectHandle, DiEffect, Flags);
 }
 
 HRESULT Feedback360::GetForceFeedbackState(ForceFeedbackDeviceState *DeviceState)
 {
-    if (DeviceState->dwSize != sizeof(FFDEVICESTATE))
-    {
-        return FFERR_INVALIDPARAM;
-    }
-
-    dispatch_sync(Queue, ^{
-        DeviceState->dwState = NULL;
-        if( EffectList.size() == 0 )
-        {
-            DeviceState->dwState |= FFGFFS_EMPTY;
-        }
-        if( Stopped == true )
-        {
-            DeviceState->dwState |= FFGFFS_STOPPED;
-        }
-        if( Paused == true )
-        {
-            DeviceState->dwState |= FFGFFS_PAUSED;
-        }
-        if (Actuator == true)
-        {
-            DeviceState->dwState |= FFGFFS_ACTUATORSON;
-        } else {
-            DeviceState->dwState |= FFGFFS_ACTUATORSOFF;
-        }
-        DeviceState->dwState |= FFGFFS_POWERON;
-        DeviceState->dwState |= FFGFFS_SAFETYSWITCHOFF;
-        DeviceState->dwState |= FFGFFS_USERFFSWITCHON;
-
-        DeviceState->dwLoad  = 0;
-    });
-
-    return FF_OK;
+    return Engine.GetForceFeedbackState(DeviceState);
 }
 
 HRESULT Feedback360::GetForceFeedbackCapabilities(FFCAPABILITIES *capabilities)
@@ -413,7 +206,7 @@ HRESULT Feedback360::GetForceFeedbackCapabilities(FFCAPABILITIES *capabilities)
     capabilities->ffSpecVer.minorAndBugRev=kFFPlugInAPIMinorAndBugRev;
     capabilities->ffSpecVer.stage=kFFPlugInAPIStage;
     capabilities->ffSpecVer.nonRelRev=kFFPlugInAPINonRelRev;
-    capabilities->supportedEffects=FFCAP_ET_CUSTOMFORCE|FFCAP_ET_CONSTANTFORCE|FFCAP_ET_RAMPFORCE|FFCAP_ET_SQUARE|FFCAP_ET_SINE|FFCAP_ET_TRIANGLE|FFCAP_ET_SAWTOOTHUP|FFCAP_ET_SAWTOOTHDOWN;
+    capabilities->supportedEffects=FFCAP_ET_CUSTOMFORCE|FFCAP_ET_CONSTANTFORCE|FFCAP_ET_RAMPFORCE|FFCAP_ET_SQUARE|FFCAP_ET_SINE|FFCAP_ET_TRIANGLE|FFCAP_ET_SAWTOOTHUP|FFCAP_ET_SAWTOOTHDOWN|FFCAP_ET_SPRING|FFCAP_ET_DAMPER|FFCAP_ET_INERTIA|FFCAP_ET_FRICTION;
     capabilities->emulatedEffects=0;
     capabilities->subType=FFCAP_ST_VIBRATION;
     capabilities->numFfAxes=2;
@@ -438,53 +231,7 @@ HRESULT Feedback360::GetForceFeedbackCapabilities(FFCAPABILITIES *capabilities)
 
 HRESULT Feedback360::SendForceFeedbackCommand(FFCommandFlag state)
 {
-    __block HRESULT Result = FF_OK;
-
-    dispatch_sync(Queue, ^{
-        switch (state) {
-            case FFSFFC_RESET:
-                EffectList.clear();
-                Stopped = true;
-                Paused = false;
-                break;
-
-            case FFSFFC_STOPALL:
-                for (Feedback360EffectIterator effectIterator = EffectList.begin() ; effectIterator != EffectList.end(); ++effectIterator)
-                {
-                    effectIterator->Status = NULL;
-                }
-                Stopped = true;
-                Paused = false;
-                break;
-
-            case FFSFFC_PAUSE:
-                Paused  = true;
-                PausedTime = CurrentTimeUsingMach();
-                break;
-
-            case FFSFFC_CONTINUE:
-                for (Feedback360EffectIterator effectIterator = EffectList.begin() ; effectIterator != EffectList.end(); ++effectIterator)
-                {
-                    effectIterator->StartTime += ( CurrentTimeUsingMach() - PausedTime );
-                }
-                Paused = false;
-                break;
-
-            case FFSFFC_SETACTUATORSON:
-                Actuator = true;
-                break;
-
-            case FFSFFC_SETACTUATORSOFF:
-                Actuator = false;
-                break;
-
-            default:
-                Result = FFERR_INVALIDPARAM;
-                break;
-        }
-    });
-    //return Result;
-    return FF_OK;
+    return Engine.SendForceFeedbackCommand(state);
 }
 
 HRESULT Feedback360::InitializeTerminate(NumVersion APIversion, io_object_t hidDevice, boolean_t begin)
@@ -507,18 +254,23 @@ HRESULT Feedback360::InitializeTerminate(NumVersion APIversion, io_object_t hidD
             // fprintf(stderr,"Feedback: Failed to initialise\n");
             return FFERR_NOINTERFACE;
         }
-        Queue = dispatch_queue_create("com.mice.driver.Feedback360", NULL);
-        Timer = dispatch_source_create(DISPATCH_SOURCE_TYPE_TIMER, 0, 0, Queue);
-        dispatch_source_set_timer(Timer, dispatch_walltime(NULL, 0), LoopGranularity*1000, 10);
-        dispatch_set_context(Timer, this);
-        dispatch_source_set_event_handler_f(Timer, EffectProc);
-        dispatch_resume(Timer);
+        OutputQueue = dispatch_queue_create("com.mice.driver.Feedback360.output", NULL);
+        OutputDelayed = dispatch_group_create();
+        Engine.Start("com.mice.driver.Feedback360");
     }
     else {
-        dispatch_sync(Queue, ^{
-            dispatch_source_cancel(Timer);
-            SetForce(0, 0);
-            Device_Finalise(&this->device);
+        Engine.Terminate(^{
+            // Waits for anything already headed for the device
+            dispatch_sync(OutputQueue, ^{
+                if (!Manual) {
+                    unsigned char buf[] = {0x00, 0x04, 0x00, 0x00};
+                    Device_Send(&this->device, buf, sizeof(buf));
+                }
+                Device_Finalise(&this->device);
+                OutputClosed = true;
+            });
+            // A pass put off by the rate limit still holds this object
+            dispatch_group_wait(OutputDelayed, DISPATCH_TIME_FOREVER);
         });
 
     }
@@ -527,50 +279,46 @@ HRESULT Feedback360::InitializeTerminate(NumVersion APIversion, io_object_t hidD
 
 HRESULT Feedback360::DestroyEffect(FFEffectDownloadID EffectHandle)
 {
-    __block HRESULT Result = FF_OK;
-    dispatch_sync(Queue, ^{
-        for (Feedback360EffectIterator effectIterator = EffectList.begin() ; effectIterator != EffectList.end(); ++effectIterator)
-        {
-            if (effectIterator->Handle == EffectHandle)
-            {
-                EffectList.erase(effectIterator);
-                break;
-            }
-        }
-    });
-    return Result;
+    return Engine.DestroyEffect(EffectHandle);
 }
 
 HRESULT Feedback360::Escape(FFEffectDownloadID downloadID, FFEFFESCAPE *escape)
 {
-    if (downloadID!=0) return FFERR_UNSUPPORTED;
     if (escape->dwSize < sizeof(FFEFFESCAPE)) return FFERR_INVALIDPARAM;
+    if (downloadID!=0) return Engine.EffectEscape(downloadID, escape);
+    // Room the caller left for output, cbOutBuffer then says how much was used
+    DWORD OutSize = escape->cbOutBuffer;
     escape->cbOutBuffer=0;
     switch (escape->dwCommand) {
         case 0x00:  // Control motors
             if(escape->cbInBuffer!=1) return FFERR_INVALIDPARAM;
-            dispatch_sync(Queue, ^{
-                Manual=((unsigned char*)escape->lpvInBuffer)[0]!=0x00;
+        {
+            bool NewManual=((unsigned char*)escape->lpvInBuffer)[0]!=0x00;
+            Engine.Run(^{
+                Manual=NewManual;
             });
+        }
             break;
 
         case 0x01:  // Set motors
             if (escape->cbInBuffer!=2) return FFERR_INVALIDPARAM;
-            dispatch_sync(Queue, ^{
+        {
+            unsigned char *data=(unsigned char *)escape->lpvInBuffer;
+            unsigned char left=data[0], right=data[1];
+            Engine.Run(^{
                 if(Manual) {
-                    unsigned char *data=(unsigned char *)escape->lpvInBuffer;
-                    unsigned char buf[]={0x00,0x04,data[0],data[1]};
-                    Device_Send(&this->device,buf,sizeof(buf));
+                    PostLevels(left, right);
                 }
             });
+        }
             break;
 
         case 0x02:  // Set LED
             if (escape->cbInBuffer!=1) return FFERR_INVALIDPARAM;
         {
-            dispatch_sync(Queue, ^{
-                unsigned char *data=(unsigned char *)escape->lpvInBuffer;
-                unsigned char buf[]={0x01,0x03,data[0]};
+            unsigned char led=((unsigned char *)escape->lpvInBuffer)[0];
+            dispatch_async(OutputQueue, ^{
+                unsigned char buf[]={0x01,0x03,led};
                 Device_Send(&this->device,buf,sizeof(buf));
             });
         }
@@ -578,13 +326,51 @@ HRESULT Feedback360::Escape(FFEffectDownloadID downloadID, FFEFFESCAPE *escape)
 
         case 0x03:  // Power off
         {
-            dispatch_sync(Queue, ^{
+            dispatch_async(OutputQueue, ^{
                 unsigned char buf[] = {0x02, 0x02};
                 Device_Send(&this->device, buf, sizeof(buf));
             });
         }
             break;
 
+        case 0x04:  // Set tick period, in microseconds
+            if (escape->cbInBuffer!=sizeof(UInt32)) return FFERR_INVALIDPARAM;
+            Engine.SetTickPeriod(*(UInt32 *)escape->lpvInBuffer);
+            break;
+
+        case 0x05:  // Get motor output statistics
+        {
+            if (escape->lpvOutBuffer == NULL || OutSize < sizeof(Feedback360OutputStats)) return FFERR_INVALIDPARAM;
+            Feedback360OutputStats *Stats = (Feedback360OutputStats *)escape->lpvOutBuffer;
+            Stats->Sent = OutputStats.Sent;
+            Stats->Deduplicated = OutputStats.Deduplicated;
+            Stats->Dropped = OutputStats.Dropped;
+            Stats->Errors = OutputStats.Errors;
+            Stats->LastLatency = OutputStats.LastLatency;
+            Stats->MaxLatency = OutputStats.MaxLatency;
+            escape->cbOutBuffer = sizeof(Feedback360OutputStats);
+        }
+            break;
+
+        case 0x06:  // Set mixer knee, 0 to 10000
+            if (escape->cbInBuffer!=sizeof(UInt32)) return FFERR_INVALIDPARAM;
+            Engine.SetKnee((LONG)min(*(UInt32 *)escape->lpvInBuffer, (UInt32)LEVEL_MAX));
+            break;
+
+        case 0x07:  // Set motor response curve
+            if (escape->cbInBuffer!=sizeof(Feedback360Curve)) return FFERR_INVALIDPARAM;
+            return Engine.SetCurve((Feedback360Curve *)escape->lpvInBuffer);
+
+        case 0x08:  // Get effect loop statistics
+            if (escape->lpvOutBuffer == NULL || OutSize < sizeof(Feedback360EngineStats)) return FFERR_INVALIDPARAM;
+            Engine.GetStats((Feedback360EngineStats *)escape->lpvOutBuffer);
+            escape->cbOutBuffer = sizeof(Feedback360EngineStats);
+            break;
+
+        case 0x09:  // Log effect loop statistics
+            Engine.LogStats("Xbox360Controller FF plugin");
+            break;
+
         default:
             fprintf(stderr, "Xbox360Controller FF plugin: Unknown escape (%i)\n", (int)escape->dwCommand);
             return FFERR_UNSUPPORTED;
@@ -592,55 +378,105 @@ HRESULT Feedback360::Escape(FFEffectDownloadID downloadID, FFEFFESCAPE *escape)
     return FF_OK;
 }
 
-void Feedback360::SetForce(LONG LeftLevel, LONG RightLevel)
+void Feedback360::SetForce(const LONG *Levels)
 {
-    //fprintf(stderr, "LS: %d; RS: %d\n", (unsigned char)MIN( 255, LeftLevel * Gain / 10000 ), (unsigned char)MIN( 255, RightLevel * Gain / 10000 ));
-    unsigned char buf[] = {0x00, 0x04, (unsigned char)min(SCALE_MAX, LeftLevel * (LONG)Gain / 10000 ), (unsigned char)min(SCALE_MAX, RightLevel * (LONG)Gain / 10000 )};
-    if (!Manual) Device_Send(&device, buf, sizeof(buf));
+    //fprintf(stderr, "LS: %d; RS: %d\n", Levels[0], Levels[1]);
+    if (!Manual) PostLevels((unsigned char)Levels[0], (unsigned char)Levels[1]);
 }
 
-void Feedback360::EffectProc( void *params )
+double Feedback360::SetPulse(const LONG *Levels, double On, double Off, double Duration)
+{
+    // The 360 pad has no timed rumble, the levels stay until the next report
+    return 0;
+}
+
+bool Feedback360::ReadStick(SInt32 *X, SInt32 *Y)
+{
+    return Device_ReadAxes(&device, X, Y);
+}
+
+bool Feedback360::ReadButtons(UInt32 *Buttons)
+{
+    return Device_ReadButtons(&device, Buttons);
+}
+
+//----------------------------------------------------------------------------------------------
+// PostLevels
+//----------------------------------------------------------------------------------------------
+void Feedback360::PostLevels(unsigned char LeftLevel, unsigned char RightLevel)
+{
+    // Only the newest levels matter, so they replace whatever has not been sent yet
+    if (OutputMailbox.exchange(OutputFull | (LeftLevel << 8) | RightLevel) & OutputFull)
+    {
+        OutputStats.Dropped++;
+    }
+    if (!OutputScheduled.exchange(true))
+    {
+        dispatch_async_f(OutputQueue, this, OutputProc);
+    }
+}
+
+//----------------------------------------------------------------------------------------------
+// OutputProc
+//----------------------------------------------------------------------------------------------
+void Feedback360::OutputProc(void *params)
 {
     Feedback360 *cThis = (Feedback360 *)params;
+    if (cThis->OutputClosed)
+    {
+        return;
+    }
 
-    LONG LeftLevel = 0;
-    LONG RightLevel = 0;
-    LONG Gain  = cThis->Gain;
-    LONG CalcResult = 0;
+    // Keep the report rate down by coming back later, rather than holding the queue
+    double Wait = cThis->OutputTime + OutputInterval / 1000000. - cThis->Engine.Clock();
+    if (Wait > 0)
+    {
+        dispatch_group_enter(cThis->OutputDelayed);
+        dispatch_after(dispatch_time(DISPATCH_TIME_NOW, (int64_t)(Wait * NSEC_PER_SEC)), cThis->OutputQueue, ^{
+            OutputProc(cThis);
+            dispatch_group_leave(cThis->OutputDelayed);
+        });
+        return;
+    }
 
-    if (cThis->Actuator == true)
+    // Cleared first, so levels posted from here on get a pass of their own
+    cThis->OutputScheduled = false;
+    UInt32 Levels = cThis->OutputMailbox.exchange(0);
+    if (!(Levels & OutputFull))
     {
-        for (Feedback360EffectIterator effectIterator = cThis->EffectList.begin(); effectIterator != cThis->EffectList.end(); ++effectIterator)
-        {
-            if(((CurrentTimeUsingMach() - cThis->LastTime)*1000*1000) >= effectIterator->DiEffect.dwSamplePeriod) {
-                CalcResult = effectIterator->Calc(&LeftLevel, &RightLevel);
-            }
-        }
+        return;
+    }
+    Levels &= 0xffff;
+    if (Levels == cThis->OutputSent)
+    {
+        cThis->OutputStats.Deduplicated++;
+        return;
     }
 
-    if ((cThis->PrvLeftLevel != LeftLevel || cThis->PrvRightLevel != RightLevel) && (CalcResult != -1))
+    unsigned char buf[] = {0x00, 0x04, (unsigned char)(Levels >> 8), (unsigned char)(Levels & 0xff)};
+    double Start = cThis->Engine.Clock();
+    if (Device_Send(&cThis->device, buf, sizeof(buf)))
     {
-        //fprintf(stderr, "PL: %d, PR: %d; L: %d, R: %d; \n", cThis->PrvLeftLevel, cThis->PrvRightLevel, LeftLevel, RightLevel);
-        cThis->SetForce((unsigned char)min(SCALE_MAX, LeftLevel * Gain / 10000),(unsigned char)min(SCALE_MAX, RightLevel * Gain / 10000 ));
+        cThis->OutputSent = Levels;
+        cThis->OutputStats.Sent++;
+    }
+    else
+    {
+        cThis->OutputStats.Errors++;
+    }
+    cThis->OutputTime = cThis->Engine.Clock();
 
-        cThis->PrvLeftLevel = LeftLevel;
-        cThis->PrvRightLevel = RightLevel;
+    UInt32 Latency = (UInt32)((cThis->OutputTime - Start) * 1000000);
+    cThis->OutputStats.LastLatency = Latency;
+    if (Latency > cThis->OutputStats.MaxLatency)
+    {
+        cThis->OutputStats.MaxLatency = Latency;
     }
 }
 
 HRESULT Feedback360::GetEffectStatus(FFEffectDownloadID EffectHandle, FFEffectStatusFlag *Status)
 {
-    dispatch_sync(Queue, ^{
-        for (Feedback360EffectIterator effectIterator = EffectList.begin() ; effectIterator != EffectList.end(); ++effectIterator)
-        {
-            if (effectIterator->Handle == EffectHandle)
-            {
-                *Status = effectIterator->Status;
-                break;
-            }
-        }
-    });
-    return FF_OK;
+    return Engine.GetEffectStatus(EffectHandle, Status);
 }
 
 HRESULT Feedback360::GetVersion(ForceFeedbackVersion *version)
@@ -28,16 +28,29 @@
 
 #include <ForceFeedback/IOForceFeedbackLib.h>
 #include <IOKit/IOCFPlugIn.h>
-#include <vector>
+#include <atomic>
 
 #include "devlink.h"
 #include "Feedback360Effect.h"
+#include "Feedback360Engine.h"
 
 #define FeedbackDriverVersionMajor      1
 #define FeedbackDriverVersionMinor      0
 #define FeedbackDriverVersionStage      developStage
 #define FeedbackDriverVersionNonRelRev  0
 
+#define SCALE_MAX (LONG)255
+
+// Returned by escape 0x05, latencies are in microseconds
+typedef struct {
+    UInt32  Sent;
+    UInt32  Deduplicated;   // Same levels as already on the device
+    UInt32  Dropped;        // Replaced by newer levels before they were sent
+    UInt32  Errors;
+    UInt32  LastLatency;
+    UInt32  MaxLatency;
+} Feedback360OutputStats;
+
 class Feedback360 : IUnknown
 {
 public:
@@ -89,8 +102,9 @@ public:
     virtual ULONG   Release(void);
 
 private:
-    typedef std::vector<Feedback360Effect> Feedback360EffectVector;
-    typedef Feedback360EffectVector::iterator Feedback360EffectIterator;
+    // Two rumble motors, left and right
+    typedef Feedback360Engine<Feedback360, 2, SCALE_MAX> Feedback360EffectEngine;
+    friend class Feedback360EngineCore<Feedback360, 2, SCALE_MAX>;
     // helper function
     static inline Feedback360 *getThis (void *self) { return (Feedback360 *) ((Xbox360InterfaceMap *) self)->obj; }
 
@@ -99,29 +113,38 @@ private:
     Xbox360InterfaceMap iIOForceFeedbackDeviceInterface;
     DeviceLink          device;
 
-    // GCD queue and timer
-    dispatch_queue_t    Queue;
-    dispatch_source_t   Timer;
+    // Motor levels wait in the mailbox for OutputProc, which sends them on
+    // OutputQueue so a slow transfer never holds up the effect loop
+    dispatch_queue_t    OutputQueue;
+    std::atomic<UInt32> OutputMailbox;
+    std::atomic<bool>   OutputScheduled;
+    dispatch_group_t    OutputDelayed;
+    bool                OutputClosed;
+    UInt32              OutputSent;
+    double              OutputTime;
+    struct {
+        std::atomic<UInt32> Sent;
+        std::atomic<UInt32> Deduplicated;
+        std::atomic<UInt32> Dropped;
+        std::atomic<UInt32> Errors;
+        std::atomic<UInt32> LastLatency;
+        std::atomic<UInt32> MaxLatency;
+    } OutputStats;
 
     // effects handling
-    Feedback360EffectVector EffectList;
-    UInt32              EffectIndex;
-
-    DWORD   Gain;
-    bool    Actuator;
+    Feedback360EffectEngine Engine;
 
-    LONG            PrvLeftLevel, PrvRightLevel;
-    bool            Stopped;
-    bool            Paused;
     bool            Manual;
-    double          LastTime;
-    double          PausedTime;
     CFUUIDRef       FactoryID;
 
-    void            SetForce(LONG LeftLevel, LONG RightLevel);
+    // Called by Engine on its queue
+    void            SetForce(const LONG *Levels);
+    double          SetPulse(const LONG *Levels, double On, double Off, double Duration);
+    bool            ReadStick(SInt32 *X, SInt32 *Y);
+    bool            ReadButtons(UInt32 *Buttons);
 
-    // event loop func
-    static void EffectProc( void *params );
+    void            PostLevels(unsigned char LeftLevel, unsigned char RightLevel);
+    static void     OutputProc(void *params);
 
     // actual member functions ultimately called by the FF API (through the static functions)
     virtual IOReturn Probe ( CFDictionaryRef propertyTable, io_service_t service, SInt32 * order );
@@ -24,15 +24,17 @@
 */
 
 #include "Feedback360Effect.h"
+#include "Feedback360Waveform.h"
 using std::max;
 using std::min;
 
 //----------------------------------------------------------------------------------------------
 // CEffect
 //----------------------------------------------------------------------------------------------
-Feedback360Effect::Feedback360Effect() : Type(NULL), Status(0), PlayCount(0),
-StartTime(0), Index(0), LastTime(0), Handle(0), DiEffect({0}), DiEnvelope({0}),
-DiCustomForce({0}), DiConstantForce({0}), DiPeriodic({0}), DiRampforce({0})
+Feedback360Effect::Feedback360Effect() : Type(NULL), Kind(-1), Handle(0), DiEffect(), DiEnvelope(),
+DiConstantForce(), DiCustomForce(), DiPeriodic(), DiRampforce(), DiCondition(), ConditionCount(0),
+Status(0), PlayCount(0), StartTime(0), LastTime(0), HeldStart(-1), Held(), Index(0), TriggerTime(0), Streaming(false),
+PhasePeriod(1), PhaseStep(0), PhaseOffset(0), Phase(0), PhasePos(0), PhaseStart(-1)
 {
 
 }
@@ -42,90 +44,351 @@ Feedback360Effect::Feedback360Effect(FFEffectDownloadID theHand) : Feedback360Ef
     Handle = theHand;
 }
 
-Feedback360Effect::Feedback360Effect(const Feedback360Effect &src) : Type(src.Type),
-Handle(src.Handle), Status(src.Status), PlayCount(src.PlayCount),
-StartTime(src.StartTime), Index(src.Index), LastTime(src.LastTime)
+Feedback360Effect::Feedback360Effect(const Feedback360Effect &src) : Type(src.Type), Kind(src.Kind), Handle(src.Handle),
+DiEffect(src.DiEffect), DiEnvelope(src.DiEnvelope), DiConstantForce(src.DiConstantForce), DiCustomForce(src.DiCustomForce),
+DiPeriodic(src.DiPeriodic), DiRampforce(src.DiRampforce), ConditionCount(src.ConditionCount),
+Status(src.Status), PlayCount(src.PlayCount), StartTime(src.StartTime), LastTime(src.LastTime), HeldStart(src.HeldStart),
+Index(src.Index), TriggerTime(src.TriggerTime), Samples(src.Samples), Streaming(src.Streaming),
+PhasePeriod(src.PhasePeriod), PhaseStep(src.PhaseStep), PhaseOffset(src.PhaseOffset),
+Phase(src.Phase), PhasePos(src.PhasePos), PhaseStart(src.PhaseStart)
 {
-    memcpy(&DiEffect, &src.DiEffect, sizeof(FFEFFECT));
-    memcpy(&DiEnvelope, &src.DiEnvelope, sizeof(FFENVELOPE));
-    memcpy(&DiCustomForce, &src.DiCustomForce, sizeof(FFCUSTOMFORCE));
-    memcpy(&DiConstantForce, &src.DiConstantForce, sizeof(FFCONSTANTFORCE));
-    memcpy(&DiPeriodic, &src.DiPeriodic, sizeof(FFPERIODIC));
-    memcpy(&DiRampforce, &src.DiRampforce, sizeof(FFRAMPFORCE));
+    memcpy(DiCondition, src.DiCondition, sizeof(DiCondition));
+    memcpy(Held, src.Held, sizeof(Held));
 }
 
 //----------------------------------------------------------------------------------------------
-// Calc
+// CopySamples
+//----------------------------------------------------------------------------------------------
+void Feedback360Effect::CopySamples(const LONG *Data, DWORD Count, std::vector<int16_t> *Samples)
+{
+    Samples->resize(Count);
+    for (DWORD i = 0; i < Count; i++)
+    {
+        (*Samples)[i] = (int16_t)max( (LONG)-10000, min( Data[i], (LONG)10000 ) );
+    }
+}
+
+//----------------------------------------------------------------------------------------------
+// SetSamples
+//----------------------------------------------------------------------------------------------
+void Feedback360Effect::SetSamples(std::vector<int16_t> &NewSamples)
+{
+    Samples.swap(NewSamples);
+    Streaming = false;
+    Index = 0;
+    DiCustomForce.cSamples = (DWORD)Samples.size();
+    DiCustomForce.rglForceData = NULL;
+}
+
+//----------------------------------------------------------------------------------------------
+// AppendSamples
+//----------------------------------------------------------------------------------------------
+void Feedback360Effect::AppendSamples(const std::vector<int16_t> &NewSamples)
+{
+    // Only whole frames, anything else would swap the channels from here on
+    if (NewSamples.size() % max( (DWORD)1, DiCustomForce.cChannels ) != 0)
+    {
+        return;
+    }
+
+    // Anything already downloaded now plays once, from wherever it has got to
+    Streaming = true;
+    Samples.insert(Samples.end(), NewSamples.begin(), NewSamples.end());
+    DiCustomForce.cSamples = (DWORD)Samples.size();
+}
+
+//----------------------------------------------------------------------------------------------
+// PreparePhase
+//----------------------------------------------------------------------------------------------
+void Feedback360Effect::PreparePhase()
+{
+    PhasePeriod = max( (DWORD)1, ( DiPeriodic.dwPeriod / 1000 ) );
+    PhaseStep = WavePhaseStep(PhasePeriod);
+    PhaseOffset = WavePhaseOffset(DiPeriodic.dwPhase);
+    PhaseStart = -1;
+}
+
+//----------------------------------------------------------------------------------------------
+// AdvancePhase
+//----------------------------------------------------------------------------------------------
+uint32_t Feedback360Effect::AdvancePhase(ULONG CurrentPos)
+{
+    // Only work the phase out from scratch when playback starts or loops
+    if (PhaseStart != StartTime || CurrentPos < PhasePos)
+    {
+        Phase = WavePhase(CurrentPos, PhasePeriod);
+    }
+    else
+    {
+        Phase += (CurrentPos - PhasePos) * PhaseStep;
+    }
+    PhaseStart = StartTime;
+    PhasePos = CurrentPos;
+    return Phase + PhaseOffset;
+}
+
+//----------------------------------------------------------------------------------------------
+// CalcTimes
 //----------------------------------------------------------------------------------------------
-LONG Feedback360Effect::Calc(LONG *LeftLevel, LONG *RightLevel)
+void Feedback360Effect::CalcTimes(CFTimeInterval *Duration, double *BeginTime, double *EndTime)
 {
-    CFTimeInterval Duration = 0;
     if(DiEffect.dwDuration != FF_INFINITE) {
-        Duration = max(1., DiEffect.dwDuration / 1000.) / 1000.;
+        *Duration = max(1., DiEffect.dwDuration / 1000.) / 1000.;
     } else {
-        Duration = DBL_MAX;
+        *Duration = DBL_MAX;
     }
-    double BeginTime = StartTime + ( DiEffect.dwStartDelay / 1000. / 1000.);
-    double EndTime  = DBL_MAX;
-    if (PlayCount != -1)
+    *BeginTime = StartTime + ( DiEffect.dwStartDelay / 1000. / 1000.);
+    *EndTime  = DBL_MAX;
+    if (PlayCount != FF_INFINITE)
     {
-        EndTime = BeginTime + Duration * PlayCount;
+        *EndTime = *BeginTime + *Duration * PlayCount;
     }
-    double CurrentTime = CurrentTimeUsingMach();
+}
 
-    if (Status == FFEGES_PLAYING && BeginTime <= CurrentTime && CurrentTime <= EndTime)
+//----------------------------------------------------------------------------------------------
+// NextTime
+//----------------------------------------------------------------------------------------------
+double Feedback360Effect::NextTime(double CurrentTime, double Step)
+{
+    if (Status != FFEGES_PLAYING)
     {
-        // Used for force calculation
-        LONG NormalLevel;
-        LONG WorkLeftLevel;
-        LONG WorkRightLevel;
-
-        // Used for envelope calculation
-        LONG NormalRate;
-        LONG AttackLevel;
-        LONG FadeLevel;
-
-        CalcEnvelope((ULONG)(Duration*1000)
-                     ,(ULONG)(fmod(CurrentTime - BeginTime, Duration)*1000)
-                     ,&NormalRate
-                     ,&AttackLevel
-                     ,&FadeLevel);
-
-        // CustomForce allows setting each channel separately
-        if(CFEqual(Type, kFFEffectType_CustomForce_ID)) {
-            if((CurrentTimeUsingMach() - LastTime)*1000*1000 < DiCustomForce.dwSamplePeriod) {
-                return -1;
-            }
-            else {
-                WorkLeftLevel = ((DiCustomForce.rglForceData[2*Index] * NormalRate + AttackLevel + FadeLevel) / 100) * DiEffect.dwGain / 10000;
-                WorkRightLevel = ((DiCustomForce.rglForceData[2*Index + 1] * NormalRate + AttackLevel + FadeLevel) / 100) * DiEffect.dwGain / 10000;
-                //fprintf(stderr, "L:%d; R:%d\n", WorkLeftLevel, WorkRightLevel);
-                Index = (Index + 1) % (DiCustomForce.cSamples/2);
-                LastTime = CurrentTimeUsingMach();
-            }
+        return DBL_MAX;
+    }
+
+    CFTimeInterval Duration;
+    double BeginTime;
+    double EndTime;
+    CalcTimes(&Duration, &BeginTime, &EndTime);
+
+    if (EndTime < CurrentTime)
+    {
+        // Finished, Calc has already stopped contributing to the output
+        Status = 0;
+        return DBL_MAX;
+    }
+    if (CurrentTime < BeginTime)
+    {
+        return BeginTime;
+    }
+    if (Kind != CONSTANT_FORCE && Kind != SQUARE)
+    {
+        return CurrentTime;
+    }
+
+    // A constant force only changes during its envelope edges and when it
+    // ends, a square wave at its own edges as well
+    double Position = fmod(CurrentTime - BeginTime, Duration);
+    double CycleStart = CurrentTime - Position;
+    double Until = EndTime;
+    double AttackTime;
+    double FadeTime;
+    if (EdgeTimes(&AttackTime, &FadeTime))
+    {
+        if (Position < AttackTime)
+        {
+            Until = min(CurrentTime + Step, CycleStart + AttackTime);
+        }
+        else if (Duration - FadeTime <= Position)
+        {
+            Until = min(CurrentTime + Step, min(CycleStart + Duration, EndTime));
         }
-        // Regular commands treat controller as a single output (both channels are together as one)
-        else {
-            CalcForce(
-                      (ULONG)(Duration*1000)
-                      ,(ULONG)(fmod(CurrentTime - BeginTime, Duration)*1000)
-                      ,NormalRate
-                      ,AttackLevel
-                      ,FadeLevel
-                      ,&NormalLevel );
-            //fprintf(stderr, "DeltaT %f\n", CurrentTime - BeginTime);
-            //fprintf(stderr, "Duration %f; NormalRate: %d; AttackLevel: %d; FadeLevel: %d\n", Duration, NormalRate, AttackLevel, FadeLevel);
-
-            WorkLeftLevel = (NormalLevel > 0) ? NormalLevel : -NormalLevel;
-            WorkRightLevel = (NormalLevel > 0) ? NormalLevel : -NormalLevel;
+        else
+        {
+            Until = min(CycleStart + Duration - FadeTime, EndTime);
         }
-        WorkLeftLevel = min( SCALE_MAX, WorkLeftLevel * SCALE_MAX / 10000 );
-        WorkRightLevel = min( SCALE_MAX, WorkRightLevel * SCALE_MAX / 10000 );
+    }
+    if (Kind == SQUARE)
+    {
+        // The phase starts over with each iteration
+        Until = min(Until, min(CycleStart + Duration, SquareEdge(CurrentTime, Position)));
+    }
+    return Until;
+}
+
+//----------------------------------------------------------------------------------------------
+// SquareTrain
+//----------------------------------------------------------------------------------------------
+bool Feedback360Effect::SquareTrain(double CurrentTime, LONG *OtherLevel, double *Half, double *Left, double *Until)
+{
+    if (Kind != SQUARE || Status != FFEGES_PLAYING)
+    {
+        return false;
+    }
+
+    CFTimeInterval Duration;
+    double BeginTime;
+    double EndTime;
+    CalcTimes(&Duration, &BeginTime, &EndTime);
+    if (CurrentTime < BeginTime || EndTime < CurrentTime)
+    {
+        return false;
+    }
+
+    double Position = fmod(CurrentTime - BeginTime, Duration);
+    double CycleStart = CurrentTime - Position;
+    double SustainEnd = min(CycleStart + Duration, EndTime);
+    double AttackTime;
+    double FadeTime;
+    if (EdgeTimes(&AttackTime, &FadeTime))
+    {
+        if (Position < AttackTime || Duration - FadeTime <= Position)
+        {
+            return false;
+        }
+        SustainEnd = min(CycleStart + Duration - FadeTime, EndTime);
+    }
+    double Edge = SquareEdge(CurrentTime, Position);
+    if (Edge <= CurrentTime)
+    {
+        return false;
+    }
+
+    // As CalcForce works it out when the envelope is at full level
+    int32_t Wave = -WaveSquare(Phase + PhaseOffset);
+    LONG Magnitude = (LONG)(((int64_t)DiPeriodic.dwMagnitude * Wave) / WAVE_ONE) + DiPeriodic.lOffset;
+    Magnitude = Magnitude * (LONG)DiEffect.dwGain / 10000;
+
+    *OtherLevel = min( LEVEL_MAX, (Magnitude > 0) ? Magnitude : -Magnitude );
+    *Half = PhasePeriod / 2000.;
+    *Left = Edge - CurrentTime;
+    *Until = SustainEnd;
+    return true;
+}
+
+//----------------------------------------------------------------------------------------------
+// EdgeTimes
+//----------------------------------------------------------------------------------------------
+bool Feedback360Effect::EdgeTimes(double *AttackTime, double *FadeTime)
+{
+    if( ( DiEffect.dwFlags & FFEP_ENVELOPE ) && DiEffect.lpEnvelope != NULL )
+    {
+        // In whole milliseconds, as CalcEnvelope uses them
+        *AttackTime = max( (DWORD)1, DiEnvelope.dwAttackTime / 1000 ) / 1000.;
+        *FadeTime = max( (DWORD)1, DiEnvelope.dwFadeTime / 1000 ) / 1000.;
+        return true;
+    }
+    return false;
+}
+
+//----------------------------------------------------------------------------------------------
+// SquareEdge
+//----------------------------------------------------------------------------------------------
+double Feedback360Effect::SquareEdge(double CurrentTime, double Position)
+{
+    // Worked out from the phase Calc reached at CurrentTime, stepped the way
+    // AdvancePhase will step it, so the edge lands where Calc will see it
+    ULONG CurrentPos = (ULONG)(Position * 1000);
+    if (PhaseStart != StartTime || PhasePos != CurrentPos || PhaseStep == 0)
+    {
+        return CurrentTime;
+    }
+    uint32_t Angle = Phase + PhaseOffset;
+    uint64_t Left = 0x80000000ULL - ( Angle & 0x7FFFFFFF );
+    uint64_t Steps = ( Left + PhaseStep - 1 ) / PhaseStep;
+
+    // Half a millisecond over, so the position Calc works out is past the edge
+    return CurrentTime - Position + ( PhasePos + Steps + 0.5 ) / 1000.;
+}
+
+//----------------------------------------------------------------------------------------------
+// Calc
+//----------------------------------------------------------------------------------------------
+void Feedback360Effect::Calc(double CurrentTime, const Feedback360Axes *Axes, LONG *Levels, int Channels)
+{
+    CFTimeInterval Duration;
+    double BeginTime;
+    double EndTime;
+    CalcTimes(&Duration, &BeginTime, &EndTime);
+
+    if (Status != FFEGES_PLAYING || CurrentTime < BeginTime || EndTime < CurrentTime)
+    {
+        return;
+    }
+    Channels = min( Channels, EFFECT_CHANNELS );
+
+    // Between samples the output of this run of the effect holds. Ticks that
+    // land on the sample period to within rounding count as on time.
+    DWORD SamplePeriod = DiEffect.dwSamplePeriod;
+    if (Kind == CUSTOM_FORCE)
+    {
+        SamplePeriod = max( SamplePeriod, DiCustomForce.dwSamplePeriod );
+    }
+    if (HeldStart != StartTime || CurrentTime < LastTime || (CurrentTime - LastTime)*1000*1000 + 0.5 >= SamplePeriod)
+    {
+        memset(Held, 0, sizeof(Held));
+        CalcLevels(CurrentTime, Duration, BeginTime, Axes, Held, Channels);
+        HeldStart = StartTime;
+        LastTime = CurrentTime;
+    }
+    for (int i = 0; i < Channels; i++)
+    {
+        Levels[i] += Held[i];
+    }
+}
 
-        *LeftLevel = *LeftLevel + WorkLeftLevel;
-        *RightLevel = *RightLevel + WorkRightLevel;
+//----------------------------------------------------------------------------------------------
+// CalcLevels
+//----------------------------------------------------------------------------------------------
+void Feedback360Effect::CalcLevels(double CurrentTime, CFTimeInterval Duration, double BeginTime, const Feedback360Axes *Axes, LONG *Levels, int Channels)
+{
+    // Used for force calculation
+    LONG NormalLevel;
+
+    // Used for envelope calculation
+    LONG NormalRate;
+    LONG AttackLevel;
+    LONG FadeLevel;
+
+    CalcEnvelope((ULONG)(Duration*1000)
+                 ,(ULONG)(fmod(CurrentTime - BeginTime, Duration)*1000)
+                 ,&NormalRate
+                 ,&AttackLevel
+                 ,&FadeLevel);
+
+    // CustomForce allows setting each channel separately
+    if(Kind == CUSTOM_FORCE) {
+        DWORD Stride = max( (DWORD)1, DiCustomForce.cChannels );
+        if (Samples.size() < Stride * (Index + 1)) {
+            // A stream that has run dry stays quiet until more samples arrive
+            return;
+        }
+        for (int i = 0; i < Channels; i++) {
+            // A single channel drives both rumble motors
+            DWORD Source = ( Stride == 1 && i < 2 ) ? 0 : i;
+            if (Source >= Stride) {
+                break;
+            }
+            LONG WorkLevel = ((Samples[Stride*Index + Source] * NormalRate + AttackLevel + FadeLevel) / 100) * (LONG)DiEffect.dwGain / 10000;
+            Levels[i] += min( LEVEL_MAX, WorkLevel );
+        }
+        if (!Streaming) {
+            Index = (Index + 1) % (Samples.size()/Stride);
+        } else if (++Index >= 512 && 2 * Index >= Samples.size() / Stride) {
+            // Drop what has been played once it is half the buffer
+            Samples.erase(Samples.begin(), Samples.begin() + Stride * Index);
+            Index = 0;
+        }
+    }
+    // Conditions follow the stick rather than time, and take no envelope
+    else if (Kind == SPRING || Kind == DAMPER || Kind == INERTIA || Kind == FRICTION) {
+        NormalLevel = min( LEVEL_MAX, CalcCondition(Axes) * (LONG)DiEffect.dwGain / 10000 );
+        Levels[0] += NormalLevel;
+        Levels[1] += NormalLevel;
+    }
+    // Regular commands treat the rumble motors as a single output
+    else {
+        CalcForce(
+                  (ULONG)(Duration*1000)
+                  ,(ULONG)(fmod(CurrentTime - BeginTime, Duration)*1000)
+                  ,NormalRate
+                  ,AttackLevel
+                  ,FadeLevel
+                  ,&NormalLevel );
+
+        NormalLevel = min( LEVEL_MAX, (NormalLevel > 0) ? NormalLevel : -NormalLevel );
+        Levels[0] += NormalLevel;
+        Levels[1] += NormalLevel;
     }
-    return 0;
 }
 
 //----------------------------------------------------------------------------------------------
@@ -162,109 +425,82 @@ void Feedback360Effect::CalcEnvelope(ULONG Duration, ULONG CurrentPos, LONG *Nor
 	}
 }
 
-void Feedback360Effect::CalcForce(ULONG Duration, ULONG CurrentPos, LONG NormalRate, LONG AttackLevel, LONG FadeLevel, LONG * NormalLevel)
+//----------------------------------------------------------------------------------------------
+// CalcCondition
+//----------------------------------------------------------------------------------------------
+LONG Feedback360Effect::CalcCondition(const Feedback360Axes *Axes)
 {
-    LONG Magnitude = 0;
-    LONG Period;
-    LONG R;
-    LONG Rate;
-
-    if (CFEqual(Type, kFFEffectType_ConstantForce_ID)) {
-        Magnitude	= DiConstantForce.lMagnitude;
-        Magnitude	= ( Magnitude * NormalRate + AttackLevel + FadeLevel ) / 100;
+    if (Axes == NULL)
+    {
+        return 0;
     }
-    else if (CFEqual(Type, kFFEffectType_Square_ID)) {
-        Period	= max( (DWORD)1, ( DiPeriodic.dwPeriod / 1000 ) );
-        R		= ( CurrentPos%Period) * 360 / Period;
-        R	= ( R + ( DiPeriodic.dwPhase / 100 ) ) % 360;
-
-        Magnitude	= DiPeriodic.dwMagnitude;
-        Magnitude	= ( Magnitude * NormalRate + AttackLevel + FadeLevel ) / 100;
 
-        if (180 <= R)
-        {
-            Magnitude = Magnitude * -1;
-        }
-
-        Magnitude	= Magnitude + DiPeriodic.lOffset;
+    // Spring resists displacement, damper and friction motion, inertia changes in motion
+    const LONG *Metric = Axes->Velocity;
+    if (Kind == SPRING)
+    {
+        Metric = Axes->Position;
     }
-    else if (CFEqual(Type, kFFEffectType_Sine_ID)) {
-        Period	= max( (DWORD)1, ( DiPeriodic.dwPeriod / 1000 ) );
-        R		= (CurrentPos%Period) * 360 / Period;
-        R		= ( R + ( DiPeriodic.dwPhase / 100 ) ) % 360;
-
-        Magnitude	= DiPeriodic.dwMagnitude;
-        Magnitude	= ( Magnitude * NormalRate + AttackLevel + FadeLevel ) / 100;
-
-        Magnitude	= ( int)( Magnitude * sin( R * M_PI / 180.0 ) );
-
-        Magnitude	= Magnitude + DiPeriodic.lOffset;
+    else if (Kind == INERTIA)
+    {
+        Metric = Axes->Acceleration;
     }
-    else if (CFEqual(Type, kFFEffectType_Triangle_ID)) {
-        Period	= max( (DWORD)1, ( DiPeriodic.dwPeriod / 1000 ) );
-        R		= (CurrentPos%Period) * 360 / Period;
-        R		= ( R + ( DiPeriodic.dwPhase / 100 ) ) % 360;
-
-        Magnitude	= DiPeriodic.dwMagnitude;
-        Magnitude	= ( Magnitude * NormalRate + AttackLevel + FadeLevel ) / 100;
 
-        if (0 <= R && R < 90)
-        {
-            Magnitude	= -Magnitude * ( 90 - R ) / 90;
-        }
-        if (90 <= R && R < 180)
+    // The motors can only shake, not push back, so only the size of the force is kept
+    LONG Magnitude = 0;
+    for (DWORD i = 0; i < ConditionCount; i++)
+    {
+        const FFCONDITION *Condition = &DiCondition[i];
+        LONG Value = Metric[i];
+        if (Kind == FRICTION)
         {
-            Magnitude	= Magnitude * ( R - 90 ) / 90;
+            // A constant drag whenever the stick is moving
+            Value = ( Value > 100 ) ? 10000 : ( ( Value < -100 ) ? -10000 : 0 );
         }
-        if (180 <= R && R < 270)
+
+        LONG Force = 0;
+        if (Value < Condition->lOffset - Condition->lDeadBand)
         {
-            Magnitude	= Magnitude * ( 90 - ( R - 180 ) ) / 90;
+            Force = (LONG)((SInt64)( Condition->lOffset - Condition->lDeadBand - Value ) * Condition->lNegativeCoefficient / 10000);
+            Force = min( abs(Force), (LONG)Condition->dwNegativeSaturation );
         }
-        if (270 <= R && R < 360)
+        else if (Value > Condition->lOffset + Condition->lDeadBand)
         {
-            Magnitude	= -Magnitude * ( R - 270 ) / 90;
+            Force = (LONG)((SInt64)( Value - Condition->lOffset - Condition->lDeadBand ) * Condition->lPositiveCoefficient / 10000);
+            Force = min( abs(Force), (LONG)Condition->dwPositiveSaturation );
         }
-
-        Magnitude	= Magnitude + DiPeriodic.lOffset;
+        Magnitude += Force;
     }
-    else if(CFEqual(Type, kFFEffectType_SawtoothUp_ID)) {
-        Period	= max( (DWORD)1, ( DiPeriodic.dwPeriod / 1000 ) );
-        R		= (CurrentPos%Period) * 360 / Period;
-        R		= ( R + ( DiPeriodic.dwPhase / 100 ) ) % 360;
-
-        Magnitude	= DiPeriodic.dwMagnitude;
-        Magnitude	= ( Magnitude * NormalRate + AttackLevel + FadeLevel ) / 100;
+    return min( Magnitude, (LONG)10000 );
+}
 
-        if (0 <= R && R < 180)
-        {
-            Magnitude	= -Magnitude * ( 180 - R ) / 180;
-        }
-        if (180 <= R && R < 360)
-        {
-            Magnitude	= Magnitude * ( R - 180 ) / 180;
-        }
+void Feedback360Effect::CalcForce(ULONG Duration, ULONG CurrentPos, LONG NormalRate, LONG AttackLevel, LONG FadeLevel, LONG * NormalLevel)
+{
+    LONG Magnitude = 0;
+    LONG Rate;
 
-        Magnitude	= Magnitude + DiPeriodic.lOffset;
+    if (Kind == CONSTANT_FORCE) {
+        Magnitude	= DiConstantForce.lMagnitude;
+        Magnitude	= ( Magnitude * NormalRate + AttackLevel + FadeLevel ) / 100;
     }
-    else if (CFEqual(Type, kFFEffectType_SawtoothDown_ID)) {
-        Period	= max( (DWORD)1, ( DiPeriodic.dwPeriod / 1000 ) );
-        R		= (CurrentPos%Period) * 360 / Period;
-        R		= ( R + ( DiPeriodic.dwPhase / 100 ) ) % 360;
+    else if (Kind == SQUARE || Kind == SINE || Kind == TRIANGLE || Kind == SAWTOOTH_UP || Kind == SAWTOOTH_DOWN) {
+        uint32_t Angle = AdvancePhase(CurrentPos);
+        int32_t Wave;
+
+        switch (Kind) {
+            case SQUARE:         Wave = WaveSquare(Angle); break;
+            case SINE:           Wave = WaveSine(Angle); break;
+            case TRIANGLE:       Wave = WaveTriangle(Angle); break;
+            case SAWTOOTH_UP:    Wave = WaveSawtoothUp(Angle); break;
+            default:             Wave = WaveSawtoothDown(Angle); break;
+        }
 
         Magnitude	= DiPeriodic.dwMagnitude;
         Magnitude	= ( Magnitude * NormalRate + AttackLevel + FadeLevel ) / 100;
-        if( 0 <= R && R < 180 )
-        {
-            Magnitude	= Magnitude * ( 180 - R ) / 180;
-        }
-        if( 180 <= R && R < 360 )
-        {
-            Magnitude	= -Magnitude * ( R - 180 ) / 180;
-        }
-
+        Magnitude	= (LONG)(((int64_t)Magnitude * Wave) / WAVE_ONE);
         Magnitude	= Magnitude + DiPeriodic.lOffset;
     }
-    else if (CFEqual(Type, kFFEffectType_RampForce_ID)) {
+    else if (Kind == RAMP_FORCE) {
         Rate		= ( Duration - CurrentPos ) * 100
         / Duration;//MAX( 1, DiEffect.dwDuration / 1000 );
 
@@ -28,11 +28,13 @@
 #ifndef Feedback360_Feedback360Effect_h
 #define Feedback360_Feedback360Effect_h
 
-#include <IOKit/IOCFPlugIn.h>
-#include <ForceFeedback/IOForceFeedbackLib.h>
+#include "Feedback360Types.h"
+#include <float.h>
 #include <math.h>
+#include <stdlib.h>
 #include <string.h>
 #include <algorithm>
+#include <vector>
 
 //----------------------------------------------------------------------------------------------
 //	Effects
@@ -51,9 +53,22 @@
 #define	FRICTION		0x0A
 #define	CUSTOM_FORCE	0x0B
 
-#define SCALE_MAX (LONG)255
+// Largest level Calc adds to a channel for one effect
+#define LEVEL_MAX (LONG)10000
 
-double CurrentTimeUsingMach();
+// Most channels Calc fills
+#define EFFECT_CHANNELS 4
+
+// Source of the times handed to Calc, in seconds
+typedef double (*Feedback360Clock)(void);
+
+// Left stick X and Y for condition effects, each scaled to -10000..10000.
+// Velocity is travel per 100 ms and acceleration the change in that per 100 ms.
+typedef struct {
+    LONG    Position[2];
+    LONG    Velocity[2];
+    LONG    Acceleration[2];
+} Feedback360Axes;
 
 class Feedback360Effect
 {
@@ -61,9 +76,40 @@ public:
     Feedback360Effect(FFEffectDownloadID theHand);
     Feedback360Effect(const Feedback360Effect &src);
 
-    LONG Calc(LONG *LeftLevel, LONG *RightLevel);
+    // Adds the output at CurrentTime to Levels, one per motor with the left and
+    // right rumble motors first. Nothing here reads the clock, so the same calls
+    // always give the same output.
+    // The output is worked out once every DiEffect.dwSamplePeriod, or for a
+    // custom force every DiCustomForce.dwSamplePeriod if that is longer, and
+    // held in between.
+    // Axes may be NULL when the stick can't be read, conditions are then silent.
+    void Calc(double CurrentTime, const Feedback360Axes *Axes, LONG *Levels, int Channels);
+
+    // Earliest time the output of this effect can change, DBL_MAX once it has
+    // nothing left to play. Effects that have run their course are stopped.
+    // Step is how often envelope edges are followed, 0 for every tick, longer
+    // turns them into stairs.
+    double NextTime(double CurrentTime, double Step);
+
+    // A square wave between its envelope edges swaps between two levels. True
+    // when that is where it is at CurrentTime, which must have been passed to
+    // Calc last, with the level of the other half as Calc adds it, the length
+    // of a half and of what is left of this one, and when the wave stops being
+    // regular, all in seconds.
+    bool SquareTrain(double CurrentTime, LONG *OtherLevel, double *Half, double *Left, double *Until);
+
+    // Call after changing DiPeriodic
+    void PreparePhase();
+
+    // Custom force samples are copied out of rglForceData, the caller's buffer
+    // is not used after DownloadEffect returns
+    static void CopySamples(const LONG *Data, DWORD Count, std::vector<int16_t> *Samples);
+    void SetSamples(std::vector<int16_t> &NewSamples);
+    // Switches the effect to streaming, played samples are dropped instead of repeated
+    void AppendSamples(const std::vector<int16_t> &NewSamples);
 
 	CFUUIDRef		Type;
+    int             Kind;
     FFEffectDownloadID Handle;
 
 	FFEFFECT		DiEffect;
@@ -72,18 +118,44 @@ public:
     FFCUSTOMFORCE   DiCustomForce;
 	FFPERIODIC		DiPeriodic;
 	FFRAMPFORCE		DiRampforce;
+    FFCONDITION     DiCondition[2];     // One per axis
+    DWORD           ConditionCount;
 
     DWORD			Status;
     DWORD			PlayCount;
     double			StartTime;
 
+    // When the held output was worked out, and the start it belongs to
     double			LastTime;
+    double          HeldStart;
+    LONG            Held[EFFECT_CHANNELS];
     DWORD           Index;
 
+    // When the trigger button last started the effect
+    double          TriggerTime;
+
+    // Custom force samples, interleaved DiCustomForce.cChannels at a time
+    std::vector<int16_t> Samples;
+    bool            Streaming;
+
 private:
     Feedback360Effect();
+    void CalcTimes(CFTimeInterval *Duration, double *BeginTime, double *EndTime);
+    void CalcLevels(double CurrentTime, CFTimeInterval Duration, double BeginTime, const Feedback360Axes *Axes, LONG *Levels, int Channels);
     void CalcEnvelope(ULONG Duration, ULONG CurrentPos, LONG *NormalRate, LONG *AttackLevel, LONG *FadeLevel);
+    LONG CalcCondition(const Feedback360Axes *Axes);
     void CalcForce(ULONG Duration, ULONG CurrentPos, LONG NormalRate, LONG AttackLevel, LONG FadeLevel, LONG * NormalLevel);
+    uint32_t AdvancePhase(ULONG CurrentPos);
+    bool EdgeTimes(double *AttackTime, double *FadeTime);
+    double SquareEdge(double CurrentTime, double Position);
+
+    // Periodic waveform state, the phase advances by the time since the last tick
+    uint32_t    PhasePeriod;
+    uint32_t    PhaseStep;
+    uint32_t    PhaseOffset;
+    uint32_t    Phase;
+    ULONG       PhasePos;
+    double      PhaseStart;
 };
 
 #endif
@@ -0,0 +1,211 @@
+/*
+    MICE Xbox 360 Controller driver for Mac OS X
+    Force Feedback module
+    Copyright (C) 2013 David Ryskalczyk
+
+    Feedback360EffectTable.h - handle based storage for downloaded effects
+
+    This file is part of Xbox360Controller.
+
+    Xbox360Controller is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    Xbox360Controller is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Xbox360Controller; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#ifndef Feedback360_Feedback360EffectTable_h
+#define Feedback360_Feedback360EffectTable_h
+
+#include "Feedback360Types.h"
+#include <atomic>
+
+// Fixed size slot map. A handle is the slot number plus one in the low 16 bits
+// and the generation of that slot in the high 16 bits, so looking one up is a
+// single index and a handle to a destroyed effect never matches its successor.
+// Each effect is allocated separately so pointers into it (DiEffect.lpEnvelope
+// and friends) stay valid for as long as it exists.
+//
+// Everything runs on the effect queue except Reserve and Lookup, which API
+// callers use so they never have to wait for the queue. Free slots are kept
+// on a lock-free stack, so Reserve never waits for the queue releasing one
+// either.
+template <class Effect, UInt32 Capacity>
+class EffectTable
+{
+public:
+    EffectTable() : LiveCount(0), FreeTop(1)
+    {
+        for (UInt32 i = 0; i < Capacity; i++)
+        {
+            Slots[i].Item = NULL;
+            Slots[i].Generation = 1;
+            FreeNext[i] = (i + 1 < Capacity) ? i + 2 : 0;
+            Published[i] = 0;
+        }
+    }
+
+    ~EffectTable()
+    {
+        Clear();
+    }
+
+    // Any thread. Sets a slot aside for Install, returns 0 when every slot is in use
+    FFEffectDownloadID Reserve()
+    {
+        UInt64 Top = FreeTop.load(std::memory_order_acquire);
+        UInt16 Slot;
+        do
+        {
+            if ((Top & 0xffff) == 0)
+            {
+                return 0;
+            }
+            Slot = (Top & 0xffff) - 1;
+        }
+        while (!FreeTop.compare_exchange_weak(Top, NextTop(Top, FreeNext[Slot].load(std::memory_order_relaxed)),
+                                              std::memory_order_acquire, std::memory_order_acquire));
+        FFEffectDownloadID Handle = (FFEffectDownloadID)((Slots[Slot].Generation << 16) | (Slot + 1));
+        Published[Slot] = (UInt64)Handle << 32;
+        return Handle;
+    }
+
+    // Creates the effect for a handle returned by Reserve
+    Effect *Install(FFEffectDownloadID Handle)
+    {
+        UInt16 Slot = (Handle & 0xffff) - 1;
+        Slots[Slot].Item = new Effect(Handle);
+        Slots[Slot].Live = LiveCount;
+        Live[LiveCount++] = Slot;
+        return Slots[Slot].Item;
+    }
+
+    // Any thread. Status as of the last Publish, false for unknown handles
+    bool Lookup(FFEffectDownloadID Handle, FFEffectStatusFlag *Status)
+    {
+        UInt32 Slot = (Handle & 0xffff) - 1;
+        if (Slot >= Capacity)
+        {
+            return false;
+        }
+        UInt64 Value = Published[Slot];
+        if ((Value >> 32) != Handle)
+        {
+            return false;
+        }
+        *Status = (FFEffectStatusFlag)(Value & 0xffffffff);
+        return true;
+    }
+
+    void Publish()
+    {
+        for (UInt32 i = 0; i < LiveCount; i++)
+        {
+            Effect *Item = Slots[Live[i]].Item;
+            Published[Live[i]] = ((UInt64)Item->Handle << 32) | (UInt32)Item->Status;
+        }
+    }
+
+    Effect *Find(FFEffectDownloadID Handle)
+    {
+        UInt32 Slot = (Handle & 0xffff) - 1;
+        if (Slot >= Capacity || Slots[Slot].Item == NULL || Slots[Slot].Generation != (Handle >> 16))
+        {
+            return NULL;
+        }
+        return Slots[Slot].Item;
+    }
+
+    bool Destroy(FFEffectDownloadID Handle)
+    {
+        if (Find(Handle) == NULL)
+        {
+            return false;
+        }
+        Release((Handle & 0xffff) - 1);
+        return true;
+    }
+
+    void Clear()
+    {
+        while (LiveCount > 0)
+        {
+            Release(Live[LiveCount - 1]);
+        }
+    }
+
+    // Live effects, in no particular order
+    UInt32 Count() const
+    {
+        return LiveCount;
+    }
+
+    Effect *At(UInt32 Index)
+    {
+        return Slots[Live[Index]].Item;
+    }
+
+private:
+    struct EffectSlot
+    {
+        Effect *Item;
+        UInt16 Generation;
+        UInt16 Live;        // Position in Live while in use
+    };
+
+    EffectSlot  Slots[Capacity];
+    UInt16      Live[Capacity];
+    UInt32      LiveCount;
+
+    // Top of the free slot stack, slot plus one in the low 16 bits and 0 when
+    // it is empty. The high 32 bits count pushes and pops, so a pop that read
+    // FreeNext before the slot was taken and given back fails its swap.
+    std::atomic<UInt64> FreeTop;
+    std::atomic<UInt16> FreeNext[Capacity];
+
+    static UInt64 NextTop(UInt64 Top, UInt16 Entry)
+    {
+        return ( ( ( Top >> 32 ) + 1 ) << 32 ) | Entry;
+    }
+
+    // Handle and status of each slot, packed so they are read together
+    std::atomic<UInt64> Published[Capacity];
+
+    void Release(UInt16 Slot)
+    {
+        delete Slots[Slot].Item;
+        Slots[Slot].Item = NULL;
+        if (++Slots[Slot].Generation == 0)
+        {
+            Slots[Slot].Generation = 1;
+        }
+
+        // Keep Live packed by moving the last entry into the hole
+        UInt16 Last = Live[--LiveCount];
+        Live[Slots[Slot].Live] = Last;
+        Slots[Last].Live = Slots[Slot].Live;
+
+        Published[Slot] = 0;
+        UInt64 Top = FreeTop.load(std::memory_order_relaxed);
+        do
+        {
+            FreeNext[Slot].store(Top & 0xffff, std::memory_order_relaxed);
+        }
+        while (!FreeTop.compare_exchange_weak(Top, NextTop(Top, Slot + 1),
+                                              std::memory_order_release, std::memory_order_relaxed));
+    }
+
+    // Not copyable, the table owns its effects
+    EffectTable(const EffectTable &src);
+    void operator = (const EffectTable &src);
+};
+
+#endif
@@ -0,0 +1,441 @@
+/*
+    MICE Xbox 360 Controller driver for Mac OS X
+    Force Feedback module
+    Copyright (C) 2013 David Ryskalczyk
+    based on xi, Copyright (C) 2011 Masahiko Morii
+
+    Feedback360Engine.h - effect handling shared by the FF plugins
+
+    This file is part of Xbox360Controller.
+
+    Xbox360Controller is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    Xbox360Controller is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Xbox360Controller; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#ifndef Feedback360_Feedback360Engine_h
+#define Feedback360_Feedback360Engine_h
+
+#include <ForceFeedback/IOForceFeedbackLib.h>
+#include <dispatch/dispatch.h>
+#include <stdio.h>
+
+#include "Feedback360EngineCore.h"
+
+double CurrentTimeUsingMach();
+
+// Everything DownloadEffect needs, copied out of the caller's FFEFFECT
+struct Feedback360Download
+{
+    FFEFFECT    DiEffect;
+    FFENVELOPE  DiEnvelope;
+    union
+    {
+        FFCUSTOMFORCE   CustomForce;
+        FFCONSTANTFORCE ConstantForce;
+        FFPERIODIC      Periodic;
+        FFRAMPFORCE     RampForce;
+        FFCONDITION     Condition[2];
+    } Params;
+    std::vector<int16_t> Samples;
+};
+
+// The downloaded effects, the API calls that act on them and the loop that
+// plays them, for a device with Channels motors that take levels up to Max.
+// Sink is the plugin that owns the device, the engine calls it on the effect
+// queue and never touches the hardware itself:
+//
+//     void SetForce(const LONG *Levels);              // Mixed levels, 0..Max
+//     bool ReadStick(SInt32 *X, SInt32 *Y);           // Left stick, or false
+//     bool ReadButtons(UInt32 *Buttons);              // Bit n for button n, or false
+//     double SetPulse(const LONG *Levels, double On, double Off, double Duration);
+//
+// SetPulse is for devices that can time their own output. It plays Levels
+// for On seconds and nothing for Off seconds, over and over for Duration
+// seconds, with Off 0 for levels that simply hold. It returns how long the
+// device will now keep going unprompted, or 0 to have SetForce used instead.
+//
+// This checks the calls and runs Feedback360EngineCore on a GCD queue and
+// timer. Commands are queued and return straight away, except Terminate.
+template <class Sink, int Channels, LONG Max>
+class Feedback360Engine
+{
+public:
+    Feedback360Engine(Sink *theOutput) : Core(theOutput, CurrentTimeUsingMach), Queue(NULL), Timer(NULL)
+    {
+    }
+
+    enum { Capacity = Feedback360EngineCore<Sink, Channels, Max>::Capacity };
+
+    // Time on the core's clock
+    double Clock()
+    {
+        return Core.Clock();
+    }
+
+    void Start(const char *Label)
+    {
+        Queue = dispatch_queue_create(Label, NULL);
+        Timer = dispatch_source_create(DISPATCH_SOURCE_TYPE_TIMER, 0, 0, Queue);
+        // Idle until an effect is started, see Schedule
+        dispatch_source_set_timer(Timer, DISPATCH_TIME_FOREVER, DISPATCH_TIME_FOREVER, 0);
+        dispatch_set_context(Timer, this);
+        dispatch_source_set_event_handler_f(Timer, EffectProc);
+        dispatch_resume(Timer);
+    }
+
+    // Stops the loop, then runs Finish on the effect queue and waits for it
+    void Terminate(dispatch_block_t Finish)
+    {
+        dispatch_sync(Queue, ^{
+            dispatch_source_cancel(Timer);
+            Finish();
+        });
+    }
+
+    // Runs Block on the effect queue, for plugin state the loop reads
+    void Run(dispatch_block_t Block)
+    {
+        dispatch_async(Queue, ^{
+            Block();
+            Wake();
+        });
+    }
+
+    HRESULT SetProperty(FFProperty property, void *value)
+    {
+        if(property != FFPROP_FFGAIN) {
+            return FFERR_UNSUPPORTED;
+        }
+
+        UInt32 NewGain = *((UInt32*)value);
+        HRESULT Result = FF_OK;
+
+        if (NewGain < 1 || 10000 < NewGain)
+        {
+            NewGain = std::max((UInt32)1, std::min(NewGain, (UInt32)10000));
+            Result = FF_TRUNCATED;
+        }
+        dispatch_async(Queue, ^{
+            Core.SetGain(NewGain);
+            Wake();
+        });
+
+        return Result;
+    }
+
+    // Level from which the mixer squashes output instead of clipping it
+    void SetKnee(LONG Knee)
+    {
+        dispatch_async(Queue, ^{
+            Core.SetKnee(Knee);
+            Wake();
+        });
+    }
+
+    HRESULT SetCurve(const Feedback360Curve *Curve)
+    {
+        if (Curve->Channel >= Channels)
+        {
+            return FFERR_INVALIDPARAM;
+        }
+        Feedback360Curve Copy = *Curve;
+        dispatch_async(Queue, ^{
+            Core.SetCurve(Copy.Channel, Copy.Points);
+            Wake();
+        });
+        return FF_OK;
+    }
+
+    HRESULT StartEffect(FFEffectDownloadID EffectHandle, FFEffectStartFlag Mode, UInt32 Count)
+    {
+        FFEffectStatusFlag Status;
+        if (!Core.EffectList.Lookup(EffectHandle, &Status))
+        {
+            return FFERR_INVALIDDOWNLOADID;
+        }
+
+        dispatch_async(Queue, ^{
+            if (Core.StartEffect(EffectHandle, Mode, Count))
+            {
+                Wake();
+            }
+        });
+        return FF_OK;
+    }
+
+    HRESULT StopEffect(UInt32 EffectHandle)
+    {
+        FFEffectStatusFlag Status;
+        if (!Core.EffectList.Lookup(EffectHandle, &Status))
+        {
+            return FFERR_INVALIDDOWNLOADID;
+        }
+
+        dispatch_async(Queue, ^{
+            if (Core.StopEffect(EffectHandle))
+            {
+                Wake();
+            }
+        });
+        return FF_OK;
+    }
+
+    HRESULT DownloadEffect(CFUUIDRef EffectType, FFEffectDownloadID *EffectHandle, FFEFFECT *DiEffect, FFEffectParameterFlag Flags)
+    {
+        if (Flags & FFEP_NODOWNLOAD)
+        {
+            return FF_OK;
+        }
+
+        // Resolve the type once here, so the effect loop never has to compare UUIDs
+        int Kind = KindForType(EffectType);
+
+        FFEffectDownloadID Handle = *EffectHandle;
+        FFEffectStatusFlag Status;
+        bool Created = false;
+        if (Handle == 0)
+        {
+            Handle = Core.EffectList.Reserve();
+            if (Handle == 0)
+            {
+                return FFERR_DEVICEFULL;
+            }
+            *EffectHandle = Handle;
+            Created = true;
+        }
+        else if (!Core.EffectList.Lookup(Handle, &Status))
+        {
+            return FFERR_INVALIDDOWNLOADID;
+        }
+
+        // The caller's buffers are only ours until we return
+        Feedback360Download *Download = new Feedback360Download;
+        Download->DiEffect = *DiEffect;
+        if( ( Flags & FFEP_ENVELOPE ) && DiEffect->lpEnvelope != NULL )
+        {
+            Download->DiEnvelope = *DiEffect->lpEnvelope;
+            Download->DiEffect.lpEnvelope = &Download->DiEnvelope;
+        }
+        if( ( Flags & FFEP_TYPESPECIFICPARAMS ) && DiEffect->lpvTypeSpecificParams != NULL )
+        {
+            Download->DiEffect.cbTypeSpecificParams = std::min(DiEffect->cbTypeSpecificParams, (DWORD)sizeof(Download->Params));
+            memcpy(&Download->Params, DiEffect->lpvTypeSpecificParams, Download->DiEffect.cbTypeSpecificParams);
+            Download->DiEffect.lpvTypeSpecificParams = &Download->Params;
+
+            if (Kind == CUSTOM_FORCE && Download->DiEffect.cbTypeSpecificParams >= sizeof(FFCUSTOMFORCE)
+                && Download->Params.CustomForce.rglForceData != NULL)
+            {
+                Feedback360Effect::CopySamples(Download->Params.CustomForce.rglForceData, Download->Params.CustomForce.cSamples, &Download->Samples);
+            }
+        }
+
+        dispatch_async(Queue, ^{
+            if (Core.DownloadEffect(Handle, Created, EffectType, Kind, &Download->DiEffect, Download->Samples, Flags))
+            {
+                Wake();
+            }
+            delete Download;
+        });
+        return FF_OK;
+    }
+
+    HRESULT DestroyEffect(FFEffectDownloadID EffectHandle)
+    {
+        FFEffectStatusFlag Status;
+        if (!Core.EffectList.Lookup(EffectHandle, &Status))
+        {
+            return FFERR_INVALIDDOWNLOADID;
+        }
+
+        dispatch_async(Queue, ^{
+            if (Core.DestroyEffect(EffectHandle))
+            {
+                Wake();
+            }
+        });
+        return FF_OK;
+    }
+
+    HRESULT GetEffectStatus(FFEffectDownloadID EffectHandle, FFEffectStatusFlag *Status)
+    {
+        if (!Core.EffectList.Lookup(EffectHandle, Status))
+        {
+            return FFERR_INVALIDDOWNLOADID;
+        }
+        return FF_OK;
+    }
+
+    HRESULT GetForceFeedbackState(ForceFeedbackDeviceState *DeviceState)
+    {
+        if (DeviceState->dwSize != sizeof(FFDEVICESTATE))
+        {
+            return FFERR_INVALIDPARAM;
+        }
+
+        DeviceState->dwState = Core.State();
+        DeviceState->dwLoad  = 0;
+
+        return FF_OK;
+    }
+
+    HRESULT SendForceFeedbackCommand(FFCommandFlag state)
+    {
+        dispatch_async(Queue, ^{
+            if (Core.SendForceFeedbackCommand(state))
+            {
+                Wake();
+            }
+        });
+        return FF_OK;
+    }
+
+    // Escapes sent to a single effect
+    HRESULT EffectEscape(FFEffectDownloadID downloadID, FFEFFESCAPE *escape)
+    {
+        FFEffectStatusFlag Status;
+        if (!Core.EffectList.Lookup(downloadID, &Status)) return FFERR_INVALIDDOWNLOADID;
+        escape->cbOutBuffer=0;
+        switch (escape->dwCommand) {
+            case 0x00:  // Append custom force samples, same layout as rglForceData
+            {
+                if (escape->cbInBuffer == 0 || escape->cbInBuffer % (Channels * sizeof(LONG)) != 0) return FFERR_INVALIDPARAM;
+                std::vector<int16_t> *Samples = new std::vector<int16_t>;
+                Feedback360Effect::CopySamples((LONG *)escape->lpvInBuffer, escape->cbInBuffer / sizeof(LONG), Samples);
+                dispatch_async(Queue, ^{
+                    Core.AppendSamples(downloadID, *Samples);
+                    delete Samples;
+                });
+            }
+                break;
+
+            default:
+                fprintf(stderr, "Force feedback engine: Unknown effect escape (%i)\n", (int)escape->dwCommand);
+                return FFERR_UNSUPPORTED;
+        }
+        return FF_OK;
+    }
+
+    // Snapshot of the loop statistics, waits for the current tick
+    void GetStats(Feedback360EngineStats *Result)
+    {
+        dispatch_sync(Queue, ^{
+            Core.GetStats(Result);
+        });
+    }
+
+    // Prints the loop statistics to stderr
+    void LogStats(const char *Name)
+    {
+        Feedback360EngineStats Snapshot;
+        GetStats(&Snapshot);
+        fprintf(stderr, "%s: %u ticks, %u overruns, period %u us\n"
+                "  interval %u/%u/%u us (min/mean/max), lateness %u/%u us (mean/max)\n"
+                "  cost %u/%u/%u us (last/mean/max), %u effects playing (max %u)\n"
+                "  %u reports (%u played out by the device), %u deduplicated\n",
+                Name, Snapshot.Ticks, Snapshot.Overruns, Snapshot.Period,
+                Snapshot.MinInterval, Snapshot.MeanInterval, Snapshot.MaxInterval,
+                Snapshot.MeanLateness, Snapshot.MaxLateness,
+                Snapshot.LastCost, Snapshot.MeanCost, Snapshot.MaxCost,
+                Snapshot.ActiveEffects, Snapshot.MaxActiveEffects,
+                Snapshot.Reports, Snapshot.Pulses, Snapshot.Deduplicated);
+    }
+
+    // Loop rate in microseconds, clamped to MinGranularity..MaxGranularity
+    void SetTickPeriod(UInt32 Period)
+    {
+        dispatch_async(Queue, ^{
+            Core.SetTickPeriod(Period);
+            Wake();
+        });
+    }
+
+    // How often envelope edges are followed in microseconds, 0 for every
+    // tick. Longer turns them into stairs that SetPulse can hold.
+    void SetRampStep(UInt32 Step)
+    {
+        dispatch_async(Queue, ^{
+            Core.SetRampStep(Step);
+            Wake();
+        });
+    }
+
+private:
+    Feedback360EngineCore<Sink, Channels, Max> Core;
+
+    // GCD queue and timer
+    dispatch_queue_t    Queue;
+    dispatch_source_t   Timer;
+
+    // Maps an effect type UUID to one of the kinds in Feedback360Effect.h, or -1
+    static int KindForType(CFUUIDRef Type)
+    {
+        if (CFEqual(Type, kFFEffectType_ConstantForce_ID))
+            return CONSTANT_FORCE;
+        if (CFEqual(Type, kFFEffectType_RampForce_ID))
+            return RAMP_FORCE;
+        if (CFEqual(Type, kFFEffectType_Square_ID))
+            return SQUARE;
+        if (CFEqual(Type, kFFEffectType_Sine_ID))
+            return SINE;
+        if (CFEqual(Type, kFFEffectType_Triangle_ID))
+            return TRIANGLE;
+        if (CFEqual(Type, kFFEffectType_SawtoothUp_ID))
+            return SAWTOOTH_UP;
+        if (CFEqual(Type, kFFEffectType_SawtoothDown_ID))
+            return SAWTOOTH_DOWN;
+        if (CFEqual(Type, kFFEffectType_Spring_ID))
+            return SPRING;
+        if (CFEqual(Type, kFFEffectType_Damper_ID))
+            return DAMPER;
+        if (CFEqual(Type, kFFEffectType_Inertia_ID))
+            return INERTIA;
+        if (CFEqual(Type, kFFEffectType_Friction_ID))
+            return FRICTION;
+        if (CFEqual(Type, kFFEffectType_CustomForce_ID))
+            return CUSTOM_FORCE;
+        return -1;
+    }
+
+    // event loop func
+    static void EffectProc( void *params )
+    {
+        Feedback360Engine *cThis = (Feedback360Engine *)params;
+        cThis->Schedule(cThis->Core.Tick());
+    }
+
+    void Wake()
+    {
+        Core.Wake();
+
+        // Run EffectProc straight away, it works out when it next needs to run
+        dispatch_source_set_timer(Timer, DISPATCH_TIME_NOW, DISPATCH_TIME_FOREVER, 0);
+    }
+
+    void Schedule(double Delay)
+    {
+        if (Delay == DBL_MAX)
+        {
+            // Nothing is playing, so stay asleep until the next call that changes that
+            dispatch_source_set_timer(Timer, DISPATCH_TIME_FOREVER, DISPATCH_TIME_FOREVER, 0);
+            return;
+        }
+        dispatch_source_set_timer(Timer, dispatch_time(DISPATCH_TIME_NOW, (int64_t)(Delay * NSEC_PER_SEC)), DISPATCH_TIME_FOREVER, 10);
+    }
+
+    // Not copyable, the engine owns its queue and the core
+    Feedback360Engine(const Feedback360Engine &src);
+    void operator = (const Feedback360Engine &src);
+};
+
+#endif
@@ -0,0 +1,731 @@
+/*
+    MICE Xbox 360 Controller driver for Mac OS X
+    Force Feedback module
+    Copyright (C) 2013 David Ryskalczyk
+    based on xi, Copyright (C) 2011 Masahiko Morii
+
+    Feedback360EngineCore.h - the effect loop, without the queue that runs it
+
+    This file is part of Xbox360Controller.
+
+    Xbox360Controller is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    Xbox360Controller is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Xbox360Controller; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#ifndef Feedback360_Feedback360EngineCore_h
+#define Feedback360_Feedback360EngineCore_h
+
+#include <atomic>
+#include <float.h>
+#include <vector>
+
+#include "Feedback360Effect.h"
+#include "Feedback360EffectTable.h"
+#include "Feedback360Mixer.h"
+
+#define LoopGranularity 10000 // Microseconds
+#define MinGranularity  1000  // Fastest tick that can be asked for
+#define MaxGranularity  40000 // Slowest the loop backs off to when overrunning
+
+// Returned by escape 0x08, times are in microseconds
+typedef struct {
+    UInt32  Ticks;
+    UInt32  Overruns;           // Ticks that went over budget, see Pace
+    UInt32  Period;             // Tick period currently run
+    UInt32  LastInterval;       // Between the last two ticks run off the timer
+    UInt32  MinInterval;
+    UInt32  MaxInterval;
+    UInt32  MeanInterval;
+    UInt32  MaxLateness;        // How far a tick has run behind its timer
+    UInt32  MeanLateness;
+    UInt32  LastCost;           // Time spent in the last tick
+    UInt32  MaxCost;
+    UInt32  MeanCost;
+    UInt32  ActiveEffects;      // Playing during the last tick
+    UInt32  MaxActiveEffects;
+    UInt32  Reports;            // Levels handed to SetForce or SetPulse
+    UInt32  Deduplicated;       // Ticks that mixed the levels already reported
+    UInt32  Pulses;             // Reports the device plays out by itself, see SetPulse
+} Feedback360EngineStats;
+
+// The effects, the mixer and the loop that plays them, for a device with
+// Channels motors that take levels up to Max. Nothing here knows about the
+// queue or timer that drive it: Feedback360Engine calls every method but
+// Reserve, Lookup and State on its effect queue, and the host tests call
+// them directly with a clock of their own. Sink is as for Feedback360Engine.
+//
+// Commands return true when they changed something Tick needs to look at.
+template <class Sink, int Channels, LONG Max>
+class Feedback360EngineCore
+{
+public:
+    Feedback360EngineCore(Sink *theOutput, Feedback360Clock theClock) : Clock(theClock), Output(theOutput),
+    Mixer(Channels, Max), Actuator(true), Stopped(true), Paused(false),
+    PausedTime(0), Axes(), AxesTime(0), PrvButtons(0),
+    TickPeriod(LoopGranularity), ActivePeriod(LoopGranularity), Overruns(0), OverrunStreak(0), QuietTicks(0),
+    RampStep(0), PulseEnd(DBL_MAX), TimerDue(0), PrvTickTime(0), Stats(),
+    IntervalTotal(0), IntervalCount(0), LatenessTotal(0), CostTotal(0),
+    PublishedState(FFGFFS_EMPTY | FFGFFS_STOPPED | FFGFFS_ACTUATORSON | FFGFFS_POWERON | FFGFFS_SAFETYSWITCHOFF | FFGFFS_USERFFSWITCHON)
+    {
+        for (int i = 0; i < Channels; i++)
+        {
+            PrvLevels[i] = 0;
+        }
+    }
+
+    // Source of the times handed to the effects, only change it before the first tick
+    Feedback360Clock Clock;
+
+    // Matches storageCapacity in GetForceFeedbackCapabilities
+    enum { Capacity = 256 };
+
+    typedef EffectTable<Feedback360Effect, Capacity> Feedback360EffectTable;
+
+    // Reserve and Lookup may be called from any thread
+    Feedback360EffectTable  EffectList;
+
+    // Device state for GetForceFeedbackState, from any thread
+    UInt32 State() const
+    {
+        return PublishedState;
+    }
+
+    void SetGain(DWORD Gain)
+    {
+        Mixer.SetGain(Gain);
+    }
+
+    // Level from which the mixer squashes output instead of clipping it
+    void SetKnee(LONG Knee)
+    {
+        Mixer.SetKnee(Knee);
+    }
+
+    void SetCurve(int Channel, const UInt16 *Points)
+    {
+        Mixer.SetCurve(Channel, Points);
+    }
+
+    bool StartEffect(FFEffectDownloadID EffectHandle, FFEffectStartFlag Mode, UInt32 Count)
+    {
+        Feedback360Effect *Effect = EffectList.Find(EffectHandle);
+        if (Effect == NULL)
+        {
+            return false;
+        }
+        if (Mode & FFES_SOLO)
+        {
+            for (UInt32 i = 0; i < EffectList.Count(); i++)
+            {
+                EffectList.At(i)->Status = 0;
+            }
+        }
+        Effect->Status  = FFEGES_PLAYING;
+        Effect->PlayCount = Count;
+        Effect->StartTime = Clock();
+        Stopped = false;
+        return true;
+    }
+
+    bool StopEffect(FFEffectDownloadID EffectHandle)
+    {
+        Feedback360Effect *Effect = EffectList.Find(EffectHandle);
+        if (Effect == NULL)
+        {
+            return false;
+        }
+        Effect->Status = 0;
+        return true;
+    }
+
+    // Handle comes from EffectList.Reserve when Created, Kind from the
+    // effect type. DiEffect and Samples must be copies the caller owns.
+    bool DownloadEffect(FFEffectDownloadID Handle, bool Created, CFUUIDRef EffectType, int Kind,
+                        FFEFFECT *DiEffect, std::vector<int16_t> &Samples, FFEffectParameterFlag Flags)
+    {
+        Feedback360Effect *Effect = Created ? EffectList.Install(Handle) : EffectList.Find(Handle);
+        if (Effect == NULL)
+        {
+            return false;
+        }
+        ApplyEffect(Effect, EffectType, Kind, DiEffect, Samples, Flags);
+        return true;
+    }
+
+    bool DestroyEffect(FFEffectDownloadID EffectHandle)
+    {
+        return EffectList.Destroy(EffectHandle);
+    }
+
+    // Adds samples to a custom force that is already streaming
+    bool AppendSamples(FFEffectDownloadID EffectHandle, const std::vector<int16_t> &Samples)
+    {
+        Feedback360Effect *Effect = EffectList.Find(EffectHandle);
+        if (Effect == NULL || Effect->Kind != CUSTOM_FORCE)
+        {
+            return false;
+        }
+        Effect->AppendSamples(Samples);
+        return true;
+    }
+
+    bool SendForceFeedbackCommand(FFCommandFlag state)
+    {
+        switch (state) {
+            case FFSFFC_RESET:
+                EffectList.Clear();
+                Stopped = true;
+                Paused = false;
+                break;
+
+            case FFSFFC_STOPALL:
+                for (UInt32 i = 0; i < EffectList.Count(); i++)
+                {
+                    EffectList.At(i)->Status = 0;
+                }
+                Stopped = true;
+                Paused = false;
+                break;
+
+            case FFSFFC_PAUSE:
+                Paused  = true;
+                PausedTime = Clock();
+                break;
+
+            case FFSFFC_CONTINUE:
+                for (UInt32 i = 0; i < EffectList.Count(); i++)
+                {
+                    EffectList.At(i)->StartTime += ( Clock() - PausedTime );
+                }
+                Paused = false;
+                break;
+
+            case FFSFFC_SETACTUATORSON:
+                Actuator = true;
+                break;
+
+            case FFSFFC_SETACTUATORSOFF:
+                Actuator = false;
+                break;
+
+            default:
+                break;
+        }
+        return true;
+    }
+
+    void GetStats(Feedback360EngineStats *Result) const
+    {
+        *Result = Stats;
+        Result->Overruns = Overruns;
+        Result->Period = ActivePeriod;
+        if (IntervalCount > 0)
+        {
+            Result->MeanInterval = (UInt32)(IntervalTotal / IntervalCount);
+            Result->MeanLateness = (UInt32)(LatenessTotal / IntervalCount);
+        }
+        if (Stats.Ticks > 0)
+        {
+            Result->MeanCost = (UInt32)(CostTotal / Stats.Ticks);
+        }
+    }
+
+    // Loop rate in microseconds, clamped to MinGranularity..MaxGranularity
+    void SetTickPeriod(UInt32 Period)
+    {
+        Period = std::max((UInt32)MinGranularity, std::min(Period, (UInt32)MaxGranularity));
+        TickPeriod = Period;
+        ActivePeriod = Period;
+        OverrunStreak = 0;
+        QuietTicks = 0;
+    }
+
+    // How often envelope edges are followed in microseconds, 0 for every
+    // tick. Longer turns them into stairs that SetPulse can hold.
+    void SetRampStep(UInt32 Step)
+    {
+        RampStep = Step / 1000000.;
+    }
+
+    // After a command, before the tick it asks for
+    void Wake()
+    {
+        Publish();
+        TimerDue = 0;
+    }
+
+    // Plays one tick and returns how many seconds until the next, DBL_MAX
+    // when nothing is playing and the loop can sleep until the next command
+    double Tick()
+    {
+        LONG Levels[Channels] = {0};
+        double CurrentTime = Clock();
+        double NextTime = DBL_MAX;
+        const Feedback360Axes *TickAxes = NULL;
+        UInt32 Active = 0;
+        Feedback360Effect *Lone = NULL;
+
+        CountTick(CurrentTime);
+
+        if (Actuator == true)
+        {
+            // Armed effects are waiting on a button, so keep looking at it
+            if (!Paused && Trigger(CurrentTime))
+            {
+                NextTime = CurrentTime;
+            }
+
+            // The stick is only read while a condition effect is playing
+            for (UInt32 i = 0; i < EffectList.Count(); i++)
+            {
+                Feedback360Effect *Effect = EffectList.At(i);
+                if (Effect->Status == FFEGES_PLAYING && ( Effect->Kind == SPRING || Effect->Kind == DAMPER
+                    || Effect->Kind == INERTIA || Effect->Kind == FRICTION ))
+                {
+                    if (ReadAxes(CurrentTime))
+                    {
+                        TickAxes = &Axes;
+                    }
+                    break;
+                }
+            }
+
+            for (UInt32 i = 0; i < EffectList.Count(); i++)
+            {
+                Feedback360Effect *Effect = EffectList.At(i);
+                if (Effect->Status == FFEGES_PLAYING)
+                {
+                    Active++;
+                    Lone = Effect;
+                }
+                Effect->Calc(CurrentTime, TickAxes, Levels, Channels);
+                NextTime = std::min(NextTime, Effect->NextTime(CurrentTime, RampStep));
+            }
+        }
+
+        // Only what the motors would actually see is compared, so gain and
+        // curve changes go out and sums that mix to the same levels do not
+        LONG Mixed[Channels];
+        Mixer.Mix(Levels, Mixed);
+        bool Changed = memcmp(PrvLevels, Mixed, sizeof(Mixed)) != 0;
+        // A device left to time its own output stops at the end, so levels
+        // still wanted then go out again
+        bool Expired = CurrentTime >= PulseEnd;
+        if (Changed || Expired)
+        {
+            if (Offload(CurrentTime, &NextTime, Active == 1 ? Lone : NULL, Mixed))
+            {
+                Stats.Pulses++;
+            }
+            else
+            {
+                Output->SetForce(Mixed);
+                PulseEnd = DBL_MAX;
+            }
+            memcpy(PrvLevels, Mixed, sizeof(Mixed));
+            Stats.Reports++;
+        }
+        else if (!Changed)
+        {
+            Stats.Deduplicated++;
+        }
+
+        // NextTime stops effects that have finished
+        EffectList.Publish();
+        double Spent = Clock() - CurrentTime;
+        CountCost(Spent, Active);
+        Pace(Spent);
+
+        if (NextTime == DBL_MAX)
+        {
+            return DBL_MAX;
+        }
+        // Effects that change every tick come back after one tick period
+        double Delay = std::max(NextTime - CurrentTime, ActivePeriod / 1000000.);
+        TimerDue = Clock() + Delay;
+        return Delay;
+    }
+
+private:
+    Sink               *Output;
+
+    Feedback360Mixer    Mixer;
+    bool    Actuator;
+
+    LONG            PrvLevels[Channels];
+    bool            Stopped;
+    bool            Paused;
+    double          PausedTime;
+
+    // Last stick reading, for condition effects
+    Feedback360Axes Axes;
+    double          AxesTime;
+
+    // Buttons down at the last tick, for trigger buttons
+    UInt32          PrvButtons;
+
+    // Effect loop rate in microseconds, as asked for and as currently run
+    UInt32          TickPeriod;
+    UInt32          ActivePeriod;
+    UInt32          Overruns;
+    UInt32          OverrunStreak;
+    UInt32          QuietTicks;
+    double          RampStep;
+
+    // When the device runs out of the last SetPulse, DBL_MAX after SetForce
+    double          PulseEnd;
+
+    // Loop statistics. TimerDue is when Tick asked for the next tick, 0 when
+    // it was woken or left asleep.
+    double          TimerDue;
+    double          PrvTickTime;
+    Feedback360EngineStats Stats;
+    UInt64          IntervalTotal;
+    UInt32          IntervalCount;
+    UInt64          LatenessTotal;
+    UInt64          CostTotal;
+
+    // Updated by Publish
+    std::atomic<UInt32> PublishedState;
+
+    void ApplyEffect(Feedback360Effect *Effect, CFUUIDRef EffectType, int Kind, FFEFFECT *DiEffect, std::vector<int16_t> &Samples, FFEffectParameterFlag Flags)
+    {
+        Effect->Type = EffectType;
+        Effect->Kind = Kind;
+        Effect->DiEffect.dwFlags = DiEffect->dwFlags;
+
+        if( Flags & FFEP_DURATION )
+        {
+            Effect->DiEffect.dwDuration = DiEffect->dwDuration;
+        }
+
+        if( Flags & FFEP_SAMPLEPERIOD )
+        {
+            Effect->DiEffect.dwSamplePeriod = DiEffect->dwSamplePeriod;
+        }
+
+        if( Flags & FFEP_GAIN )
+        {
+            Effect->DiEffect.dwGain = DiEffect->dwGain;
+        }
+
+        if( Flags & FFEP_TRIGGERBUTTON )
+        {
+            Effect->DiEffect.dwTriggerButton = DiEffect->dwTriggerButton;
+        }
+
+        if( Flags & FFEP_TRIGGERREPEATINTERVAL )
+        {
+            Effect->DiEffect.dwTriggerRepeatInterval = DiEffect->dwTriggerRepeatInterval;
+        }
+
+        if( Flags & FFEP_AXES )
+        {
+            Effect->DiEffect.cAxes  = DiEffect->cAxes;
+            Effect->DiEffect.rgdwAxes = NULL;
+        }
+
+        if( Flags & FFEP_DIRECTION )
+        {
+            Effect->DiEffect.cAxes   = DiEffect->cAxes;
+            Effect->DiEffect.rglDirection = NULL;
+        }
+
+        if( ( Flags & FFEP_ENVELOPE ) && DiEffect->lpEnvelope != NULL )
+        {
+            memcpy( &Effect->DiEnvelope, DiEffect->lpEnvelope, sizeof( FFENVELOPE ) );
+            if( Effect->DiEffect.dwDuration - Effect->DiEnvelope.dwFadeTime
+               < Effect->DiEnvelope.dwAttackTime )
+            {
+                Effect->DiEnvelope.dwFadeTime = Effect->DiEnvelope.dwAttackTime;
+            }
+            Effect->DiEffect.lpEnvelope = &Effect->DiEnvelope;
+        }
+
+        Effect->DiEffect.cbTypeSpecificParams = DiEffect->cbTypeSpecificParams;
+
+        if( Flags & FFEP_TYPESPECIFICPARAMS )
+        {
+            if(Kind == CUSTOM_FORCE) {
+                memcpy(
+                       &Effect->DiCustomForce
+                       ,DiEffect->lpvTypeSpecificParams
+                       ,DiEffect->cbTypeSpecificParams );
+                Effect->DiEffect.lpvTypeSpecificParams = &Effect->DiCustomForce;
+                Effect->SetSamples(Samples);
+            }
+
+            else if(Kind == CONSTANT_FORCE) {
+                memcpy(
+                       &Effect->DiConstantForce
+                       ,DiEffect->lpvTypeSpecificParams
+                       ,DiEffect->cbTypeSpecificParams );
+                Effect->DiEffect.lpvTypeSpecificParams = &Effect->DiConstantForce;
+            }
+            else if(Kind == SQUARE || Kind == SINE || Kind == TRIANGLE || Kind == SAWTOOTH_UP || Kind == SAWTOOTH_DOWN) {
+                memcpy(
+                       &Effect->DiPeriodic
+                       ,DiEffect->lpvTypeSpecificParams
+                       ,DiEffect->cbTypeSpecificParams );
+                Effect->DiEffect.lpvTypeSpecificParams = &Effect->DiPeriodic;
+                Effect->PreparePhase();
+            }
+            else if(Kind == RAMP_FORCE) {
+                memcpy(
+                       &Effect->DiRampforce
+                       ,DiEffect->lpvTypeSpecificParams
+                       ,DiEffect->cbTypeSpecificParams );
+                Effect->DiEffect.lpvTypeSpecificParams = &Effect->DiRampforce;
+            }
+            else if(Kind == SPRING || Kind == DAMPER || Kind == INERTIA || Kind == FRICTION) {
+                DWORD Size = std::min(DiEffect->cbTypeSpecificParams, (DWORD)sizeof(Effect->DiCondition));
+                memcpy(Effect->DiCondition, DiEffect->lpvTypeSpecificParams, Size);
+                Effect->ConditionCount = Size / sizeof(FFCONDITION);
+                Effect->DiEffect.lpvTypeSpecificParams = Effect->DiCondition;
+            }
+        }
+
+        if( Flags & FFEP_STARTDELAY )
+        {
+            Effect->DiEffect.dwStartDelay = DiEffect->dwStartDelay;
+        }
+
+        if( Flags & FFEP_START )
+        {
+            Effect->Status  = FFEGES_PLAYING;
+            Effect->PlayCount = 1;
+            Effect->StartTime = Clock();
+        }
+
+        if( Flags & FFEP_NORESTART )
+        {
+            ;
+        }
+    }
+
+    // Records how the timer kept time, for ticks it was asked for
+    void CountTick(double CurrentTime)
+    {
+        Stats.Ticks++;
+        if (TimerDue != 0)
+        {
+            UInt32 Interval = (UInt32)((CurrentTime - PrvTickTime) * 1000000);
+            UInt32 Lateness = (UInt32)(std::max(CurrentTime - TimerDue, 0.) * 1000000);
+            Stats.LastInterval = Interval;
+            Stats.MinInterval = IntervalCount == 0 ? Interval : std::min(Stats.MinInterval, Interval);
+            Stats.MaxInterval = std::max(Stats.MaxInterval, Interval);
+            Stats.MaxLateness = std::max(Stats.MaxLateness, Lateness);
+            IntervalTotal += Interval;
+            LatenessTotal += Lateness;
+            IntervalCount++;
+        }
+        PrvTickTime = CurrentTime;
+        TimerDue = 0;
+    }
+
+    void CountCost(double Spent, UInt32 Active)
+    {
+        UInt32 Cost = (UInt32)(Spent * 1000000);
+        Stats.LastCost = Cost;
+        Stats.MaxCost = std::max(Stats.MaxCost, Cost);
+        CostTotal += Cost;
+        Stats.ActiveEffects = Active;
+        Stats.MaxActiveEffects = std::max(Stats.MaxActiveEffects, Active);
+    }
+
+    // Hands Mixed to SetPulse when it holds until NextTime, or when Lone is a
+    // square wave that pulses between Mixed and nothing. The loop then sleeps
+    // through the pulses, so NextTime is moved to when the device runs out.
+    bool Offload(double CurrentTime, double *NextTime, Feedback360Effect *Lone, const LONG *Mixed)
+    {
+        // Silence needs no keeping up, and output that moves every tick has to be sent every tick
+        bool Silent = true;
+        for (int i = 0; i < Channels; i++)
+        {
+            Silent = Silent && Mixed[i] == 0;
+        }
+        double Tick = ActivePeriod / 1000000.;
+        if (Silent || *NextTime <= CurrentTime + Tick)
+        {
+            return false;
+        }
+
+        LONG OtherLevel;
+        double Half;
+        double Left;
+        double Until;
+        if (Lone != NULL && Lone->SquareTrain(CurrentTime, &OtherLevel, &Half, &Left, &Until) && Left >= Half - Tick)
+        {
+            // Only when the other half comes out of the mixer as nothing
+            LONG Sums[Channels] = {0};
+            LONG Off[Channels];
+            Sums[0] = OtherLevel;
+            Sums[1] = OtherLevel;
+            Mixer.Mix(Sums, Off);
+            bool Pulsing = true;
+            for (int i = 0; i < Channels; i++)
+            {
+                Pulsing = Pulsing && Off[i] == 0;
+            }
+            double Covered = Pulsing ? Output->SetPulse(Mixed, Half, Half, Until - CurrentTime) : 0;
+            if (Covered > 0)
+            {
+                PulseEnd = CurrentTime + Covered;
+                *NextTime = PulseEnd;
+                return true;
+            }
+        }
+
+        double Covered = Output->SetPulse(Mixed, *NextTime - CurrentTime, 0, *NextTime - CurrentTime);
+        if (Covered > 0)
+        {
+            PulseEnd = CurrentTime + Covered;
+            *NextTime = std::min(*NextTime, PulseEnd);
+            return true;
+        }
+        return false;
+    }
+
+    // Starts effects when their trigger button goes down, and again every
+    // repeat interval while it stays down. True while any effect has a
+    // trigger button and the buttons can be read.
+    bool Trigger(double CurrentTime)
+    {
+        bool Armed = false;
+        for (UInt32 i = 0; i < EffectList.Count() && !Armed; i++)
+        {
+            Armed = EffectList.At(i)->DiEffect.dwTriggerButton - FFJOFS_BUTTON(0) < 32;
+        }
+        UInt32 Buttons;
+        if (!Armed || !Output->ReadButtons(&Buttons))
+        {
+            PrvButtons = 0;
+            return false;
+        }
+
+        UInt32 Pressed = Buttons & ~PrvButtons;
+        PrvButtons = Buttons;
+        for (UInt32 i = 0; i < EffectList.Count(); i++)
+        {
+            Feedback360Effect *Effect = EffectList.At(i);
+            DWORD Button = Effect->DiEffect.dwTriggerButton - FFJOFS_BUTTON(0);
+            if (Button >= 32)
+            {
+                continue;
+            }
+            DWORD Interval = Effect->DiEffect.dwTriggerRepeatInterval;
+            bool Repeat = ( Buttons & ( 1u << Button ) ) && Interval != 0 && Interval != FF_INFINITE
+                && CurrentTime - Effect->TriggerTime >= Interval / 1000000.;
+            if (( Pressed & ( 1u << Button ) ) || Repeat)
+            {
+                Effect->Status  = FFEGES_PLAYING;
+                Effect->PlayCount = 1;
+                Effect->StartTime = CurrentTime;
+                Effect->TriggerTime = CurrentTime;
+                Stopped = false;
+            }
+        }
+        return true;
+    }
+
+    bool ReadAxes(double CurrentTime)
+    {
+        SInt32 Raw[2];
+        if (!Output->ReadStick(&Raw[0], &Raw[1]))
+        {
+            return false;
+        }
+
+        double Elapsed = CurrentTime - AxesTime;
+        for (int i = 0; i < 2; i++)
+        {
+            LONG Position = Raw[i] * 10000 / 32768;
+            LONG Velocity = 0;
+            if (AxesTime != 0 && Elapsed > 0 && Elapsed < 1)
+            {
+                // Travel per 100 ms, and the change in that per 100 ms
+                Velocity = (LONG)std::max(-10000., std::min(( Position - Axes.Position[i] ) * 0.1 / Elapsed, 10000.));
+                Axes.Acceleration[i] = (LONG)std::max(-10000., std::min(( Velocity - Axes.Velocity[i] ) * 0.1 / Elapsed, 10000.));
+            }
+            else
+            {
+                Axes.Acceleration[i] = 0;
+            }
+            Axes.Position[i] = Position;
+            Axes.Velocity[i] = Velocity;
+        }
+        AxesTime = CurrentTime;
+        return true;
+    }
+
+    void Pace(double Spent)
+    {
+        // A tick may use half its period, which leaves room for commands on the queue
+        double Budget = ActivePeriod / 2000000.;
+
+        if (Spent > Budget)
+        {
+            Overruns++;
+            QuietTicks = 0;
+            if (++OverrunStreak >= 3 && ActivePeriod < MaxGranularity)
+            {
+                // Too much is playing for this rate, so run less often instead of falling behind
+                ActivePeriod = std::min(ActivePeriod * 2, (UInt32)MaxGranularity);
+                OverrunStreak = 0;
+            }
+        }
+        else
+        {
+            OverrunStreak = 0;
+            if (ActivePeriod > TickPeriod && Spent < Budget / 4 && ++QuietTicks >= 100)
+            {
+                ActivePeriod = std::max(ActivePeriod / 2, TickPeriod);
+                QuietTicks = 0;
+            }
+        }
+    }
+
+    void Publish()
+    {
+        // Status queries read these instead of waiting for the queue
+        EffectList.Publish();
+
+        UInt32 State = FFGFFS_POWERON | FFGFFS_SAFETYSWITCHOFF | FFGFFS_USERFFSWITCHON;
+        if( EffectList.Count() == 0 )
+        {
+            State |= FFGFFS_EMPTY;
+        }
+        if( Stopped == true )
+        {
+            State |= FFGFFS_STOPPED;
+        }
+        if( Paused == true )
+        {
+            State |= FFGFFS_PAUSED;
+        }
+        if (Actuator == true)
+        {
+            State |= FFGFFS_ACTUATORSON;
+        } else {
+            State |= FFGFFS_ACTUATORSOFF;
+        }
+        PublishedState = State;
+    }
+
+    // Not copyable, the core owns its effects
+    Feedback360EngineCore(const Feedback360EngineCore &src);
+    void operator = (const Feedback360EngineCore &src);
+};
+
+#endif
@@ -0,0 +1,115 @@
+/*
+    MICE Xbox 360 Controller driver for Mac OS X
+    Force Feedback module
+    Copyright (C) 2013 David Ryskalczyk
+
+    Feedback360Mixer.cpp - turns summed effect output into motor levels
+
+    This file is part of Xbox360Controller.
+
+    Xbox360Controller is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    Xbox360Controller is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Xbox360Controller; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#include "Feedback360Mixer.h"
+using std::max;
+using std::min;
+
+Feedback360Mixer::Feedback360Mixer(int theChannels, LONG theMax) : Channels(min(theChannels, MIXER_CHANNELS)),
+Max(theMax), Gain(10000), Knee(LEVEL_MAX)
+{
+    // Straight lines until told otherwise
+    for (int i = 0; i < MIXER_CHANNELS; i++)
+    {
+        for (int j = 0; j < MIXER_CURVE_POINTS; j++)
+        {
+            Curves[i][j] = (UInt16)((j * MIXER_CURVE_ONE + (MIXER_CURVE_POINTS - 1) / 2) / (MIXER_CURVE_POINTS - 1));
+        }
+    }
+}
+
+//----------------------------------------------------------------------------------------------
+// SetGain
+//----------------------------------------------------------------------------------------------
+void Feedback360Mixer::SetGain(DWORD NewGain)
+{
+    Gain = max( (DWORD)1, min( NewGain, (DWORD)10000 ) );
+}
+
+//----------------------------------------------------------------------------------------------
+// SetKnee
+//----------------------------------------------------------------------------------------------
+void Feedback360Mixer::SetKnee(LONG NewKnee)
+{
+    Knee = max( (LONG)0, min( NewKnee, LEVEL_MAX ) );
+}
+
+//----------------------------------------------------------------------------------------------
+// SetCurve
+//----------------------------------------------------------------------------------------------
+void Feedback360Mixer::SetCurve(int Channel, const UInt16 *Points)
+{
+    if (Channel < 0 || Channel >= MIXER_CHANNELS)
+    {
+        return;
+    }
+    memcpy(Curves[Channel], Points, sizeof(Curves[Channel]));
+}
+
+//----------------------------------------------------------------------------------------------
+// Mix
+//----------------------------------------------------------------------------------------------
+void Feedback360Mixer::Mix(const LONG *Sums, LONG *Levels) const
+{
+    for (int i = 0; i < Channels; i++)
+    {
+        Levels[i] = MixChannel(i, Sums[i]);
+    }
+}
+
+//----------------------------------------------------------------------------------------------
+// MixChannel
+//----------------------------------------------------------------------------------------------
+LONG Feedback360Mixer::MixChannel(int Channel, LONG Sum) const
+{
+    // The motors only take a speed, so anything below zero is off
+    SInt64 Level = max( (SInt64)0, (SInt64)Sum * Gain / 10000 );
+
+    // Above the knee the output bends towards full scale and never reaches it,
+    // with the same slope as below the knee where they meet
+    SInt64 Room = LEVEL_MAX - Knee;
+    if (Level > Knee)
+    {
+        if (Room == 0)
+        {
+            Level = LEVEL_MAX;
+        }
+        else
+        {
+            SInt64 Over = Level - Knee;
+            Level = Knee + Room * Over / (Over + Room);
+        }
+    }
+
+    // Interpolate along the curve
+    SInt64 Position = Level * (MIXER_CURVE_POINTS - 1);
+    SInt64 Point = Position / LEVEL_MAX;
+    SInt64 Output = Curves[Channel][Point];
+    if (Point < MIXER_CURVE_POINTS - 1)
+    {
+        Output += ( Curves[Channel][Point + 1] - Output ) * ( Position % LEVEL_MAX ) / LEVEL_MAX;
+    }
+
+    return (LONG)(( Output * Max + MIXER_CURVE_ONE / 2 ) / MIXER_CURVE_ONE);
+}
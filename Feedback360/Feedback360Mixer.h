@@ -0,0 +1,71 @@
+/*
+    MICE Xbox 360 Controller driver for Mac OS X
+    Force Feedback module
+    Copyright (C) 2013 David Ryskalczyk
+
+    Feedback360Mixer.h - turns summed effect output into motor levels
+
+    This file is part of Xbox360Controller.
+
+    Xbox360Controller is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    Xbox360Controller is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Xbox360Controller; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#ifndef Feedback360_Feedback360Mixer_h
+#define Feedback360_Feedback360Mixer_h
+
+#include "Feedback360Effect.h"
+
+#define MIXER_CHANNELS      4   // Left, right, left trigger, right trigger
+#define MIXER_CURVE_POINTS  17  // Curve points, evenly spaced over 0..LEVEL_MAX
+#define MIXER_CURVE_ONE     65535
+
+// A response curve for one motor, as passed to escape 0x07. Points map
+// evenly spaced levels to a share of full speed, MIXER_CURVE_ONE being full
+// speed, and output in between is interpolated. Raising the first points
+// gets a motor past the level where it stalls.
+typedef struct {
+    UInt32  Channel;
+    UInt16  Points[MIXER_CURVE_POINTS];
+} Feedback360Curve;
+
+// Everything between the effects and the device. Per channel the sum of
+// the effects has the device gain applied, is squashed above the knee so
+// it approaches full scale instead of clipping, and then goes through the
+// channel's curve to a level from 0 to Max. All integer, no allocation.
+class Feedback360Mixer
+{
+public:
+    Feedback360Mixer(int theChannels, LONG theMax);
+
+    // 1..10000, as FFPROP_FFGAIN
+    void SetGain(DWORD NewGain);
+    // Level from which output is squashed, LEVEL_MAX clips hard
+    void SetKnee(LONG NewKnee);
+    void SetCurve(int Channel, const UInt16 *Points);
+
+    // Sums holds Channels totals from Feedback360Effect::Calc
+    void Mix(const LONG *Sums, LONG *Levels) const;
+    LONG MixChannel(int Channel, LONG Sum) const;
+
+    int Channels;
+    LONG Max;
+
+private:
+    DWORD   Gain;
+    LONG    Knee;
+    UInt16  Curves[MIXER_CHANNELS][MIXER_CURVE_POINTS];
+};
+
+#endif
@@ -0,0 +1,73 @@
+/*
+    MICE Xbox 360 Controller driver for Mac OS X
+    Force Feedback module
+    Copyright (C) 2013 David Ryskalczyk
+
+    Feedback360Render.cpp - renders effects offline against a timeline
+
+    This file is part of Xbox360Controller.
+
+    Xbox360Controller is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    Xbox360Controller is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Xbox360Controller; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#include "Feedback360Render.h"
+
+void Feedback360Render(Feedback360Effect **Effects, UInt32 EffectCount,
+                       const Feedback360RenderEvent *Events, UInt32 EventCount,
+                       const Feedback360Mixer *Mixer, double Rate,
+                       UInt8 *Levels, UInt32 Count)
+{
+    UInt32 Event = 0;
+    int Channels = Mixer->Channels;
+    LONG Sum[MIXER_CHANNELS];
+
+    for (UInt32 Sample = 0; Sample < Count; Sample++)
+    {
+        double Time = Sample / Rate;
+
+        for (; Event < EventCount && Events[Event].Time <= Time; Event++)
+        {
+            if (Events[Event].Effect >= EffectCount)
+            {
+                continue;
+            }
+            Feedback360Effect *Effect = Effects[Events[Event].Effect];
+            if (Events[Event].Command == RENDER_START)
+            {
+                Effect->Status = FFEGES_PLAYING;
+                Effect->PlayCount = Events[Event].Iterations;
+                Effect->StartTime = Events[Event].Time;
+            }
+            else if (Events[Event].Command == RENDER_STOP)
+            {
+                Effect->Status = 0;
+            }
+        }
+
+        memset(Sum, 0, sizeof(Sum));
+        for (UInt32 i = 0; i < EffectCount; i++)
+        {
+            // There is no stick, so conditions stay silent
+            Effects[i]->Calc(Time, NULL, Sum, Channels);
+            // Stops effects that have finished, as EffectProc does
+            Effects[i]->NextTime(Time, 0);
+        }
+
+        for (int i = 0; i < Channels; i++)
+        {
+            Levels[Channels * Sample + i] = (UInt8)Mixer->MixChannel(i, Sum[i]);
+        }
+    }
+}
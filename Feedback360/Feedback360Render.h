@@ -0,0 +1,50 @@
+/*
+    MICE Xbox 360 Controller driver for Mac OS X
+    Force Feedback module
+    Copyright (C) 2013 David Ryskalczyk
+
+    Feedback360Render.h - renders effects offline against a timeline
+
+    This file is part of Xbox360Controller.
+
+    Xbox360Controller is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    Xbox360Controller is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Xbox360Controller; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#ifndef Feedback360_Feedback360Render_h
+#define Feedback360_Feedback360Render_h
+
+#include "Feedback360Effect.h"
+#include "Feedback360Mixer.h"
+
+#define RENDER_START    0x00
+#define RENDER_STOP     0x01
+
+typedef struct {
+    double      Time;       // Seconds from the start of the render
+    UInt32      Effect;     // Index into the effects being rendered
+    UInt32      Command;    // RENDER_START or RENDER_STOP
+    UInt32      Iterations; // As passed to StartEffect
+} Feedback360RenderEvent;
+
+// Plays Effects as the timeline says, without a device or the real clock,
+// and stores Count frames of Mixer->Channels motor levels, sampled Rate
+// times a second, into Levels. These are the levels the effect engine hands
+// to SetForce. Events must be sorted by time. The effects are played in place.
+void Feedback360Render(Feedback360Effect **Effects, UInt32 EffectCount,
+                       const Feedback360RenderEvent *Events, UInt32 EventCount,
+                       const Feedback360Mixer *Mixer, double Rate,
+                       UInt8 *Levels, UInt32 Count);
+
+#endif
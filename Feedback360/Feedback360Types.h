@@ -0,0 +1,165 @@
+/*
+    MICE Xbox 360 Controller driver for Mac OS X
+    Force Feedback module
+    Copyright (C) 2013 David Ryskalczyk
+
+    Feedback360Types.h - ForceFeedback types used by the effect code
+
+    This file is part of Xbox360Controller.
+
+    Xbox360Controller is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    Xbox360Controller is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Xbox360Controller; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#ifndef Feedback360_Feedback360Types_h
+#define Feedback360_Feedback360Types_h
+
+// The effect maths, the mixer, the renderer and the engine core only need
+// the ForceFeedback structures and a handful of constants. Where there is no
+// ForceFeedback framework, as for the host tests, they are declared here with
+// the same names, layout and values.
+#ifdef __APPLE__
+
+#include <IOKit/IOCFPlugIn.h>
+#include <ForceFeedback/IOForceFeedbackLib.h>
+
+#else
+
+#include <stdint.h>
+#include <stddef.h>
+
+typedef uint8_t     UInt8;
+typedef uint16_t    UInt16;
+typedef uint32_t    UInt32;
+typedef uint64_t    UInt64;
+typedef int32_t     SInt32;
+typedef int64_t     SInt64;
+
+typedef SInt32      LONG;
+typedef UInt32      DWORD;
+typedef UInt32      ULONG;
+typedef double      CFTimeInterval;
+
+// Only ever compared, never looked into
+typedef const struct __CFUUID *CFUUIDRef;
+
+typedef UInt32      FFEffectDownloadID;
+typedef UInt32      FFEffectStatusFlag;
+typedef UInt32      FFEffectStartFlag;
+typedef UInt32      FFEffectParameterFlag;
+typedef UInt32      FFCommandFlag;
+
+typedef struct FFENVELOPE {
+    DWORD   dwSize;
+    DWORD   dwAttackLevel;
+    DWORD   dwAttackTime;
+    DWORD   dwFadeLevel;
+    DWORD   dwFadeTime;
+} FFENVELOPE;
+
+typedef struct FFEFFECT {
+    DWORD   dwSize;
+    DWORD   dwFlags;
+    DWORD   dwDuration;
+    DWORD   dwSamplePeriod;
+    DWORD   dwGain;
+    DWORD   dwTriggerButton;
+    DWORD   dwTriggerRepeatInterval;
+    DWORD   cAxes;
+    DWORD  *rgdwAxes;
+    LONG   *rglDirection;
+    FFENVELOPE *lpEnvelope;
+    DWORD   cbTypeSpecificParams;
+    void   *lpvTypeSpecificParams;
+    DWORD   dwStartDelay;
+} FFEFFECT;
+
+typedef struct FFCONSTANTFORCE {
+    LONG    lMagnitude;
+} FFCONSTANTFORCE;
+
+typedef struct FFRAMPFORCE {
+    LONG    lStart;
+    LONG    lEnd;
+} FFRAMPFORCE;
+
+typedef struct FFPERIODIC {
+    DWORD   dwMagnitude;
+    LONG    lOffset;
+    DWORD   dwPhase;
+    DWORD   dwPeriod;
+} FFPERIODIC;
+
+typedef struct FFCONDITION {
+    LONG    lOffset;
+    LONG    lPositiveCoefficient;
+    LONG    lNegativeCoefficient;
+    DWORD   dwPositiveSaturation;
+    DWORD   dwNegativeSaturation;
+    LONG    lDeadBand;
+} FFCONDITION;
+
+typedef struct FFCUSTOMFORCE {
+    DWORD   cChannels;
+    DWORD   dwSamplePeriod;
+    DWORD   cSamples;
+    LONG   *rglForceData;
+} FFCUSTOMFORCE;
+
+#define FF_INFINITE             0xFFFFFFFF
+
+// FFEFFECT members to download, as for DirectInput's DIEP_ flags
+#define FFEP_DURATION               0x00000001
+#define FFEP_SAMPLEPERIOD           0x00000002
+#define FFEP_GAIN                   0x00000004
+#define FFEP_TRIGGERBUTTON          0x00000008
+#define FFEP_TRIGGERREPEATINTERVAL  0x00000010
+#define FFEP_AXES                   0x00000020
+#define FFEP_DIRECTION              0x00000040
+#define FFEP_ENVELOPE               0x00000080
+#define FFEP_TYPESPECIFICPARAMS     0x00000100
+#define FFEP_STARTDELAY             0x00000200
+#define FFEP_START                  0x20000000
+#define FFEP_NORESTART              0x40000000
+#define FFEP_NODOWNLOAD             0x80000000
+
+#define FFEGES_PLAYING              0x00000001
+#define FFES_SOLO                   0x00000001
+
+#define FFSFFC_RESET                0x00000001
+#define FFSFFC_STOPALL              0x00000002
+#define FFSFFC_PAUSE                0x00000004
+#define FFSFFC_CONTINUE             0x00000008
+#define FFSFFC_SETACTUATORSON       0x00000010
+#define FFSFFC_SETACTUATORSOFF      0x00000020
+
+#define FFGFFS_EMPTY                0x00000001
+#define FFGFFS_STOPPED              0x00000002
+#define FFGFFS_PAUSED               0x00000004
+#define FFGFFS_ACTUATORSON          0x00000010
+#define FFGFFS_ACTUATORSOFF         0x00000020
+#define FFGFFS_POWERON              0x00000040
+#define FFGFFS_POWEROFF             0x00000080
+#define FFGFFS_SAFETYSWITCHON       0x00000100
+#define FFGFFS_SAFETYSWITCHOFF      0x00000200
+#define FFGFFS_USERFFSWITCHON       0x00000400
+#define FFGFFS_USERFFSWITCHOFF      0x00000800
+
+// Trigger buttons are given as offsets into the joystick state
+#define FFJOFS_BUTTON0              48
+#define FFJOFS_BUTTON(n)            (FFJOFS_BUTTON0 + (n))
+
+#endif
+
+#endif
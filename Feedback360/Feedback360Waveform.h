@@ -0,0 +1,126 @@
+/*
+    MICE Xbox 360 Controller driver for Mac OS X
+    Force Feedback module
+    Copyright (C) 2013 David Ryskalczyk
+
+    Feedback360Waveform.h - fixed point periodic waveforms for the FF plugins
+
+    This file is part of Xbox360Controller.
+
+    Xbox360Controller is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    Xbox360Controller is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Xbox360Controller; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#ifndef Feedback360_Feedback360Waveform_h
+#define Feedback360_Feedback360Waveform_h
+
+#include <stdint.h>
+
+// A phase is a position in the cycle, with 2^32 being one full period.
+// Waveforms return -WAVE_ONE..WAVE_ONE and are applied as Magnitude * Wave / WAVE_ONE.
+//
+// The sine is interpolated from a 256 entry table and stays within 0.02% of
+// sin(). The older code rounded the phase down to whole degrees, so results can
+// differ from it by up to 2% of the magnitude.
+
+#define WAVE_ONE        32768
+
+static const int16_t SineTable[257] = {
+         0,    804,   1608,   2410,   3212,   4011,   4808,   5602,
+      6393,   7179,   7962,   8739,   9512,  10278,  11039,  11793,
+     12539,  13279,  14010,  14732,  15446,  16151,  16846,  17530,
+     18204,  18868,  19519,  20159,  20787,  21403,  22005,  22594,
+     23170,  23731,  24279,  24811,  25329,  25832,  26319,  26790,
+     27245,  27683,  28105,  28510,  28898,  29268,  29621,  29956,
+     30273,  30571,  30852,  31113,  31356,  31580,  31785,  31971,
+     32137,  32285,  32412,  32521,  32609,  32678,  32728,  32757,
+     32767,  32757,  32728,  32678,  32609,  32521,  32412,  32285,
+     32137,  31971,  31785,  31580,  31356,  31113,  30852,  30571,
+     30273,  29956,  29621,  29268,  28898,  28510,  28105,  27683,
+     27245,  26790,  26319,  25832,  25329,  24811,  24279,  23731,
+     23170,  22594,  22005,  21403,  20787,  20159,  19519,  18868,
+     18204,  17530,  16846,  16151,  15446,  14732,  14010,  13279,
+     12539,  11793,  11039,  10278,   9512,   8739,   7962,   7179,
+      6393,   5602,   4808,   4011,   3212,   2410,   1608,    804,
+         0,   -804,  -1608,  -2410,  -3212,  -4011,  -4808,  -5602,
+     -6393,  -7179,  -7962,  -8739,  -9512, -10278, -11039, -11793,
+    -12539, -13279, -14010, -14732, -15446, -16151, -16846, -17530,
+    -18204, -18868, -19519, -20159, -20787, -21403, -22005, -22594,
+    -23170, -23731, -24279, -24811, -25329, -25832, -26319, -26790,
+    -27245, -27683, -28105, -28510, -28898, -29268, -29621, -29956,
+    -30273, -30571, -30852, -31113, -31356, -31580, -31785, -31971,
+    -32137, -32285, -32412, -32521, -32609, -32678, -32728, -32757,
+    -32767, -32757, -32728, -32678, -32609, -32521, -32412, -32285,
+    -32137, -31971, -31785, -31580, -31356, -31113, -30852, -30571,
+    -30273, -29956, -29621, -29268, -28898, -28510, -28105, -27683,
+    -27245, -26790, -26319, -25832, -25329, -24811, -24279, -23731,
+    -23170, -22594, -22005, -21403, -20787, -20159, -19519, -18868,
+    -18204, -17530, -16846, -16151, -15446, -14732, -14010, -13279,
+    -12539, -11793, -11039, -10278,  -9512,  -8739,  -7962,  -7179,
+     -6393,  -5602,  -4808,  -4011,  -3212,  -2410,  -1608,   -804,
+         0,
+};
+
+static inline uint32_t WavePhase(uint32_t Position, uint32_t Period)
+{
+    return (uint32_t)(((uint64_t)(Position % Period) << 32) / Period);
+}
+
+static inline uint32_t WavePhaseStep(uint32_t Period)
+{
+    return (uint32_t)((1ULL << 32) / Period);
+}
+
+static inline uint32_t WavePhaseOffset(uint32_t Hundredths)
+{
+    return (uint32_t)(((uint64_t)(Hundredths % 36000) << 32) / 36000);
+}
+
+static inline int32_t WaveSine(uint32_t Phase)
+{
+    int32_t Index = Phase >> 24;
+    int32_t Fraction = (Phase >> 8) & 0xFFFF;
+    int32_t Low = SineTable[Index];
+    int32_t High = SineTable[Index + 1];
+
+    return Low + (((High - Low) * Fraction) >> 16);
+}
+
+static inline int32_t WaveSquare(uint32_t Phase)
+{
+    return (Phase < 0x80000000) ? WAVE_ONE : -WAVE_ONE;
+}
+
+// Starts at -1 and peaks at +1 half way through
+static inline int32_t WaveTriangle(uint32_t Phase)
+{
+    int32_t Position = Phase >> 16;
+
+    if (Position < 0x8000)
+        return -WAVE_ONE + (Position * 2);
+    return WAVE_ONE - ((Position - 0x8000) * 2);
+}
+
+// Rises from -1 to +1 over the period
+static inline int32_t WaveSawtoothUp(uint32_t Phase)
+{
+    return (int32_t)(Phase >> 16) - WAVE_ONE;
+}
+
+static inline int32_t WaveSawtoothDown(uint32_t Phase)
+{
+    return -WaveSawtoothUp(Phase);
+}
+
+#endif
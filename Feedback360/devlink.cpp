@@ -22,8 +22,38 @@
 */
 
 #include <IOKit/IOCFPlugIn.h>
+#include <IOKit/hid/IOHIDUsageTables.h>
 #include "devlink.h"
 
+// Find the cookie of an input element
+static IOHIDElementCookie Device_FindElement(DeviceLink *link,int page,int usage)
+{
+    IOHIDElementCookie cookie = 0;
+    CFMutableDictionaryRef match = CFDictionaryCreateMutable(kCFAllocatorDefault, 0, &kCFTypeDictionaryKeyCallBacks, &kCFTypeDictionaryValueCallBacks);
+    CFNumberRef number = CFNumberCreate(kCFAllocatorDefault, kCFNumberIntType, &page);
+    CFDictionarySetValue(match, CFSTR(kIOHIDElementUsagePageKey), number);
+    CFRelease(number);
+    number = CFNumberCreate(kCFAllocatorDefault, kCFNumberIntType, &usage);
+    CFDictionarySetValue(match, CFSTR(kIOHIDElementUsageKey), number);
+    CFRelease(number);
+
+    CFArrayRef elements = NULL;
+    if ((*link->interface)->copyMatchingElements(link->interface, match, &elements) == kIOReturnSuccess && elements != NULL) {
+        if (CFArrayGetCount(elements) > 0) {
+            CFDictionaryRef element = (CFDictionaryRef)CFArrayGetValueAtIndex(elements, 0);
+            CFNumberRef value = (CFNumberRef)CFDictionaryGetValue(element, CFSTR(kIOHIDElementCookieKey));
+            if (value != NULL) {
+                long raw = 0;
+                CFNumberGetValue(value, kCFNumberLongType, &raw);
+                cookie = (IOHIDElementCookie)raw;
+            }
+        }
+        CFRelease(elements);
+    }
+    CFRelease(match);
+    return cookie;
+}
+
 // Initialise the link
 bool Device_Initialise(DeviceLink *link,io_object_t device)
 {
@@ -32,10 +62,14 @@ bool Device_Initialise(DeviceLink *link,io_object_t device)
     IOReturn ret = IOCreatePlugInInterfaceForService(device, kIOHIDDeviceUserClientTypeID, kIOCFPlugInInterfaceID, &plugInInterface, &score);
 
     if (ret!=kIOReturnSuccess) return false;
-    ret=(*plugInInterface)->QueryInterface(plugInInterface, CFUUIDGetUUIDBytes(kIOHIDDeviceInterfaceID121), (LPVOID*)(&link->interface));
+    ret=(*plugInInterface)->QueryInterface(plugInInterface, CFUUIDGetUUIDBytes(kIOHIDDeviceInterfaceID122), (LPVOID*)(&link->interface));
     (*plugInInterface)->Release(plugInInterface);
     if (ret!=kIOReturnSuccess) return false;
     (*link->interface)->open(link->interface, 0);
+    link->axes[0] = Device_FindElement(link, kHIDPage_GenericDesktop, kHIDUsage_GD_X);
+    link->axes[1] = Device_FindElement(link, kHIDPage_GenericDesktop, kHIDUsage_GD_Y);
+    for (int i = 0; i < 32; i++)
+        link->buttons[i] = Device_FindElement(link, kHIDPage_Button, i + 1);
     return true;
 }
 
@@ -62,3 +96,31 @@ bool Device_Send(DeviceLink *link,void *data,int length)
         return res == kIOReturnSuccess;
     }
 }
+
+// Read the stick position via the link
+bool Device_ReadAxes(DeviceLink *link,SInt32 *x,SInt32 *y)
+{
+    if(link->interface==NULL || link->axes[0]==0 || link->axes[1]==0) return false;
+
+    IOHIDEventStruct event;
+    if ((*link->interface)->getElementValue(link->interface, link->axes[0], &event) != kIOReturnSuccess) return false;
+    *x = event.value;
+    if ((*link->interface)->getElementValue(link->interface, link->axes[1], &event) != kIOReturnSuccess) return false;
+    *y = event.value;
+    return true;
+}
+
+// Read the buttons via the link
+bool Device_ReadButtons(DeviceLink *link,UInt32 *buttons)
+{
+    if(link->interface==NULL) return false;
+
+    IOHIDEventStruct event;
+    *buttons = 0;
+    for (int i = 0; i < 32; i++) {
+        if (link->buttons[i] == 0) continue;
+        if ((*link->interface)->getElementValue(link->interface, link->buttons[i], &event) != kIOReturnSuccess) return false;
+        if (event.value != 0) *buttons |= 1u << i;
+    }
+    return true;
+}
@@ -27,7 +27,9 @@
 #include <IOKit/hid/IOHIDLib.h>
 
 typedef struct {
-    IOHIDDeviceInterface121 **interface;
+    IOHIDDeviceInterface122 **interface;
+    IOHIDElementCookie axes[2];     // Left stick X and Y, 0 if not found
+    IOHIDElementCookie buttons[32]; // Buttons 1 to 32, 0 if not found
 } DeviceLink;
 
 bool Device_Initialise(DeviceLink *link,io_object_t device);
@@ -35,4 +37,11 @@ void Device_Finalise(DeviceLink *link);
 
 bool Device_Send(DeviceLink *link,void *data,int length);
 
+// Reads the left stick from the element values the driver keeps up to date,
+// without going through a HID queue
+bool Device_ReadAxes(DeviceLink *link,SInt32 *x,SInt32 *y);
+
+// Reads the buttons the same way, bit n is set while button n+1 is down
+bool Device_ReadButtons(DeviceLink *link,UInt32 *buttons);
+
 #endif
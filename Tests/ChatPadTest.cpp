@@ -0,0 +1,238 @@
+/*
+    MICE Xbox 360 Controller driver for Mac OS X
+    Copyright (C) 2006-2013 Colin Munro
+
+    ChatPadTest.cpp - replays ChatPad messages through the key translation
+
+    This file is part of Xbox360Controller.
+
+    Xbox360Controller is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    Xbox360Controller is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Foobar; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+#include <ctype.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+#include "TestCommon.h"
+#include "../WirelessGamingReceiver/protocol.h"
+#include "../360Controller/chatpadkeys.h"
+
+// A replay file holds ChatPad messages as the receiver passes them on, each a
+// connection number then the bytes, followed by "=" and the keyboard report
+// the driver should make of it, or "= -" for none. An "offset" line sets where
+// the key report sits, as the ChatPadDataOffset setting does.
+// Running with --record rewrites the expectations from what the code does now,
+// so a fresh capture without them can be turned into a replay file
+typedef struct CHATPAD_LINE
+{
+    std::string text;           // As read, for the lines that are not messages
+    bool message;
+    int index;
+    std::vector<unsigned char> data;
+    std::string expected;
+} CHATPAD_LINE;
+
+static bool ReadReplay(const char *path, std::vector<CHATPAD_LINE> *lines)
+{
+    FILE *file = fopen(path, "r");
+    char buffer[512];
+
+    if (file == NULL)
+        return false;
+    while (fgets(buffer, sizeof(buffer), file) != NULL)
+    {
+        CHATPAD_LINE line;
+        char *p = buffer, *end, *equals;
+
+        buffer[strcspn(buffer, "\r\n")] = '\0';
+        line.text = buffer;
+        line.message = false;
+        while (isspace((unsigned char)*p))
+            p++;
+        if ((*p == '\0') || (*p == '#') || (strncmp(p, "offset", 6) == 0))
+        {
+            lines->push_back(line);
+            continue;
+        }
+        line.message = true;
+        equals = strchr(p, '=');
+        if (equals != NULL)
+        {
+            *equals = '\0';
+            for (equals++; isspace((unsigned char)*equals); equals++)
+                ;
+            line.expected = equals;
+        }
+        line.index = (int)strtol(p, &end, 10);
+        p = end;
+        for (;;)
+        {
+            long value = strtol(p, &end, 16);
+
+            if (end == p)
+                break;
+            line.data.push_back((unsigned char)value);
+            p = end;
+        }
+        lines->push_back(line);
+    }
+    fclose(file);
+    return true;
+}
+
+// What WirelessHIDDevice and the ChatPad keyboard do with a message
+static std::string Replay(const CHATPAD_LINE &line, int offset)
+{
+    unsigned char message[WIRELESS_PACKET_SIZE];
+    unsigned char report[CHATPAD_REPORT_LENGTH];
+    const unsigned char *found;
+    std::string result;
+    char hex[4];
+
+    if (line.data.size() != WIRELESS_MSG_LENGTH)
+        return "-";
+    memcpy(message, &line.data[0], line.data.size());
+    found = WirelessChatPadReport(message, (int)line.data.size(), offset);
+    if (found == NULL)
+        return "-";
+    memcpy(report, found, sizeof(report));
+    ChatPadTranslateReport(report, sizeof(report));
+    for (size_t i = 0; i < sizeof(report); i++)
+    {
+        snprintf(hex, sizeof(hex), i == 0 ? "%.2x" : " %.2x", report[i]);
+        result += hex;
+    }
+    return result;
+}
+
+static void TestReplay(const char *path, bool record)
+{
+    std::vector<CHATPAD_LINE> lines;
+    int offset = WIRELESS_CHATPAD_DATA;
+    int messages = 0;
+
+    CHECK(ReadReplay(path, &lines));
+    for (size_t i = 0; i < lines.size(); i++)
+    {
+        CHATPAD_LINE &line = lines[i];
+
+        if (!line.message)
+        {
+            const char *p = line.text.c_str();
+
+            while (isspace((unsigned char)*p))
+                p++;
+            if (strncmp(p, "offset", 6) == 0)
+                offset = atoi(p + 6);
+            continue;
+        }
+        std::string actual = Replay(line, offset);
+
+        messages++;
+        if (record)
+        {
+            line.expected = actual;
+            continue;
+        }
+        if (actual != line.expected)
+        {
+            fprintf(stderr, "%s:%d: got %s, expected %s\n", path, (int)i + 1, actual.c_str(), line.expected.c_str());
+            TestFailures++;
+        }
+    }
+    CHECK(messages > 0);
+
+    if (record)
+    {
+        FILE *file = fopen(path, "w");
+
+        CHECK(file != NULL);
+        if (file == NULL)
+            return;
+        for (size_t i = 0; i < lines.size(); i++)
+        {
+            const CHATPAD_LINE &line = lines[i];
+
+            if (!line.message)
+            {
+                fprintf(file, "%s\n", line.text.c_str());
+                continue;
+            }
+            fprintf(file, "%d", line.index);
+            for (size_t j = 0; j < line.data.size(); j++)
+                fprintf(file, " %.2x", line.data[j]);
+            fprintf(file, " = %s\n", line.expected.c_str());
+        }
+        fclose(file);
+    }
+}
+
+// The translation table, against the USB usages of some known keys
+static void TestKeys(void)
+{
+    unsigned char report[] = {0x00, 0x01, 0x17, 0x37, 0x08};
+    unsigned char status[] = {0xf0, 0x03, 0x17, 0x37, 0x08};
+
+    CHECK_EQUAL(0x1E, ChatPad2USB(0x17));   // 1
+    CHECK_EQUAL(0x04, ChatPad2USB(0x37));   // A
+    CHECK_EQUAL(0x28, ChatPad2USB(0x63));   // Return
+    CHECK_EQUAL(0x2C, ChatPad2USB(0x54));   // Space
+    CHECK_EQUAL(0x00, ChatPad2USB(0x00));
+    CHECK_EQUAL(0x00, ChatPad2USB(0x08));   // No such row
+    CHECK_EQUAL(0x00, ChatPad2USB(0x81));   // No such column
+
+    ChatPadTranslateReport(report, sizeof(report));
+    CHECK_EQUAL(0x01, report[1]);           // Modifiers are left alone
+    CHECK_EQUAL(0x1E, report[2]);
+    CHECK_EQUAL(0x04, report[3]);
+    CHECK_EQUAL(0x00, report[4]);
+
+    // Status reports and short reports are not keys
+    ChatPadTranslateReport(status, sizeof(status));
+    CHECK_EQUAL(0x17, status[2]);
+    report[2] = 0x17;
+    ChatPadTranslateReport(report, CHATPAD_REPORT_LENGTH - 1);
+    CHECK_EQUAL(0x17, report[2]);
+}
+
+// The control commands are the size of every other output command
+static void TestCommands(void)
+{
+    const unsigned char init[] = {WIRELESS_CHATPAD(WIRELESS_CHATPAD_INIT)};
+    const unsigned char poweroff[] = {WIRELESS_POWEROFF};
+
+    CHECK_EQUAL(sizeof(poweroff), sizeof(init));
+    CHECK_EQUAL(WIRELESS_CHATPAD_INIT, init[3]);
+    CHECK(!WIRELESS_IS_LED(init));
+    CHECK(!WIRELESS_IS_RUMBLE(init));
+}
+
+int main(int argc, char **argv)
+{
+    bool record = false;
+    const char *path = "data/chatpad-keys.txt";
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--record") == 0)
+            record = true;
+        else
+            path = argv[i];
+    }
+    TestKeys();
+    TestCommands();
+    TestReplay(path, record);
+    return TestResult("chatpad");
+}
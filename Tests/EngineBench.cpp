@@ -0,0 +1,707 @@
+/*
+    MICE Xbox 360 Controller driver for Mac OS X
+    Copyright (C) 2006-2013 Colin Munro
+
+    EngineBench.cpp - timings of the effect loop, the effect table and the renderer
+
+    This file is part of Xbox360Controller.
+
+    Xbox360Controller is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    Xbox360Controller is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Foobar; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+#include <algorithm>
+#include <atomic>
+#include <float.h>
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include <thread>
+#include <time.h>
+#include <vector>
+#include "../Feedback360/Feedback360EngineCore.h"
+#include "../Feedback360/Feedback360Render.h"
+
+// Each section runs the engine core the way Feedback360Engine's queue would,
+// with a clock that the loop moves on by one tick period per tick, so the
+// effects see the same times on every host and only the wall time differs
+
+static double Now = 0;
+
+static double FakeClock(void)
+{
+    return Now;
+}
+
+static double Seconds(void)
+{
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec + (now.tv_nsec / 1e9);
+}
+
+// Stands in for the plugin, keeping only what is needed to stop the compiler
+// throwing the work away
+struct NullDevice
+{
+    LONG Sum;
+    SInt32 X, Y;
+
+    NullDevice() : Sum(0), X(0), Y(0) {}
+
+    void SetForce(const LONG *Levels)
+    {
+        Sum += Levels[0] + Levels[1];
+    }
+
+    bool ReadStick(SInt32 *theX, SInt32 *theY)
+    {
+        *theX = X;
+        *theY = Y;
+        return true;
+    }
+
+    bool ReadButtons(UInt32 *)
+    {
+        return false;
+    }
+
+    double SetPulse(const LONG *, double, double, double)
+    {
+        return 0;
+    }
+};
+
+typedef Feedback360EngineCore<NullDevice, 2, 255> EngineCore;
+
+// Long enough to outlast any run, short enough for ramps to move
+#define BENCH_DURATION  3600000000u     // us
+
+// Downloads and starts one of the effect kinds that play without the stick,
+// cycling through them by number, with an envelope on every other one
+static FFEffectDownloadID AddEffect(EngineCore *core, int number)
+{
+    static const int kinds[] = {CONSTANT_FORCE, SINE, SQUARE, TRIANGLE, SAWTOOTH_UP, RAMP_FORCE, CUSTOM_FORCE};
+    int kind = kinds[number % (sizeof(kinds) / sizeof(kinds[0]))];
+    FFEFFECT effect = {};
+    FFENVELOPE envelope = {sizeof(FFENVELOPE), 0, 200000, 0, 0};
+    FFCONSTANTFORCE constant = {2000};
+    FFRAMPFORCE ramp = {-3000, 3000};
+    FFPERIODIC periodic = {3000, 500, 0, 50000};
+    LONG data[1000];
+    FFCUSTOMFORCE custom = {1, 1000, 1000, data};
+    std::vector<int16_t> samples;
+    FFEffectDownloadID handle = core->EffectList.Reserve();
+
+    if (handle == 0)
+        return 0;
+    effect.dwSize = sizeof(effect);
+    effect.dwDuration = BENCH_DURATION;
+    effect.dwGain = 10000;
+    switch (kind)
+    {
+        case CONSTANT_FORCE:
+            effect.cbTypeSpecificParams = sizeof(constant);
+            effect.lpvTypeSpecificParams = &constant;
+            break;
+        case RAMP_FORCE:
+            effect.cbTypeSpecificParams = sizeof(ramp);
+            effect.lpvTypeSpecificParams = &ramp;
+            break;
+        case CUSTOM_FORCE:
+            for (int i = 0; i < 1000; i++)
+                data[i] = (i * 37) % 10000;
+            Feedback360Effect::CopySamples(data, 1000, &samples);
+            effect.cbTypeSpecificParams = sizeof(custom);
+            effect.lpvTypeSpecificParams = &custom;
+            break;
+        default:
+            periodic.dwPhase = (number * 4500) % 36000;
+            effect.cbTypeSpecificParams = sizeof(periodic);
+            effect.lpvTypeSpecificParams = &periodic;
+            break;
+    }
+    if (number % 2)
+        effect.lpEnvelope = &envelope;
+    core->DownloadEffect(handle, true, NULL, kind, &effect, samples,
+                         FFEP_DURATION | FFEP_GAIN | FFEP_TYPESPECIFICPARAMS | FFEP_ENVELOPE);
+    core->StartEffect(handle, 0, 1);
+    return handle;
+}
+
+// Wall time of one tick with the core's tick period between ticks
+static double TickCost(EngineCore *core, int ticks)
+{
+    double period = LoopGranularity / 1000000.;
+    double start = Seconds();
+
+    for (int i = 0; i < ticks; i++)
+    {
+        core->Tick();
+        Now += period;
+    }
+    return (Seconds() - start) / ticks;
+}
+
+// Tick cost against the number of effects playing at once
+static void BenchTick(void)
+{
+    static const int counts[] = {1, 4, 16, 64, 128, 256};
+
+    printf("tick cost, mixed effects\n");
+    for (size_t i = 0; i < sizeof(counts) / sizeof(counts[0]); i++)
+    {
+        NullDevice device;
+        EngineCore core(&device, FakeClock);
+
+        Now = 1;
+        for (int j = 0; j < counts[i]; j++)
+            AddEffect(&core, j);
+        core.Wake();
+        TickCost(&core, 100);
+        // Under an hour of effect time, so nothing runs out
+        double cost = TickCost(&core, std::min(300000, 2000000 / counts[i] + 1000));
+        Feedback360EngineStats stats;
+        core.GetStats(&stats);
+        printf("  %3d effects: %8.0f ns per tick, %5.0f ns per effect%s\n",
+               counts[i], cost * 1e9, cost * 1e9 / counts[i],
+               (stats.ActiveEffects == (UInt32)counts[i]) ? "" : " (some stopped)");
+    }
+}
+
+// Effects created and destroyed at random around a live population, with a
+// tick now and then as a game would see. Every destroyed handle is tried
+// again afterwards and must be refused, whatever has taken its slot since
+static void BenchChurn(void)
+{
+    static const int populations[] = {16, 128, 250};
+    const int operations = 1000000;
+
+    printf("create and destroy, %d operations\n", operations);
+    for (size_t i = 0; i < sizeof(populations) / sizeof(populations[0]); i++)
+    {
+        NullDevice device;
+        EngineCore core(&device, FakeClock);
+        std::vector<FFEffectDownloadID> live;
+        unsigned int state = 1;
+        int created = 0, destroyed = 0, refused = 0, stale = 0;
+        double createTime = 0, destroyTime = 0;
+
+        Now = 1;
+        for (int j = 0; j < operations; j++)
+        {
+            state ^= state << 13;
+            state ^= state >> 17;
+            state ^= state << 5;
+            if (((int)live.size() < populations[i]) && ((live.size() < 2) || (state & 1)))
+            {
+                double start = Seconds();
+                FFEffectDownloadID handle = AddEffect(&core, j);
+                createTime += Seconds() - start;
+                if (handle == 0)
+                {
+                    refused++;
+                    continue;
+                }
+                live.push_back(handle);
+                created++;
+            }
+            else
+            {
+                size_t victim = (state >> 8) % live.size();
+                FFEffectDownloadID handle = live[victim];
+                FFEffectStatusFlag status;
+
+                double start = Seconds();
+                core.DestroyEffect(handle);
+                destroyTime += Seconds() - start;
+                live[victim] = live.back();
+                live.pop_back();
+                destroyed++;
+
+                // Lookup only sees a destroyed effect go after the next Publish
+                core.Wake();
+                if ((core.EffectList.Find(handle) != NULL) || core.EffectList.Lookup(handle, &status)
+                    || core.DestroyEffect(handle))
+                    stale++;
+            }
+            if ((j % 100) == 0)
+            {
+                core.Tick();
+                Now += LoopGranularity / 1000000.;
+            }
+        }
+        printf("  %3d live: %6.0f ns per create, %6.0f ns per destroy, %d created, %d refused, %d stale handles accepted\n",
+               populations[i], createTime * 1e9 / created, destroyTime * 1e9 / destroyed, created, refused, stale);
+    }
+}
+
+// Handles reserved by an API caller on their way to the effect queue, which
+// dispatch_async carries in the plugin. One writer and one reader. Small
+// enough that four callers and the playing effects never fill the table
+struct HandOff
+{
+    enum { Size = 32 };
+    FFEffectDownloadID Handles[Size];
+    std::atomic<UInt32> Head, Tail;
+
+    HandOff() : Head(0), Tail(0) {}
+
+    bool Push(FFEffectDownloadID Handle)
+    {
+        UInt32 tail = Tail.load(std::memory_order_relaxed);
+        if (tail - Head.load(std::memory_order_acquire) == Size)
+            return false;
+        Handles[tail % Size] = Handle;
+        Tail.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool Pop(FFEffectDownloadID *Handle)
+    {
+        UInt32 head = Head.load(std::memory_order_relaxed);
+        if (head == Tail.load(std::memory_order_acquire))
+            return false;
+        *Handle = Handles[head % Size];
+        Head.store(head + 1, std::memory_order_release);
+        return true;
+    }
+};
+
+static double Percentile(std::vector<double> *times, double fraction)
+{
+    size_t index = std::min(times->size() - 1, (size_t)(fraction * times->size()));
+
+    std::nth_element(times->begin(), times->begin() + index, times->end());
+    return (*times)[index];
+}
+
+// What an API call costs the caller's thread while the effect queue is busy.
+// Callers reserve handles, look up a playing effect and read the device
+// state, the calls that answer without waiting for the queue. Meanwhile the
+// queue ticks 64 effects and installs and destroys every handle it is handed,
+// so Reserve contends with the frees
+static void BenchApi(void)
+{
+    static const int callerCounts[] = {1, 2, 4};
+    const int calls = 200000;
+
+    printf("API calls from other threads, %d each, 64 effects playing\n", calls);
+    for (size_t i = 0; i < sizeof(callerCounts) / sizeof(callerCounts[0]); i++)
+    {
+        int callers = callerCounts[i];
+        NullDevice device;
+        EngineCore core(&device, FakeClock);
+        std::vector<HandOff> queues(callers);
+        std::vector<std::vector<double> > reserveTimes(callers), lookupTimes(callers);
+        std::atomic<int> running(callers);
+        std::atomic<UInt32> refused(0), missed(0);
+        std::vector<std::thread> threads;
+
+        Now = 1;
+        FFEffectDownloadID playing = 0;
+        for (int j = 0; j < 64; j++)
+            playing = AddEffect(&core, j);
+        core.Wake();
+
+        for (int c = 0; c < callers; c++)
+        {
+            threads.push_back(std::thread([&, c]() {
+                FFEffectStatusFlag status;
+                volatile UInt32 sink = 0;
+
+                reserveTimes[c].reserve(calls);
+                lookupTimes[c].reserve(calls);
+                for (int j = 0; j < calls; j++)
+                {
+                    double start = Seconds();
+                    FFEffectDownloadID handle = core.EffectList.Reserve();
+                    double reserved = Seconds();
+                    bool found = core.EffectList.Lookup(playing, &status);
+                    sink = sink + core.State();
+                    double looked = Seconds();
+
+                    reserveTimes[c].push_back(reserved - start);
+                    lookupTimes[c].push_back(looked - reserved);
+                    if (!found)
+                        missed++;
+                    if (handle == 0)
+                        refused++;
+                    else
+                    {
+                        while (!queues[c].Push(handle))
+                            std::this_thread::yield();
+                    }
+                }
+                running--;
+            }));
+        }
+
+        // The effect queue
+        for (;;)
+        {
+            bool last = (running == 0), idle = true;
+            FFEffectDownloadID handle;
+
+            for (int c = 0; c < callers; c++)
+            {
+                while (queues[c].Pop(&handle))
+                {
+                    core.EffectList.Install(handle);
+                    core.DestroyEffect(handle);
+                    idle = false;
+                }
+            }
+            core.Wake();
+            core.Tick();
+            Now += LoopGranularity / 1000000.;
+            if (last)
+                break;
+            // Nothing came in, so let the callers run as the timer would
+            if (idle)
+                std::this_thread::yield();
+        }
+        for (int c = 0; c < callers; c++)
+            threads[c].join();
+
+        // Every slot but the playing effects' must be free again
+        int free = 0;
+        while (core.EffectList.Reserve() != 0)
+            free++;
+
+        std::vector<double> reserve, lookup;
+        for (int c = 0; c < callers; c++)
+        {
+            reserve.insert(reserve.end(), reserveTimes[c].begin(), reserveTimes[c].end());
+            lookup.insert(lookup.end(), lookupTimes[c].begin(), lookupTimes[c].end());
+        }
+        printf("  %d caller%s: Reserve %4.0f ns median, %6.0f ns 99.9%%, %8.0f ns worst;"
+               " Lookup and State %4.0f ns median, %6.0f ns 99.9%%, %8.0f ns worst; %u refused, %u missed, %d of %d slots free after\n",
+               callers, (callers == 1) ? " " : "s",
+               Percentile(&reserve, 0.5) * 1e9, Percentile(&reserve, 0.999) * 1e9, Percentile(&reserve, 1) * 1e9,
+               Percentile(&lookup, 0.5) * 1e9, Percentile(&lookup, 0.999) * 1e9, Percentile(&lookup, 1) * 1e9,
+               refused.load(), missed.load(), free, EngineCore::Capacity - 64);
+    }
+}
+
+// Downloads and starts a custom force playing Samples one per millisecond
+static FFEffectDownloadID AddCustom(EngineCore *core, std::vector<int16_t> &samples)
+{
+    FFEFFECT effect = {};
+    FFCUSTOMFORCE custom = {1, 1000, (DWORD)samples.size(), NULL};
+    FFEffectDownloadID handle = core->EffectList.Reserve();
+
+    effect.dwSize = sizeof(effect);
+    effect.dwDuration = BENCH_DURATION;
+    effect.dwGain = 10000;
+    effect.cbTypeSpecificParams = sizeof(custom);
+    effect.lpvTypeSpecificParams = &custom;
+    core->DownloadEffect(handle, true, NULL, CUSTOM_FORCE, &effect, samples,
+                         FFEP_DURATION | FFEP_GAIN | FFEP_TYPESPECIFICPARAMS);
+    core->StartEffect(handle, 0, 1);
+    return handle;
+}
+
+// Custom forces with very many samples. A download copies the caller's data
+// once into the effect's own buffer and after that the length must not show
+// in the tick. A stream grows a short effect a chunk at a time as it plays
+static void BenchSamples(void)
+{
+    static const DWORD counts[] = {1000, 100000, 10000000};
+    const DWORD streamed = 10000000, chunk = 1000;
+
+    printf("custom force samples\n");
+    for (size_t i = 0; i < sizeof(counts) / sizeof(counts[0]); i++)
+    {
+        NullDevice device;
+        EngineCore core(&device, FakeClock);
+        std::vector<LONG> data(counts[i]);
+        std::vector<int16_t> samples;
+
+        for (DWORD j = 0; j < counts[i]; j++)
+            data[j] = ((LONG)(j * 37) % 20001) - 10000;
+        Now = 1;
+        double start = Seconds();
+        Feedback360Effect::CopySamples(&data[0], counts[i], &samples);
+        double copied = Seconds();
+        AddCustom(&core, samples);
+        double downloaded = Seconds();
+        core.Wake();
+        TickCost(&core, 100);
+        double cost = TickCost(&core, 100000);
+        printf("  %8u samples: copy %5.2f ns per sample, download %6.0f ns, %5.0f ns per tick\n",
+               counts[i], (copied - start) * 1e9 / counts[i], (downloaded - copied) * 1e9, cost * 1e9);
+    }
+
+    NullDevice device;
+    EngineCore core(&device, FakeClock);
+    std::vector<int16_t> samples(chunk);
+    std::vector<double> appendTimes;
+    double tickTime = 0;
+    int ticks = 0;
+
+    for (DWORD j = 0; j < chunk; j++)
+        samples[j] = (int16_t)((j * 37) % 20001 - 10000);
+    Now = 1;
+    FFEffectDownloadID handle = AddCustom(&core, samples);
+    core.Wake();
+    // Each chunk lasts a second at a sample a millisecond. Ticking 0.3 s per
+    // chunk keeps the stream ahead of playback and inside the effect's hour
+    for (DWORD total = chunk; total < streamed; total += chunk)
+    {
+        samples.assign(chunk, 1000);
+        double start = Seconds();
+        core.AppendSamples(handle, samples);
+        appendTimes.push_back(Seconds() - start);
+        start = Seconds();
+        core.Tick();
+        tickTime += Seconds() - start;
+        ticks++;
+        Now += 0.3;
+    }
+    Feedback360EngineStats stats;
+    core.GetStats(&stats);
+    printf("  streamed to %u in %u sample chunks: append %5.2f ns per sample median, %8.0f ns worst; %5.0f ns per tick%s\n",
+           streamed, chunk, Percentile(&appendTimes, 0.5) * 1e9 / chunk, Percentile(&appendTimes, 1) * 1e9,
+           tickTime * 1e9 / ticks, (stats.ActiveEffects == 1) ? "" : " (stopped)");
+}
+
+// Frames the offline renderer produces a second, with the effects built by
+// the same downloads the engine uses. Rendering at 1 kHz keeps the hundred
+// seconds of the longest run inside every effect's duration
+static void BenchRender(void)
+{
+    static const int counts[] = {1, 16, 64, 256};
+    const double rate = 1000;
+
+    printf("offline render at %.0f frames a second of effect time\n", rate);
+    for (size_t i = 0; i < sizeof(counts) / sizeof(counts[0]); i++)
+    {
+        NullDevice device;
+        EngineCore core(&device, FakeClock);
+        Feedback360Mixer mixer(2, 255);
+        std::vector<Feedback360Effect*> effects;
+        std::vector<Feedback360RenderEvent> events;
+        UInt32 frames = std::min(100000, 20000000 / counts[i]);
+        std::vector<UInt8> levels(frames * mixer.Channels);
+
+        Now = 0;
+        for (int j = 0; j < counts[i]; j++)
+        {
+            Feedback360RenderEvent event = {0, (UInt32)j, RENDER_START, 1};
+            effects.push_back(core.EffectList.Find(AddEffect(&core, j)));
+            events.push_back(event);
+        }
+        double start = Seconds();
+        Feedback360Render(&effects[0], counts[i], &events[0], counts[i], &mixer, rate, &levels[0], frames);
+        double elapsed = Seconds() - start;
+        UInt32 sum = 0;
+        for (size_t j = 0; j < levels.size(); j++)
+            sum += levels[j];
+        printf("  %3d effects: %9.0f frames/s, %10.0f effect frames/s%s\n",
+               counts[i], frames / elapsed, frames * counts[i] / elapsed, (sum == 0) ? " (silent)" : "");
+    }
+}
+
+// Downloads and starts a condition of the given kind on both stick axes,
+// or a constant force for comparison
+static FFEffectDownloadID AddCondition(EngineCore *core, int kind, int number)
+{
+    FFEFFECT effect = {};
+    FFCONDITION conditions[2] = {
+        {(number % 5) * 500, 6000, 4000, 10000, 8000, 500},
+        {-(number % 3) * 700, 3000, 7000, 9000, 10000, 300},
+    };
+    FFCONSTANTFORCE constant = {2000};
+    std::vector<int16_t> samples;
+    FFEffectDownloadID handle = core->EffectList.Reserve();
+
+    effect.dwSize = sizeof(effect);
+    effect.dwDuration = BENCH_DURATION;
+    effect.dwGain = 10000;
+    if (kind == CONSTANT_FORCE)
+    {
+        effect.cbTypeSpecificParams = sizeof(constant);
+        effect.lpvTypeSpecificParams = &constant;
+    }
+    else
+    {
+        effect.cAxes = 2;
+        effect.cbTypeSpecificParams = sizeof(conditions);
+        effect.lpvTypeSpecificParams = conditions;
+    }
+    core->DownloadEffect(handle, true, NULL, kind, &effect, samples,
+                         FFEP_DURATION | FFEP_GAIN | FFEP_TYPESPECIFICPARAMS);
+    core->StartEffect(handle, 0, 1);
+    return handle;
+}
+
+// Tick cost of condition effects, which read the stick once a tick and work
+// from its position, velocity and acceleration, against constant forces in
+// the same numbers. The stick circles once a second so every term moves
+static void BenchConditions(void)
+{
+    static const int counts[] = {1, 4, 16, 64, 256};
+    static const struct { int Kind; const char *Name; } kinds[] = {
+        {CONSTANT_FORCE, "constant"}, {SPRING, "spring"}, {DAMPER, "damper"},
+        {INERTIA, "inertia"}, {FRICTION, "friction"}, {-1, "all four"},
+    };
+    static const int conditions[] = {SPRING, DAMPER, INERTIA, FRICTION};
+
+    printf("tick cost, condition effects with the stick moving\n");
+    for (size_t k = 0; k < sizeof(kinds) / sizeof(kinds[0]); k++)
+    {
+        printf("  %-8s:", kinds[k].Name);
+        for (size_t i = 0; i < sizeof(counts) / sizeof(counts[0]); i++)
+        {
+            NullDevice device;
+            EngineCore core(&device, FakeClock);
+            double period = LoopGranularity / 1000000.;
+            int ticks = std::min(300000, 2000000 / counts[i] + 1000);
+
+            Now = 1;
+            for (int j = 0; j < counts[i]; j++)
+                AddCondition(&core, (kinds[k].Kind < 0) ? conditions[j % 4] : kinds[k].Kind, j);
+            core.Wake();
+            double start = Seconds();
+            for (int j = 0; j < ticks; j++)
+            {
+                device.X = (SInt32)(30000 * cos(Now * 2 * M_PI));
+                device.Y = (SInt32)(30000 * sin(Now * 2 * M_PI));
+                core.Tick();
+                Now += period;
+            }
+            double cost = (Seconds() - start) / ticks;
+            printf(" %3d: %6.0f ns", counts[i], cost * 1e9);
+        }
+        printf(" per tick\n");
+    }
+}
+
+// The most effects each tick rate can play on one core. Pace lets a tick
+// spend half its period, so a count fits a rate while its slowest ticks,
+// taken as the 99.9th percentile, stay inside that. The table stops at 256,
+// so larger counts are copies of the same effects ticked as Tick does,
+// outside the table. Then the engine plays a full table on the wall clock
+// at each rate, sleeping between ticks as the queue's timer would
+static void BenchRates(void)
+{
+    static const UInt32 periods[] = {1000, 2000, 5000, 10000, 20000, 40000};
+    const int rateCount = sizeof(periods) / sizeof(periods[0]);
+    NullDevice device;
+    EngineCore core(&device, FakeClock);
+    Feedback360Mixer mixer(2, 255);
+    std::vector<Feedback360Effect*> patterns;
+    std::vector<int> counts;
+    std::vector<double> slowest;
+    double period = LoopGranularity / 1000000.;
+
+    printf("most effects per tick rate, one core\n");
+    Now = 1;
+    for (int j = 0; j < EngineCore::Capacity; j++)
+        patterns.push_back(core.EffectList.Find(AddEffect(&core, j)));
+    core.Wake();
+    std::vector<double> times;
+    for (int j = 0; j < 10000; j++)
+    {
+        double start = Seconds();
+        core.Tick();
+        times.push_back(Seconds() - start);
+        Now += period;
+    }
+    printf("  %5d effects in the engine: %7.0f ns median, %8.0f ns 99.9%%\n",
+           EngineCore::Capacity, Percentile(&times, 0.5) * 1e9, Percentile(&times, 0.999) * 1e9);
+
+    for (int count = EngineCore::Capacity; count <= 65536; count *= 2)
+    {
+        std::vector<Feedback360Effect> effects;
+        int ticks = std::max(500, 2500000 / count);
+
+        effects.reserve(count);
+        for (int j = 0; j < count; j++)
+            effects.push_back(*patterns[j % EngineCore::Capacity]);
+        times.clear();
+        for (int j = 0; j < ticks; j++)
+        {
+            LONG levels[2] = {0}, mixed[2];
+            double start = Seconds();
+            for (int k = 0; k < count; k++)
+            {
+                effects[k].Calc(Now, NULL, levels, 2);
+                effects[k].NextTime(Now, 0);
+            }
+            mixer.Mix(levels, mixed);
+            device.SetForce(mixed);
+            times.push_back(Seconds() - start);
+            Now += period;
+        }
+        counts.push_back(count);
+        slowest.push_back(Percentile(&times, 0.999));
+        printf("  %5d effects outside it:    %7.0f ns median, %8.0f ns 99.9%%\n",
+               count, Percentile(&times, 0.5) * 1e9, slowest.back() * 1e9);
+    }
+
+    // Per effect at the largest count, where the fixed part of a tick is least
+    double perEffect = slowest.back() / counts.back();
+    for (int i = 0; i < rateCount; i++)
+    {
+        double budget = periods[i] / 2000000.;
+        int fits = 0;
+        for (size_t j = 0; j < counts.size(); j++)
+        {
+            if (slowest[j] <= budget)
+                fits = counts[j];
+        }
+        printf("  %2u ms tick, %5.0f us budget: %s%5d measured, about %6.0f by the fit, the table holds %d\n",
+               periods[i] / 1000, budget * 1e6, (fits == counts.back()) ? "at least " : "", fits,
+               budget / perEffect, EngineCore::Capacity);
+    }
+
+    // A full table against the wall clock, half a second a rate
+    for (int i = 0; i < rateCount; i++)
+    {
+        NullDevice wallDevice;
+        EngineCore wallCore(&wallDevice, Seconds);
+        Feedback360EngineStats stats;
+
+        wallCore.SetTickPeriod(periods[i]);
+        for (int j = 0; j < EngineCore::Capacity; j++)
+            AddEffect(&wallCore, j);
+        wallCore.Wake();
+        double end = Seconds() + 0.5;
+        while (Seconds() < end)
+        {
+            double delay = wallCore.Tick();
+            struct timespec sleep = {0, (long)(std::min(delay, 1.) * 1e9)};
+            nanosleep(&sleep, NULL);
+        }
+        wallCore.GetStats(&stats);
+        printf("  %2u ms tick on the wall clock, %d effects: %4u ticks, %u overruns, %5u us period after,"
+               " %5u us mean and %6u us worst cost, %4u us mean lateness\n",
+               periods[i] / 1000, EngineCore::Capacity, stats.Ticks, stats.Overruns, stats.Period,
+               stats.MeanCost, stats.MaxCost, stats.MeanLateness);
+    }
+}
+
+int main(void)
+{
+    BenchTick();
+    BenchChurn();
+    BenchApi();
+    BenchSamples();
+    BenchRender();
+    BenchConditions();
+    BenchRates();
+    return 0;
+}
@@ -0,0 +1,680 @@
+/*
+    MICE Xbox 360 Controller driver for Mac OS X
+    Copyright (C) 2006-2013 Colin Munro
+
+    EngineTest.cpp - the effect loop driven by a fake clock and a recording device
+
+    This file is part of Xbox360Controller.
+
+    Xbox360Controller is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    Xbox360Controller is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Foobar; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+#include <float.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+#include "TestCommon.h"
+#include "../Feedback360/Feedback360EngineCore.h"
+#include "../360Controller/xbox360hid.h"
+
+// Each test runs the engine core the way Feedback360Engine's queue would:
+// commands, then Wake, then ticks at the times Tick asks for
+
+static double Now = 0;
+static double Cost = 0;     // Added to the time every time the clock is read
+
+static double FakeClock(void)
+{
+    double time = Now;
+    Now += Cost;
+    return time;
+}
+
+// Stands in for the plugin, keeping everything the engine sends it
+struct Recorder
+{
+    struct Pulse
+    {
+        LONG Levels[2];
+        double On, Off, Duration;
+    };
+
+    std::vector<std::vector<LONG> > Forces;
+    std::vector<double> ForceTimes;
+    std::vector<Pulse> Pulses;
+    bool Timed;         // The device can play SetPulse out by itself
+    SInt32 X, Y;
+    UInt32 StickReads;
+    UInt32 Buttons;
+
+    Recorder() : Timed(false), X(0), Y(0), StickReads(0), Buttons(0) {}
+
+    void SetForce(const LONG *Levels)
+    {
+        Forces.push_back(std::vector<LONG>(Levels, Levels + 2));
+        ForceTimes.push_back(Now);
+    }
+
+    bool ReadStick(SInt32 *theX, SInt32 *theY)
+    {
+        StickReads++;
+        *theX = X;
+        *theY = Y;
+        return true;
+    }
+
+    bool ReadButtons(UInt32 *theButtons)
+    {
+        *theButtons = Buttons;
+        return true;
+    }
+
+    double SetPulse(const LONG *Levels, double On, double Off, double Duration)
+    {
+        if (!Timed)
+            return 0;
+        Pulse pulse = {{Levels[0], Levels[1]}, On, Off, Duration};
+        Pulses.push_back(pulse);
+        return Duration;
+    }
+
+    LONG Last(int channel) const
+    {
+        return Forces.empty() ? -1 : Forces.back()[channel];
+    }
+};
+
+typedef Feedback360EngineCore<Recorder, 2, 255> EngineCore;
+
+static void Reset(void)
+{
+    Now = 1;
+    Cost = 0;
+}
+
+static FFEffectDownloadID Download(EngineCore *core, int kind, DWORD duration, void *params, DWORD size,
+                                   FFEffectParameterFlag flags = 0, FFEFFECT *base = NULL)
+{
+    FFEFFECT effect = {};
+    std::vector<int16_t> samples;
+    FFEffectDownloadID handle = core->EffectList.Reserve();
+
+    if (base != NULL)
+        effect = *base;
+    effect.dwSize = sizeof(effect);
+    effect.dwDuration = duration;
+    effect.dwGain = 10000;
+    effect.cbTypeSpecificParams = size;
+    effect.lpvTypeSpecificParams = params;
+    if (kind == CUSTOM_FORCE)
+    {
+        FFCUSTOMFORCE *custom = (FFCUSTOMFORCE *)params;
+        Feedback360Effect::CopySamples(custom->rglForceData, custom->cSamples, &samples);
+    }
+    CHECK(core->DownloadEffect(handle, true, NULL, kind, &effect, samples,
+                               flags | FFEP_DURATION | FFEP_GAIN | FFEP_TYPESPECIFICPARAMS));
+    core->Wake();
+    return handle;
+}
+
+// Ticks when Tick asks to, as the timer would, until the loop sleeps or the
+// next tick would come after limit
+static void Follow(EngineCore *core, double limit)
+{
+    for (;;)
+    {
+        double delay = core->Tick();
+        if (delay == DBL_MAX || Now + delay > limit)
+            return;
+        Now += delay;
+    }
+}
+
+static FFEffectStatusFlag Status(EngineCore *core, FFEffectDownloadID handle)
+{
+    FFEffectStatusFlag status = 0xffff;
+    CHECK(core->EffectList.Lookup(handle, &status));
+    return status;
+}
+
+// Nothing downloaded: no output and no timer
+static void TestIdle(void)
+{
+    Recorder device;
+    EngineCore core(&device, FakeClock);
+    Feedback360EngineStats stats;
+
+    Reset();
+    CHECK((core.State() & (FFGFFS_EMPTY | FFGFFS_STOPPED)) == (FFGFFS_EMPTY | FFGFFS_STOPPED));
+    CHECK(core.Tick() == DBL_MAX);
+    CHECK(device.Forces.empty());
+    core.GetStats(&stats);
+    CHECK_EQUAL(1, stats.Ticks);
+    CHECK_EQUAL(0, stats.Reports);
+    CHECK_EQUAL(1, stats.Deduplicated);
+    CHECK_EQUAL(LoopGranularity, stats.Period);
+}
+
+// A constant force goes out once, is not repeated while it holds, and is
+// turned off when it ends
+static void TestConstant(void)
+{
+    Recorder device;
+    EngineCore core(&device, FakeClock);
+    FFCONSTANTFORCE constant = {5000};
+    Feedback360EngineStats stats;
+
+    Reset();
+    FFEffectDownloadID handle = Download(&core, CONSTANT_FORCE, 500000, &constant, sizeof(constant));
+    CHECK_EQUAL(0, Status(&core, handle));
+    CHECK(core.State() & FFGFFS_STOPPED);
+    CHECK(!(core.State() & FFGFFS_EMPTY));
+
+    CHECK(core.StartEffect(handle, 0, 1));
+    core.Wake();
+    CHECK_EQUAL(FFEGES_PLAYING, Status(&core, handle));
+    CHECK(!(core.State() & FFGFFS_STOPPED));
+
+    double delay = core.Tick();
+    CHECK(fabs(delay - 0.5) < 1e-6);
+    CHECK_EQUAL(1, device.Forces.size());
+    CHECK_EQUAL(128, device.Last(0));
+    CHECK_EQUAL(128, device.Last(1));
+
+    // Woken early, by a command that changes nothing the motors see
+    Now += 0.1;
+    core.Wake();
+    core.Tick();
+    CHECK_EQUAL(1, device.Forces.size());
+
+    // Gain changes what the motors see
+    core.SetGain(5000);
+    core.Wake();
+    core.Tick();
+    CHECK_EQUAL(2, device.Forces.size());
+    CHECK_EQUAL(64, device.Last(0));
+
+    // Stopped within a tick of the end
+    Now = 1.5;
+    Follow(&core, 2);
+    CHECK(Now < 1.5 + 1.5 * LoopGranularity / 1000000.);
+    CHECK_EQUAL(3, device.Forces.size());
+    CHECK_EQUAL(0, device.Last(0));
+    CHECK_EQUAL(0, device.Last(1));
+    CHECK_EQUAL(0, Status(&core, handle));
+
+    core.GetStats(&stats);
+    CHECK_EQUAL(5, stats.Ticks);
+    CHECK_EQUAL(3, stats.Reports);
+    CHECK_EQUAL(2, stats.Deduplicated);
+    CHECK_EQUAL(1, stats.MaxActiveEffects);
+    CHECK_EQUAL(1, stats.ActiveEffects);
+
+    CHECK(!core.StartEffect(handle + 1, 0, 1));
+    CHECK(core.DestroyEffect(handle));
+    CHECK(!core.StopEffect(handle));
+    core.Wake();
+    CHECK(core.State() & FFGFFS_EMPTY);
+}
+
+// Solo stops everything else, stop all stops everything and reset forgets it
+static void TestCommands(void)
+{
+    Recorder device;
+    EngineCore core(&device, FakeClock);
+    FFCONSTANTFORCE left = {3000}, right = {6000};
+    FFEffectStatusFlag status;
+
+    Reset();
+    FFEffectDownloadID first = Download(&core, CONSTANT_FORCE, FF_INFINITE, &left, sizeof(left));
+    FFEffectDownloadID second = Download(&core, CONSTANT_FORCE, FF_INFINITE, &right, sizeof(right));
+    core.StartEffect(first, 0, 1);
+    core.StartEffect(second, 0, 1);
+    core.Wake();
+    CHECK(core.Tick() == DBL_MAX);
+    CHECK_EQUAL(229, device.Last(0));
+
+    core.StartEffect(second, FFES_SOLO, 1);
+    core.Wake();
+    core.Tick();
+    CHECK_EQUAL(0, Status(&core, first));
+    CHECK_EQUAL(153, device.Last(0));
+
+    core.SendForceFeedbackCommand(FFSFFC_SETACTUATORSOFF);
+    core.Wake();
+    CHECK(core.State() & FFGFFS_ACTUATORSOFF);
+    core.Tick();
+    CHECK_EQUAL(0, device.Last(0));
+    core.SendForceFeedbackCommand(FFSFFC_SETACTUATORSON);
+    core.Wake();
+    CHECK(core.State() & FFGFFS_ACTUATORSON);
+    core.Tick();
+    CHECK_EQUAL(153, device.Last(0));
+
+    core.SendForceFeedbackCommand(FFSFFC_STOPALL);
+    core.Wake();
+    core.Tick();
+    CHECK_EQUAL(0, Status(&core, second));
+    CHECK_EQUAL(0, device.Last(0));
+    CHECK(core.State() & FFGFFS_STOPPED);
+
+    core.SendForceFeedbackCommand(FFSFFC_RESET);
+    core.Wake();
+    CHECK(core.State() & FFGFFS_EMPTY);
+    CHECK(!core.EffectList.Lookup(first, &status));
+    CHECK(!core.EffectList.Lookup(second, &status));
+}
+
+// Time spent paused is added to the effects when they continue
+static void TestPause(void)
+{
+    Recorder device;
+    EngineCore core(&device, FakeClock);
+    FFCONSTANTFORCE constant = {10000};
+
+    Reset();
+    FFEffectDownloadID handle = Download(&core, CONSTANT_FORCE, 1000000, &constant, sizeof(constant), FFEP_START);
+    core.Tick();
+    CHECK_EQUAL(255, device.Last(0));
+
+    Now = 1.2;
+    core.SendForceFeedbackCommand(FFSFFC_PAUSE);
+    core.Wake();
+    CHECK(core.State() & FFGFFS_PAUSED);
+    Now = 1.7;
+    core.SendForceFeedbackCommand(FFSFFC_CONTINUE);
+    core.Wake();
+    CHECK(!(core.State() & FFGFFS_PAUSED));
+
+    Now = 2.2;
+    CHECK(fabs(core.Tick() - 0.3) < 1e-6);
+    CHECK_EQUAL(FFEGES_PLAYING, Status(&core, handle));
+    Now = 2.5;
+    Follow(&core, 3);
+    CHECK(Now < 2.5 + 1.5 * LoopGranularity / 1000000.);
+    CHECK_EQUAL(0, device.Last(0));
+}
+
+// An effect on a trigger button starts when it goes down and again every
+// repeat interval while it is held
+static void TestTrigger(void)
+{
+    Recorder device;
+    EngineCore core(&device, FakeClock);
+    FFCONSTANTFORCE constant = {10000};
+    FFEFFECT trigger = {};
+
+    Reset();
+    trigger.dwTriggerButton = FFJOFS_BUTTON(2);
+    trigger.dwTriggerRepeatInterval = 300000;
+    FFEffectDownloadID handle = Download(&core, CONSTANT_FORCE, 100000, &constant, sizeof(constant),
+                                         FFEP_TRIGGERBUTTON | FFEP_TRIGGERREPEATINTERVAL, &trigger);
+
+    // Armed, so the loop keeps looking at the buttons
+    CHECK(fabs(core.Tick() - LoopGranularity / 1000000.) < 1e-9);
+    CHECK(device.Forces.empty());
+
+    device.Buttons = 1 << 3;
+    Now += 0.01;
+    core.Tick();
+    CHECK(device.Forces.empty());
+
+    device.Buttons = 1 << 2;
+    Now += 0.01;
+    core.Tick();
+    CHECK_EQUAL(FFEGES_PLAYING, Status(&core, handle));
+    CHECK_EQUAL(255, device.Last(0));
+    double started = Now;
+
+    Now = started + 0.15;
+    core.Tick();
+    CHECK_EQUAL(0, device.Last(0));
+    Now = started + 0.3;
+    core.Tick();
+    CHECK_EQUAL(255, device.Last(0));
+
+    // Released, then pressed again before the repeat is due
+    device.Buttons = 0;
+    Now = started + 0.45;
+    core.Tick();
+    CHECK_EQUAL(0, device.Last(0));
+    device.Buttons = 1 << 2;
+    Now = started + 0.5;
+    core.Tick();
+    CHECK_EQUAL(255, device.Last(0));
+}
+
+// Where each button sits in the wired controller's input report, worked out
+// from the driver's report descriptor the way the HID manager does. Bits[n]
+// is the report bit for button n + 1, which Device_ReadButtons returns as
+// bit n, or -1 if there is no such button
+static void DescriptorButtons(int *Bits)
+{
+    int page = 0, size = 0, count = 0, minimum = 0, position = 0;
+    std::vector<int> usages;
+
+    for (int i = 0; i < 32; i++)
+        Bits[i] = -1;
+    for (size_t i = 0; i < sizeof(ReportDescriptor); )
+    {
+        unsigned char item = ReportDescriptor[i];
+        int length = ((item & 0x03) == 3) ? 4 : (item & 0x03);
+        int value = 0;
+
+        for (int j = 0; j < length; j++)
+            value |= ReportDescriptor[i + 1 + j] << (8 * j);
+        switch (item & 0xfc)
+        {
+            case 0x04: page = value; break;             // Usage Page
+            case 0x74: size = value; break;             // Report Size
+            case 0x94: count = value; break;            // Report Count
+            case 0x08: usages.push_back(value); break;  // Usage
+            case 0x18: minimum = value; break;          // Usage Minimum
+            case 0x80:                                  // Input
+                for (int j = 0; j < count; j++)
+                {
+                    int usage = usages.empty() ? minimum + j : usages[std::min(j, (int)usages.size() - 1)];
+
+                    if (!(value & 0x01) && (page == 0x09) && (size == 1) && (usage >= 1) && (usage <= 32))
+                        Bits[usage - 1] = position + j;
+                }
+                position += size * count;
+                // fall through
+            case 0xa0:                                  // Collection
+                usages.clear();
+                minimum = 0;
+                break;
+        }
+        i += 1 + length;
+    }
+}
+
+typedef struct CAPTURED_REPORT
+{
+    double Time;
+    std::vector<unsigned char> Data;
+} CAPTURED_REPORT;
+
+// Input reports saved as milliseconds then bytes
+static bool ReadReports(const char *path, std::vector<CAPTURED_REPORT> *reports)
+{
+    FILE *file = fopen(path, "r");
+    char line[512];
+
+    if (file == NULL)
+        return false;
+    while (fgets(line, sizeof(line), file) != NULL)
+    {
+        CAPTURED_REPORT report;
+        char *p = line, *end;
+
+        report.Time = strtod(p, &end) / 1000.;
+        if ((end == p) || (line[0] == '#'))
+            continue;
+        for (p = end; ; p = end)
+        {
+            long value = strtol(p, &end, 16);
+            if (end == p)
+                break;
+            report.Data.push_back((unsigned char)value);
+        }
+        reports->push_back(report);
+    }
+    fclose(file);
+    return true;
+}
+
+// A captured button sequence, played into the engine core as the reports
+// arrive between ticks. Trigger samples the buttons at each tick rather than
+// seeing each report, so a press starts its effect at the next tick and a tap
+// that comes and goes between two ticks is not seen at all
+static void TestTriggerCapture(const char *path)
+{
+    Recorder device;
+    EngineCore core(&device, FakeClock);
+    FFCONSTANTFORCE constant = {10000};
+    FFEFFECT trigger = {};
+    std::vector<CAPTURED_REPORT> reports;
+    int bits[32];
+    const double tick = LoopGranularity / 1000000.;
+
+    CHECK(ReadReports(path, &reports));
+    CHECK_EQUAL(11, reports.size());
+    DescriptorButtons(bits);
+    CHECK_EQUAL(28, bits[0]);       // A, bit 4 of byte 3
+    CHECK_EQUAL(24, bits[4]);       // LB
+
+    Reset();
+    trigger.dwTriggerButton = FFJOFS_BUTTON(0);
+    trigger.dwTriggerRepeatInterval = 300000;
+    Download(&core, CONSTANT_FORCE, 100000, &constant, sizeof(constant),
+             FFEP_TRIGGERBUTTON | FFEP_TRIGGERREPEATINTERVAL, &trigger);
+
+    double start = Now, due = Now;
+    size_t next = 0;
+    while (due < start + 1)
+    {
+        if ((next < reports.size()) && (start + reports[next].Time < due))
+        {
+            const CAPTURED_REPORT &report = reports[next++];
+
+            Now = start + report.Time;
+            device.Buttons = 0;
+            for (int i = 0; i < 32; i++)
+            {
+                if ((bits[i] >= 0) && (bits[i] / 8 < (int)report.Data.size())
+                    && (report.Data[bits[i] / 8] & (1 << (bits[i] % 8))))
+                    device.Buttons |= 1u << i;
+            }
+            continue;
+        }
+        Now = due;
+        double delay = core.Tick();
+        CHECK(delay <= tick + 1e-9);
+        due = Now + delay;
+    }
+    CHECK_EQUAL(reports.size(), next);
+
+    // Full force at the tick after each press and after the repeat interval,
+    // and nothing for the B press or the tap
+    std::vector<double> starts;
+    for (size_t i = 0; i < device.Forces.size(); i++)
+    {
+        if ((device.Forces[i][0] == 255) && ((i == 0) || (device.Forces[i - 1][0] != 255)))
+            starts.push_back(device.ForceTimes[i] - start);
+    }
+    CHECK_EQUAL(3, starts.size());
+    if (starts.size() == 3)
+    {
+        const double due[3] = {0.023, starts[0] + 0.3 - 1e-9, 0.605};
+
+        for (int i = 0; i < 3; i++)
+            CHECK((starts[i] >= due[i]) && (starts[i] < due[i] + tick));
+    }
+    CHECK_EQUAL(0, device.Last(0));
+}
+
+// The stick is only read while a condition plays, and springs push back
+static void TestCondition(void)
+{
+    Recorder device;
+    EngineCore core(&device, FakeClock);
+    FFCONDITION spring[2] = {{0, 10000, 10000, 10000, 10000, 0}, {0, 10000, 10000, 10000, 10000, 0}};
+
+    Reset();
+    FFEffectDownloadID handle = Download(&core, SPRING, FF_INFINITE, spring, sizeof(spring));
+    core.Tick();
+    CHECK_EQUAL(0, device.StickReads);
+
+    device.X = 16384;
+    core.StartEffect(handle, 0, 1);
+    core.Wake();
+    core.Tick();
+    CHECK_EQUAL(1, device.StickReads);
+    CHECK(device.Last(0) > 0);
+
+    device.X = 0;
+    Now += 0.01;
+    core.Tick();
+    CHECK_EQUAL(2, device.StickReads);
+    CHECK_EQUAL(0, device.Last(0));
+}
+
+// Appended samples only go to custom forces
+static void TestAppend(void)
+{
+    Recorder device;
+    EngineCore core(&device, FakeClock);
+    LONG data[] = {10000, 10000};
+    FFCUSTOMFORCE custom = {2, 10000, 2, data};
+    FFCONSTANTFORCE constant = {5000};
+    std::vector<int16_t> more(4, 5000);
+
+    Reset();
+    FFEffectDownloadID stream = Download(&core, CUSTOM_FORCE, FF_INFINITE, &custom, sizeof(custom), FFEP_START);
+    FFEffectDownloadID other = Download(&core, CONSTANT_FORCE, FF_INFINITE, &constant, sizeof(constant));
+    CHECK(core.AppendSamples(stream, more));
+    CHECK(!core.AppendSamples(other, more));
+    core.Tick();
+    CHECK_EQUAL(255, device.Last(0));
+    Now += 0.01;
+    core.Tick();
+    CHECK_EQUAL(128, device.Last(0));
+}
+
+// A tick that takes more than half its period three times running halves the
+// rate, and a hundred quiet ticks bring it back
+static void TestPace(void)
+{
+    Recorder device;
+    EngineCore core(&device, FakeClock);
+    Feedback360EngineStats stats;
+
+    Reset();
+    Cost = 1 / 128.;
+    for (int i = 0; i < 3; i++)
+        core.Tick();
+    core.GetStats(&stats);
+    CHECK_EQUAL(3, stats.Overruns);
+    CHECK_EQUAL(2 * LoopGranularity, stats.Period);
+    CHECK_EQUAL(7812, stats.MaxCost);
+
+    Cost = 0;
+    for (int i = 0; i < 99; i++)
+        core.Tick();
+    core.GetStats(&stats);
+    CHECK_EQUAL(2 * LoopGranularity, stats.Period);
+    core.Tick();
+    core.GetStats(&stats);
+    CHECK_EQUAL(LoopGranularity, stats.Period);
+
+    core.SetTickPeriod(100);
+    core.GetStats(&stats);
+    CHECK_EQUAL(MinGranularity, stats.Period);
+    core.SetTickPeriod(1000000);
+    core.GetStats(&stats);
+    CHECK_EQUAL(MaxGranularity, stats.Period);
+}
+
+// Intervals and lateness are only counted for ticks the timer was asked for
+static void TestTiming(void)
+{
+    Recorder device;
+    EngineCore core(&device, FakeClock);
+    FFPERIODIC sine = {10000, 0, 0, 100000};
+    Feedback360EngineStats stats;
+
+    Reset();
+    Download(&core, SINE, FF_INFINITE, &sine, sizeof(sine), FFEP_START);
+    double delay = core.Tick();
+    CHECK(fabs(delay - 0.01) < 1e-9);
+    Now += delay + 0.002;
+    core.Tick();
+    Now += delay;
+    core.Tick();
+    core.Wake();
+    Now += 0.001;
+    core.Tick();
+
+    core.GetStats(&stats);
+    CHECK_EQUAL(4, stats.Ticks);
+    CHECK_EQUAL(12000, stats.MaxInterval);
+    CHECK_EQUAL(10000, stats.MinInterval);
+    CHECK_EQUAL(10000, stats.LastInterval);
+    CHECK_EQUAL(11000, stats.MeanInterval);
+    CHECK_EQUAL(2000, stats.MaxLateness);
+    CHECK_EQUAL(1000, stats.MeanLateness);
+}
+
+// A device that times its own output is handed levels that hold, and a lone
+// square wave as pulses, and the loop sleeps until it runs out
+static void TestOffload(void)
+{
+    Recorder device;
+    EngineCore core(&device, FakeClock);
+    FFCONSTANTFORCE constant = {10000};
+    FFPERIODIC square = {5000, 5000, 0, 200000};
+    Feedback360EngineStats stats;
+
+    Reset();
+    device.Timed = true;
+    FFEffectDownloadID handle = Download(&core, CONSTANT_FORCE, 1000000, &constant, sizeof(constant), FFEP_START);
+    CHECK(fabs(core.Tick() - 1) < 1e-6);
+    CHECK(device.Forces.empty());
+    CHECK_EQUAL(1, device.Pulses.size());
+    CHECK_EQUAL(255, device.Pulses[0].Levels[0]);
+    CHECK(fabs(device.Pulses[0].On - 1) < 1e-6);
+    CHECK_EQUAL(0, device.Pulses[0].Off);
+
+    // The loop comes back when the device runs out, sends the last tick of the
+    // effect itself, and silence is sent rather than timed
+    Now += 1;
+    Follow(&core, 3);
+    CHECK_EQUAL(1, device.Pulses.size());
+    CHECK_EQUAL(2, device.Forces.size());
+    CHECK_EQUAL(255, device.Forces[0][0]);
+    CHECK_EQUAL(0, device.Last(0));
+    core.DestroyEffect(handle);
+
+    Download(&core, SQUARE, 1000000, &square, sizeof(square), FFEP_START);
+    double delay = core.Tick();
+    CHECK_EQUAL(2, device.Pulses.size());
+    CHECK_EQUAL(255, device.Pulses[1].Levels[0]);
+    CHECK(fabs(device.Pulses[1].On - 0.1) < 1e-6);
+    CHECK(fabs(device.Pulses[1].Off - 0.1) < 1e-6);
+    CHECK(fabs(device.Pulses[1].Duration - 1) < 1e-6);
+    CHECK(fabs(delay - 1) < 1e-6);
+
+    core.GetStats(&stats);
+    CHECK_EQUAL(2, stats.Pulses);
+    CHECK_EQUAL(4, stats.Reports);
+}
+
+int main(int argc, char **argv)
+{
+    TestIdle();
+    TestConstant();
+    TestCommands();
+    TestPause();
+    TestTrigger();
+    TestTriggerCapture((argc > 1) ? argv[1] : "data/trigger-buttons.txt");
+    TestCondition();
+    TestAppend();
+    TestPace();
+    TestTiming();
+    TestOffload();
+    return TestResult("engine");
+}
@@ -0,0 +1,183 @@
+/*
+    MICE Xbox 360 Controller driver for Mac OS X
+    Copyright (C) 2006-2013 Colin Munro
+
+    MixerTest.cpp - gain, knee, clipping and response curves of the motor mixer
+
+    This file is part of Xbox360Controller.
+
+    Xbox360Controller is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    Xbox360Controller is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Foobar; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+#include "TestCommon.h"
+#include "../Feedback360/Feedback360Mixer.h"
+
+#define MIXER_GOLDEN    "data/mixer.txt"
+
+static bool Record = false;
+
+// Straight through with the defaults, clipping at full scale
+static void TestClipping(void)
+{
+    Feedback360Mixer mixer(2, 255);
+
+    CHECK_EQUAL(0, mixer.MixChannel(0, 0));
+    CHECK_EQUAL(0, mixer.MixChannel(0, -5000));
+    CHECK_EQUAL(128, mixer.MixChannel(0, 5000));
+    CHECK_EQUAL(255, mixer.MixChannel(0, LEVEL_MAX));
+    CHECK_EQUAL(255, mixer.MixChannel(0, LEVEL_MAX + 1));
+    CHECK_EQUAL(255, mixer.MixChannel(1, 4 * LEVEL_MAX));
+    CHECK_EQUAL(255, mixer.MixChannel(1, 0x7fffffff));
+    CHECK_EQUAL(0, mixer.MixChannel(1, -0x7fffffff));
+
+    // The curve works in 1/65535ths, so allow one level either way of exact
+    for (LONG sum = 0; sum <= LEVEL_MAX; sum++)
+    {
+        LONG exact = (sum * 255 + LEVEL_MAX / 2) / LEVEL_MAX;
+
+        if (abs(mixer.MixChannel(0, sum) - exact) > 1)
+        {
+            CHECK_EQUAL(exact, mixer.MixChannel(0, sum));
+            break;
+        }
+    }
+}
+
+static void TestGain(void)
+{
+    Feedback360Mixer mixer(2, 101);
+
+    mixer.SetGain(5000);
+    CHECK_EQUAL(51, mixer.MixChannel(0, LEVEL_MAX));
+    CHECK_EQUAL(101, mixer.MixChannel(0, 2 * LEVEL_MAX));
+
+    // Out of range gains are clamped rather than silencing or boosting
+    mixer.SetGain(0);
+    CHECK_EQUAL(0, mixer.MixChannel(0, LEVEL_MAX));
+    CHECK_EQUAL(10, mixer.MixChannel(0, 1000 * LEVEL_MAX));
+    mixer.SetGain(20000);
+    CHECK_EQUAL(51, mixer.MixChannel(0, LEVEL_MAX / 2));
+}
+
+// Below the knee nothing changes. Above it the output keeps rising with the
+// same slope at the knee, stays under full scale and approaches it
+static void TestKnee(void)
+{
+    Feedback360Mixer plain(1, 10000), knee(1, 10000);
+    LONG previous = -1;
+
+    knee.SetKnee(6000);
+    for (LONG sum = 0; sum <= 6000; sum += 7)
+    {
+        if (knee.MixChannel(0, sum) != plain.MixChannel(0, sum))
+        {
+            CHECK_EQUAL(plain.MixChannel(0, sum), knee.MixChannel(0, sum));
+            break;
+        }
+    }
+    CHECK(knee.MixChannel(0, 6100) >= 6095);
+    CHECK(knee.MixChannel(0, 6100) <= 6100);
+    for (LONG sum = 6000; sum <= 200000; sum += 13)
+    {
+        LONG level = knee.MixChannel(0, sum);
+
+        if ((level < previous) || (level >= LEVEL_MAX))
+        {
+            CHECK(level >= previous);
+            CHECK(level < LEVEL_MAX);
+            break;
+        }
+        previous = level;
+    }
+    CHECK(knee.MixChannel(0, 1000000) > 9980);
+    // Twice full scale takes 14000 over the knee into its 4000 of room
+    CHECK_EQUAL(6000 + 4000 * 14000 / 18000, knee.MixChannel(0, 2 * LEVEL_MAX));
+
+    // Out of range knees are clamped, a knee at full scale clips
+    knee.SetKnee(-100);
+    CHECK_EQUAL(5000, knee.MixChannel(0, LEVEL_MAX));
+    knee.SetKnee(2 * LEVEL_MAX);
+    CHECK_EQUAL(LEVEL_MAX, knee.MixChannel(0, 2 * LEVEL_MAX));
+}
+
+// A curve that lifts the bottom gets a stalled motor moving, and output
+// between the points is interpolated
+static void TestCurve(void)
+{
+    Feedback360Mixer mixer(4, 255);
+    UInt16 points[MIXER_CURVE_POINTS];
+
+    for (int i = 0; i < MIXER_CURVE_POINTS; i++)
+        points[i] = (UInt16)(MIXER_CURVE_ONE / 4 + i * (MIXER_CURVE_ONE - MIXER_CURVE_ONE / 4) / (MIXER_CURVE_POINTS - 1));
+    mixer.SetCurve(1, points);
+    mixer.SetCurve(-1, points);
+    mixer.SetCurve(MIXER_CHANNELS, points);
+
+    CHECK_EQUAL(64, mixer.MixChannel(1, 0));
+    CHECK_EQUAL(0, mixer.MixChannel(0, 0));
+    CHECK_EQUAL(255, mixer.MixChannel(1, LEVEL_MAX));
+    CHECK_EQUAL(159, mixer.MixChannel(1, LEVEL_MAX / 2));
+    CHECK_EQUAL(128, mixer.MixChannel(0, LEVEL_MAX / 2));
+
+    // Only the channels asked for are mixed
+    LONG sums[MIXER_CHANNELS] = {5000, 0, 10000, -1};
+    LONG levels[MIXER_CHANNELS] = {-1, -1, -1, -1};
+    mixer.Mix(sums, levels);
+    CHECK_EQUAL(128, levels[0]);
+    CHECK_EQUAL(64, levels[1]);
+    CHECK_EQUAL(255, levels[2]);
+    CHECK_EQUAL(0, levels[3]);
+
+    Feedback360Mixer pair(2, 255);
+    LONG pairLevels[MIXER_CHANNELS] = {-1, -1, -1, -1};
+    pair.Mix(sums, pairLevels);
+    CHECK_EQUAL(-1, pairLevels[2]);
+}
+
+// The whole transfer curve with gain, knee and a curve, against data/mixer.txt
+static void TestGolden(void)
+{
+    Feedback360Mixer mixer(2, 255);
+    UInt16 points[MIXER_CURVE_POINTS];
+    std::vector<std::string> lines;
+    char line[64];
+
+    for (int i = 0; i < MIXER_CURVE_POINTS; i++)
+        points[i] = (UInt16)(MIXER_CURVE_ONE / 8 + i * (MIXER_CURVE_ONE - MIXER_CURVE_ONE / 8) / (MIXER_CURVE_POINTS - 1));
+    points[0] = 0;
+    mixer.SetCurve(1, points);
+    mixer.SetGain(7500);
+    mixer.SetKnee(7000);
+    for (LONG sum = -1000; sum <= 3 * LEVEL_MAX; sum += 500)
+    {
+        snprintf(line, sizeof(line), "%6d %3d %3d", sum, mixer.MixChannel(0, sum), mixer.MixChannel(1, sum));
+        lines.push_back(line);
+    }
+    CheckGolden(MIXER_GOLDEN, "Sum, then the level on a straight and a lifted channel at gain 7500 and knee 7000, from MixerTest", lines, Record);
+}
+
+int main(int argc, char **argv)
+{
+    Record = (argc > 1) && (strcmp(argv[1], "--record") == 0);
+    TestClipping();
+    TestGain();
+    TestKnee();
+    TestCurve();
+    TestGolden();
+    return TestResult("mixer");
+}
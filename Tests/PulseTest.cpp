@@ -0,0 +1,270 @@
+/*
+    MICE Xbox 360 Controller driver for Mac OS X
+    Copyright (C) 2006-2013 Colin Munro
+
+    PulseTest.cpp - rumble reports for the Bluetooth controller against the effects
+
+    This file is part of Xbox360Controller.
+
+    Xbox360Controller is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    Xbox360Controller is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Foobar; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+#include <float.h>
+#include <math.h>
+#include <vector>
+#include "TestCommon.h"
+#include "../Feedback360/Feedback360EngineCore.h"
+#include "../XBOBTFF/XboxOnePulse.h"
+
+// The Bluetooth plugin's SetPulse hands whole stretches of output to the
+// controller. This checks the reports it would send: first the encoding on
+// its own, then what the controller plays from the engine's reports against
+// what the effect plays tick by tick.
+
+#define PULSE_UNIT          0.01    // Seconds, the controller's time unit
+#define PULSE_CHANNELS      4
+#define PULSE_MAX           101     // SCALE_MAX of the plugin
+#define PULSE_START         100.    // Clock time the effects start
+#define PULSE_LENGTH        10000   // ms compared
+
+static double Now = 0;
+
+static double FakeClock(void)
+{
+    return Now;
+}
+
+// Stands in for FeedbackXBOBT, keeping the reports it would send
+struct Controller
+{
+    struct Report
+    {
+        double Time;
+        LONG Level;
+        XboxOnePulse Pulse;
+    };
+
+    std::vector<Report> Reports;
+
+    void SetForce(const LONG *Levels)
+    {
+        // As FeedbackXBOBT::SetForce, long enough for the next tick
+        Report report = {Now, Levels[0], {0x7f, 0, 10}};
+        Reports.push_back(report);
+    }
+
+    bool ReadStick(SInt32 *, SInt32 *)
+    {
+        return false;
+    }
+
+    bool ReadButtons(UInt32 *)
+    {
+        return false;
+    }
+
+    double SetPulse(const LONG *Levels, double On, double Off, double Duration)
+    {
+        Report report = {Now, Levels[0], {0, 0, 0}};
+        double covered = XboxOnePulseEncode(On, Off, Duration, &report.Pulse);
+        if (covered > 0)
+            Reports.push_back(report);
+        return covered;
+    }
+
+    // What the left motor is doing ms milliseconds after the start, each
+    // report taking over from the one before
+    LONG Play(size_t *next, int ms) const
+    {
+        double time = PULSE_START + ms / 1000. + 1e-7;
+
+        while (*next < Reports.size() && Reports[*next].Time <= time)
+            (*next)++;
+        if (*next == 0)
+            return 0;
+        const Report &report = Reports[*next - 1];
+        int elapsed = (int)((time - report.Time) * 1000);
+        int cycle = (int)((report.Pulse.Duration + report.Pulse.Delay) * PULSE_UNIT * 1000 + 0.5);
+        if (elapsed / cycle > (int)report.Pulse.Loops)
+            return 0;
+        return elapsed % cycle < (int)(report.Pulse.Duration * PULSE_UNIT * 1000 + 0.5) ? report.Level : 0;
+    }
+};
+
+typedef Feedback360EngineCore<Controller, PULSE_CHANNELS, PULSE_MAX> EngineCore;
+
+// Held levels are spread over the fewest reports, run a unit past the end
+// and never ask for more than a report holds
+static void TestHold(void)
+{
+    XboxOnePulse pulse;
+
+    CHECK(fabs(XboxOnePulseEncode(0.05, 0, 0.05, &pulse) - 0.05) < 1e-9);
+    CHECK_EQUAL(6, pulse.Duration);
+    CHECK_EQUAL(0, pulse.Delay);
+    CHECK_EQUAL(0, pulse.Loops);
+
+    CHECK(fabs(XboxOnePulseEncode(10, 0, 10, &pulse) - 10) < 1e-9);
+    CHECK_EQUAL(251, pulse.Duration);
+    CHECK_EQUAL(3, pulse.Loops);
+
+    CHECK(fabs(XboxOnePulseEncode(1000, 0, 1000, &pulse) - 652.79) < 1e-9);
+    CHECK_EQUAL(255, pulse.Duration);
+    CHECK_EQUAL(255, pulse.Loops);
+
+    for (int ms = 1; ms <= 700000; ms += 997)
+    {
+        double duration = ms / 1000.;
+        double covered = XboxOnePulseEncode(duration, 0, duration, &pulse);
+        double played = pulse.Duration * (pulse.Loops + 1) * PULSE_UNIT;
+
+        if (pulse.Duration > 255 || pulse.Loops > 255 || covered > duration || covered > played - PULSE_UNIT + 1e-9
+            || (played < duration + PULSE_UNIT - 1e-9 && pulse.Duration * (pulse.Loops + 1) < 255 * 256))
+        {
+            CHECK_EQUAL(ms, -1);
+            break;
+        }
+    }
+}
+
+// Trains are only handed over while whole units keep within half a unit of the wave
+static void TestTrain(void)
+{
+    XboxOnePulse pulse;
+
+    CHECK(fabs(XboxOnePulseEncode(0.1, 0.1, 1, &pulse) - 1) < 1e-9);
+    CHECK_EQUAL(10, pulse.Duration);
+    CHECK_EQUAL(10, pulse.Delay);
+    CHECK_EQUAL(4, pulse.Loops);
+
+    // 36.5 ms halves round to 4 units, 7 ms a cycle too long, so not even two cycles fit
+    CHECK_EQUAL(0, XboxOnePulseEncode(0.0365, 0.0365, 10, &pulse));
+    // 100.2 ms halves drift 0.4 ms a cycle, so twelve cycles are handed over
+    CHECK(fabs(XboxOnePulseEncode(0.1002, 0.1002, 10, &pulse) - 2.4) < 1e-9);
+    CHECK_EQUAL(11, pulse.Loops);
+    // 101.5 ms halves drift 3 ms a cycle
+    CHECK_EQUAL(0, XboxOnePulseEncode(0.1015, 0.1015, 10, &pulse));
+
+    CHECK_EQUAL(0, XboxOnePulseEncode(0.004, 0.1, 10, &pulse));
+    CHECK_EQUAL(0, XboxOnePulseEncode(2.56, 2.56, 100, &pulse));
+    CHECK_EQUAL(0, XboxOnePulseEncode(0.1, 0.1, 0.3, &pulse));
+
+    // At most 256 cycles
+    CHECK(fabs(XboxOnePulseEncode(0.01, 0.01, 100, &pulse) - 5.12) < 1e-9);
+    CHECK_EQUAL(255, pulse.Loops);
+
+    for (int on = 5; on < 3000; on += 7)
+    {
+        double half = on / 10000.;
+        double covered = XboxOnePulseEncode(half, half, 60, &pulse);
+
+        if (covered == 0)
+            continue;
+        double cycles = pulse.Loops + 1;
+        double drift = fabs((pulse.Duration + pulse.Delay) * PULSE_UNIT - 2 * half) * cycles;
+        if (drift > 0.005 + 1e-9 || cycles < 2 || cycles > 256)
+        {
+            CHECK_EQUAL(on, -1);
+            break;
+        }
+    }
+}
+
+// Runs a lone square wave through the engine and the controller, and
+// compares every millisecond of what the controller plays with the effect.
+// Edges the controller times itself may be off by the half unit of drift
+// allowed, plus a millisecond of rounding.
+// Reports are counted too, that being what SetPulse is there to save.
+static void CheckSquare(DWORD period, UInt32 maxReports)
+{
+    Controller device;
+    EngineCore core(&device, FakeClock);
+    Feedback360Effect reference(1);
+    Feedback360Mixer mixer(PULSE_CHANNELS, PULSE_MAX);
+    FFPERIODIC square = {4000, 4000, 0, period};
+    FFEFFECT effect = {};
+    std::vector<int16_t> samples;
+
+    Now = PULSE_START;
+    core.SetRampStep(40000);
+    effect.dwDuration = PULSE_LENGTH * 1000;
+    effect.dwGain = 10000;
+    effect.cbTypeSpecificParams = sizeof(square);
+    effect.lpvTypeSpecificParams = &square;
+    core.DownloadEffect(core.EffectList.Reserve(), true, NULL, SQUARE, &effect, samples,
+                        FFEP_DURATION | FFEP_GAIN | FFEP_TYPESPECIFICPARAMS | FFEP_START);
+    core.Wake();
+    for (;;)
+    {
+        double delay = core.Tick();
+        if (delay == DBL_MAX)
+            break;
+        Now += delay;
+    }
+
+    reference.Kind = SQUARE;
+    reference.DiEffect = effect;
+    reference.DiPeriodic = square;
+    reference.PreparePhase();
+    reference.Status = FFEGES_PLAYING;
+    reference.PlayCount = 1;
+    reference.StartTime = PULSE_START;
+
+    size_t next = 0;
+    int wrong = 0, run = 0, longest = 0;
+    for (int ms = 0; ms < PULSE_LENGTH; ms++)
+    {
+        LONG levels[PULSE_CHANNELS] = {0};
+        LONG wanted[PULSE_CHANNELS];
+
+        reference.Calc(PULSE_START + ms / 1000. + 1e-7, NULL, levels, PULSE_CHANNELS);
+        mixer.Mix(levels, wanted);
+        if (device.Play(&next, ms) != wanted[0])
+        {
+            wrong++;
+            longest = std::max(longest, ++run);
+        }
+        else
+        {
+            run = 0;
+        }
+    }
+    if (longest > 6)
+    {
+        fprintf(stderr, "%u ms square: %d ms wrong, up to %d in a row\n", period / 1000, wrong, longest);
+        CHECK(longest <= 6);
+    }
+    CHECK(device.Reports.size() <= maxReports);
+}
+
+static void TestStream(void)
+{
+    // Whole units, so one report plays the lot. The effect's last tick and
+    // the silence after it are the other two.
+    CheckSquare(200000, 3);
+    CheckSquare(1000000, 3);
+    // 75 and 36.5 ms halves drift too far to hand over as trains, so each
+    // half is a report of its own
+    CheckSquare(150000, 2 * PULSE_LENGTH / 150 + 3);
+    CheckSquare(73000, 2 * PULSE_LENGTH / 73 + 3);
+    CheckSquare(30000, 2 * PULSE_LENGTH / 30 + 3);
+}
+
+int main(void)
+{
+    TestHold();
+    TestTrain();
+    TestStream();
+    return TestResult("pulse");
+}
@@ -0,0 +1,216 @@
+/*
+    MICE Xbox 360 Controller driver for Mac OS X
+    Copyright (C) 2006-2013 Colin Munro
+
+    RenderTest.cpp - effects rendered offline against golden motor levels
+
+    This file is part of Xbox360Controller.
+
+    Xbox360Controller is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    Xbox360Controller is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Foobar; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <vector>
+#include "TestCommon.h"
+#include "../Feedback360/Feedback360Render.h"
+
+// Each scenario renders a timeline and compares the motor levels with
+// data/render-<name>.txt, which lists the frame number and the levels at
+// every frame where they change. Run with --record to rewrite the files
+// after a change that is meant to alter the output.
+
+#define RENDER_RATE     100     // Frames a second, the engine's default tick
+#define RENDER_FRAMES   150
+
+static bool Record = false;
+
+static void Setup(Feedback360Effect *effect, int kind, DWORD duration)
+{
+    effect->Kind = kind;
+    effect->DiEffect.dwDuration = duration;
+    effect->DiEffect.dwGain = 10000;
+}
+
+static void SetEnvelope(Feedback360Effect *effect, DWORD attackLevel, DWORD attackTime, DWORD fadeLevel, DWORD fadeTime)
+{
+    effect->DiEnvelope.dwAttackLevel = attackLevel;
+    effect->DiEnvelope.dwAttackTime = attackTime;
+    effect->DiEnvelope.dwFadeLevel = fadeLevel;
+    effect->DiEnvelope.dwFadeTime = fadeTime;
+    effect->DiEffect.dwFlags |= FFEP_ENVELOPE;
+    effect->DiEffect.lpEnvelope = &effect->DiEnvelope;
+}
+
+static void SetPeriodic(Feedback360Effect *effect, DWORD magnitude, LONG offset, DWORD phase, DWORD period)
+{
+    effect->DiPeriodic.dwMagnitude = magnitude;
+    effect->DiPeriodic.lOffset = offset;
+    effect->DiPeriodic.dwPhase = phase;
+    effect->DiPeriodic.dwPeriod = period;
+    effect->PreparePhase();
+}
+
+static void SetCustom(Feedback360Effect *effect, DWORD channels, DWORD period, const LONG *data, DWORD count)
+{
+    std::vector<int16_t> samples;
+
+    effect->DiCustomForce.cChannels = channels;
+    effect->DiCustomForce.dwSamplePeriod = period;
+    Feedback360Effect::CopySamples(data, count, &samples);
+    effect->SetSamples(samples);
+}
+
+static void Check(const char *name, Feedback360Effect **effects, UInt32 effectCount,
+                  const Feedback360RenderEvent *events, UInt32 eventCount, const Feedback360Mixer &mixer)
+{
+    std::vector<UInt8> levels(RENDER_FRAMES * mixer.Channels);
+    std::vector<std::string> lines;
+    std::string path = std::string("data/render-") + name + ".txt";
+    char line[64];
+
+    Feedback360Render(effects, effectCount, events, eventCount, &mixer, RENDER_RATE, &levels[0], RENDER_FRAMES);
+    for (int frame = 0; frame < RENDER_FRAMES; frame++)
+    {
+        const UInt8 *current = &levels[frame * mixer.Channels];
+
+        if ((frame > 0) && (memcmp(current, current - mixer.Channels, mixer.Channels) == 0))
+            continue;
+        int length = snprintf(line, sizeof(line), "%d", frame);
+        for (int i = 0; i < mixer.Channels; i++)
+            length += snprintf(line + length, sizeof(line) - length, " %d", current[i]);
+        lines.push_back(line);
+    }
+    CheckGolden(path.c_str(), (std::string("Levels from RenderTest ") + name + ": frame then one level per motor, at each change").c_str(), lines, Record);
+}
+
+// Attack from nothing and fade back out, starting late
+static void TestConstant(void)
+{
+    Feedback360Effect effect(1);
+    Feedback360Effect *effects[] = {&effect};
+    Feedback360RenderEvent events[] = {{0.1, 0, RENDER_START, 1}};
+    Feedback360Mixer mixer(2, 255);
+
+    Setup(&effect, CONSTANT_FORCE, 1000000);
+    effect.DiConstantForce.lMagnitude = 8000;
+    SetEnvelope(&effect, 0, 200000, 0, 300000);
+    Check("constant", effects, 1, events, 1, mixer);
+}
+
+static void TestSine(void)
+{
+    Feedback360Effect effect(1);
+    Feedback360Effect *effects[] = {&effect};
+    Feedback360RenderEvent events[] = {{0, 0, RENDER_START, 1}};
+    Feedback360Mixer mixer(2, 255);
+
+    Setup(&effect, SINE, 1000000);
+    SetPeriodic(&effect, 10000, 0, 9000, 250000);
+    Check("sine", effects, 1, events, 1, mixer);
+}
+
+// Played twice, so the phase starts over
+static void TestSquare(void)
+{
+    Feedback360Effect effect(1);
+    Feedback360Effect *effects[] = {&effect};
+    Feedback360RenderEvent events[] = {{0, 0, RENDER_START, 2}};
+    Feedback360Mixer mixer(2, 255);
+
+    Setup(&effect, SQUARE, 500000);
+    SetPeriodic(&effect, 4000, 4000, 0, 150000);
+    Check("square", effects, 1, events, 1, mixer);
+}
+
+static void TestRamp(void)
+{
+    Feedback360Effect effect(1);
+    Feedback360Effect *effects[] = {&effect};
+    Feedback360RenderEvent events[] = {{0, 0, RENDER_START, 1}};
+    Feedback360Mixer mixer(2, 255);
+
+    Setup(&effect, RAMP_FORCE, 1000000);
+    effect.DiRampforce.lStart = 10000;
+    effect.DiRampforce.lEnd = -2000;
+    Check("ramp", effects, 1, events, 1, mixer);
+}
+
+// Two channels at 20 samples a second, each sample held until the next
+static void TestCustom(void)
+{
+    static const LONG data[] = {10000, 0, 5000, 2500, 0, 10000, -3000, 7500};
+    Feedback360Effect effect(1);
+    Feedback360Effect *effects[] = {&effect};
+    Feedback360RenderEvent events[] = {{0, 0, RENDER_START, 1}};
+    Feedback360Mixer mixer(2, 255);
+
+    Setup(&effect, CUSTOM_FORCE, 1000000);
+    SetCustom(&effect, 2, 50000, data, sizeof(data) / sizeof(data[0]));
+    Check("custom", effects, 1, events, 1, mixer);
+}
+
+// The effect's own sample period turns a triangle into stairs
+static void TestSamplePeriod(void)
+{
+    Feedback360Effect effect(1);
+    Feedback360Effect *effects[] = {&effect};
+    Feedback360RenderEvent events[] = {{0, 0, RENDER_START, 1}};
+    Feedback360Mixer mixer(2, 255);
+
+    Setup(&effect, TRIANGLE, 1000000);
+    effect.DiEffect.dwSamplePeriod = 100000;
+    SetPeriodic(&effect, 10000, 0, 0, 400000);
+    Check("sampleperiod", effects, 1, events, 1, mixer);
+}
+
+// Two effects summed past full scale through the knee, with device gain, on the
+// four channels of the Bluetooth controller, and the sine stopped early
+static void TestMix(void)
+{
+    static const LONG data[] = {0, 0, 6000, 3000};
+    Feedback360Effect sine(1), constant(2), triggers(3);
+    Feedback360Effect *effects[] = {&sine, &constant, &triggers};
+    Feedback360RenderEvent events[] = {
+        {0, 0, RENDER_START, 1},
+        {0.2, 1, RENDER_START, 1},
+        {0.3, 2, RENDER_START, 1},
+        {0.9, 0, RENDER_STOP, 0},
+    };
+    Feedback360Mixer mixer(4, 101);
+
+    Setup(&sine, SINE, 1200000);
+    SetPeriodic(&sine, 6000, 2000, 0, 300000);
+    Setup(&constant, CONSTANT_FORCE, 800000);
+    constant.DiConstantForce.lMagnitude = 7000;
+    Setup(&triggers, CUSTOM_FORCE, FF_INFINITE);
+    SetCustom(&triggers, 4, 0, data, sizeof(data) / sizeof(data[0]));
+    mixer.SetGain(8000);
+    mixer.SetKnee(6000);
+    Check("mix", effects, 3, events, 4, mixer);
+}
+
+int main(int argc, char **argv)
+{
+    Record = (argc > 1) && (strcmp(argv[1], "--record") == 0);
+    TestConstant();
+    TestSine();
+    TestSquare();
+    TestRamp();
+    TestCustom();
+    TestSamplePeriod();
+    TestMix();
+    return TestResult("render");
+}
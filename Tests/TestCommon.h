@@ -0,0 +1,116 @@
+/*
+    MICE Xbox 360 Controller driver for Mac OS X
+    Copyright (C) 2006-2013 Colin Munro
+
+    TestCommon.h - checks shared by the host test programs
+
+    This file is part of Xbox360Controller.
+
+    Xbox360Controller is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    Xbox360Controller is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Foobar; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+#ifndef __TESTCOMMON_H__
+#define __TESTCOMMON_H__
+
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+// Each program counts its failed checks and exits with the count, so make
+// stops at the first program that fails
+static int TestFailures = 0;
+
+#define CHECK(condition) \
+    do { \
+        if (!(condition)) { \
+            fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #condition); \
+            TestFailures++; \
+        } \
+    } while (0)
+
+#define CHECK_EQUAL(expected, actual) \
+    do { \
+        long long e_ = (long long)(expected), a_ = (long long)(actual); \
+        if (e_ != a_) { \
+            fprintf(stderr, "%s:%d: %s is %lld, expected %lld\n", __FILE__, __LINE__, #actual, a_, e_); \
+            TestFailures++; \
+        } \
+    } while (0)
+
+// Compares lines of output with a golden file, ignoring its # comments, or with
+// record set writes them there after the header comment instead
+static inline void CheckGolden(const char *path, const char *header, const std::vector<std::string> &lines, bool record)
+{
+    FILE *file;
+    char buffer[1024];
+    size_t line = 0;
+    bool match = true;
+
+    if (record)
+    {
+        file = fopen(path, "w");
+        if (file == NULL)
+        {
+            fprintf(stderr, "%s: can't write\n", path);
+            TestFailures++;
+            return;
+        }
+        fprintf(file, "# %s\n", header);
+        for (size_t i = 0; i < lines.size(); i++)
+            fprintf(file, "%s\n", lines[i].c_str());
+        fclose(file);
+        return;
+    }
+
+    file = fopen(path, "r");
+    if (file == NULL)
+    {
+        fprintf(stderr, "%s: can't read\n", path);
+        TestFailures++;
+        return;
+    }
+    while (fgets(buffer, sizeof(buffer), file) != NULL)
+    {
+        buffer[strcspn(buffer, "\r\n")] = '\0';
+        if (buffer[0] == '#')
+            continue;
+        if ((line >= lines.size()) || (lines[line] != buffer))
+        {
+            fprintf(stderr, "%s: output line %u is \"%s\", expected \"%s\"\n", path, (unsigned)line + 1,
+                    (line < lines.size()) ? lines[line].c_str() : "", buffer);
+            TestFailures++;
+            match = false;
+            break;
+        }
+        line++;
+    }
+    fclose(file);
+    if (match && (line != lines.size()))
+    {
+        fprintf(stderr, "%s: %u lines, expected %u\n", path, (unsigned)lines.size(), (unsigned)line);
+        TestFailures++;
+    }
+}
+
+static inline int TestResult(const char *name)
+{
+    if (TestFailures == 0)
+        printf("%s: passed\n", name);
+    else
+        printf("%s: %d failed\n", name, TestFailures);
+    return TestFailures != 0;
+}
+
+#endif // __TESTCOMMON_H__
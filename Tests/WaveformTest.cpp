@@ -0,0 +1,158 @@
+/*
+    MICE Xbox 360 Controller driver for Mac OS X
+    Copyright (C) 2006-2013 Colin Munro
+
+    WaveformTest.cpp - periodic waveforms and phase stepping
+
+    This file is part of Xbox360Controller.
+
+    Xbox360Controller is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    Xbox360Controller is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Foobar; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+#include "TestCommon.h"
+#include "../Feedback360/Feedback360Effect.h"
+#include "../Feedback360/Feedback360Waveform.h"
+
+#define WAVEFORM_GOLDEN     "data/waveform.txt"
+#define WAVEFORM_POINTS     64
+
+static bool Record = false;
+
+// Every waveform at evenly spaced phases, against data/waveform.txt
+static void TestGolden(void)
+{
+    std::vector<std::string> lines;
+    char line[128];
+
+    for (int i = 0; i < WAVEFORM_POINTS; i++)
+    {
+        uint32_t phase = (uint32_t)(((uint64_t)i << 32) / WAVEFORM_POINTS);
+
+        snprintf(line, sizeof(line), "%08x %6d %6d %6d %6d %6d", phase, WaveSine(phase), WaveSquare(phase),
+                 WaveTriangle(phase), WaveSawtoothUp(phase), WaveSawtoothDown(phase));
+        lines.push_back(line);
+    }
+    CheckGolden(WAVEFORM_GOLDEN, "Phase, then sine, square, triangle, sawtooth up and sawtooth down from WaveformTest", lines, Record);
+}
+
+// The table sine keeps to within 0.02% of sin(), as Feedback360Waveform.h says
+static void TestSine(void)
+{
+    double worst = 0;
+
+    for (uint64_t phase = 0; phase < (1ULL << 32); phase += 0x10001)
+    {
+        double exact = sin(phase * 2 * M_PI / 4294967296.0) * WAVE_ONE;
+        double error = fabs(WaveSine((uint32_t)phase) - exact);
+
+        if (error > worst)
+            worst = error;
+    }
+    CHECK(worst <= WAVE_ONE * 0.0002);
+}
+
+// The other shapes are straight lines, with the ends where the header says
+static void TestShapes(void)
+{
+    CHECK_EQUAL(WAVE_ONE, WaveSquare(0));
+    CHECK_EQUAL(WAVE_ONE, WaveSquare(0x7fffffff));
+    CHECK_EQUAL(-WAVE_ONE, WaveSquare(0x80000000));
+    CHECK_EQUAL(-WAVE_ONE, WaveTriangle(0));
+    CHECK_EQUAL(0, WaveTriangle(0x40000000));
+    CHECK_EQUAL(WAVE_ONE, WaveTriangle(0x80000000));
+    CHECK_EQUAL(0, WaveTriangle(0xc0000000));
+    CHECK_EQUAL(-WAVE_ONE, WaveSawtoothUp(0));
+    CHECK_EQUAL(0, WaveSawtoothUp(0x80000000));
+    CHECK_EQUAL(WAVE_ONE, WaveSawtoothDown(0));
+
+    for (uint32_t phase = 0; phase < 0xffff0000; phase += 0x10000)
+    {
+        CHECK_EQUAL(WaveSawtoothUp(phase) + 1, WaveSawtoothUp(phase + 0x10000));
+        if (phase < 0x80000000 - 0x10000 || phase >= 0x80000000)
+            CHECK_EQUAL(2, abs(WaveTriangle(phase + 0x10000) - WaveTriangle(phase)));
+    }
+}
+
+// The phase offset is in hundredths of a degree
+static void TestOffset(void)
+{
+    CHECK_EQUAL(0, WavePhaseOffset(0));
+    CHECK_EQUAL(0x40000000, WavePhaseOffset(9000));
+    CHECK_EQUAL(0x80000000, WavePhaseOffset(18000));
+    CHECK_EQUAL(0, WavePhaseOffset(36000));
+    CHECK_EQUAL(WavePhaseOffset(4500), WavePhaseOffset(40500));
+}
+
+// An effect ticked every millisecond steps its phase, one restarted at each
+// tick works it out from scratch, and the two must play the same
+static void TestStepping(void)
+{
+    static const DWORD periods[] = {250000, 73000, 333000, 1000, 7000000};
+    static const int kinds[] = {SINE, TRIANGLE, SAWTOOTH_UP, SQUARE};
+
+    for (size_t k = 0; k < sizeof(kinds) / sizeof(kinds[0]); k++)
+    {
+        for (size_t p = 0; p < sizeof(periods) / sizeof(periods[0]); p++)
+        {
+            Feedback360Effect stepped(1);
+            LONG worst = 0;
+
+            stepped.Kind = kinds[k];
+            stepped.DiEffect.dwDuration = FF_INFINITE;
+            stepped.DiEffect.dwGain = 10000;
+            stepped.DiPeriodic.dwMagnitude = 10000;
+            stepped.DiPeriodic.dwPhase = 4500;
+            stepped.DiPeriodic.dwPeriod = periods[p];
+            stepped.PreparePhase();
+            stepped.Status = FFEGES_PLAYING;
+            stepped.PlayCount = 1;
+            stepped.StartTime = 10;
+
+            for (int ms = 0; ms < 20000; ms += 1 + (ms % 3))
+            {
+                // A little past the millisecond, as the positions are whole milliseconds
+                double time = 10 + ms / 1000. + 0.0001;
+                Feedback360Effect fresh(stepped);
+                LONG a[EFFECT_CHANNELS] = {0};
+                LONG b[EFFECT_CHANNELS] = {0};
+
+                fresh.PreparePhase();
+                stepped.Calc(time, NULL, a, 2);
+                fresh.Calc(time, NULL, b, 2);
+                if (abs(a[0] - b[0]) > worst)
+                    worst = abs(a[0] - b[0]);
+            }
+            if (kinds[k] == SQUARE)
+                CHECK_EQUAL(0, worst);
+            else
+                CHECK(worst <= 1);
+        }
+    }
+}
+
+int main(int argc, char **argv)
+{
+    Record = (argc > 1) && (strcmp(argv[1], "--record") == 0);
+    TestGolden();
+    TestSine();
+    TestShapes();
+    TestOffset();
+    TestStepping();
+    return TestResult("waveform");
+}
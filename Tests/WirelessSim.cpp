@@ -0,0 +1,232 @@
+/*
+    MICE Xbox 360 Controller driver for Mac OS X
+    Copyright (C) 2006-2013 Colin Munro
+
+    WirelessSim.cpp - generates wireless receiver traffic on the host
+
+    This file is part of Xbox360Controller.
+
+    Xbox360Controller is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    Xbox360Controller is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Foobar; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include "WirelessSim.h"
+
+WirelessSim::WirelessSim(unsigned int seed) : state(seed ? seed : 1), connections(0), corrupt(0), corrupted(0)
+{
+    memset(controllers, 0, sizeof(controllers));
+}
+
+int WirelessSim::Status(unsigned char *buf, unsigned char attached)
+{
+    buf[0] = WIRELESS_MSG_STATUS;
+    buf[1] = attached;
+    return WIRELESS_STATUS_LENGTH;
+}
+
+int WirelessSim::Info(unsigned char *buf, unsigned long serial, int battery)
+{
+    memset(buf, 0, WIRELESS_MSG_LENGTH);
+    buf[WIRELESS_MSG_TYPE] = WIRELESS_TYPE_INFO;
+    for (int i = 0; i < 4; i++)
+        buf[WIRELESS_INFO_SERIAL + i] = (unsigned char)(serial >> (24 - (i * 8)));
+    if (battery >= 0)
+    {
+        buf[WIRELESS_INFO_KIND] = WIRELESS_UPDATE_BATTERY;
+        buf[WIRELESS_INFO_DATA] = (unsigned char)battery;
+    }
+    return WIRELESS_MSG_LENGTH;
+}
+
+int WirelessSim::Battery(unsigned char *buf, unsigned char level)
+{
+    memset(buf, 0, WIRELESS_MSG_LENGTH);
+    buf[WIRELESS_MSG_TYPE] = WIRELESS_TYPE_UPDATE;
+    buf[WIRELESS_UPDATE_KIND] = WIRELESS_UPDATE_BATTERY;
+    buf[WIRELESS_UPDATE_DATA] = level;
+    return WIRELESS_MSG_LENGTH;
+}
+
+int WirelessSim::Input(unsigned char *buf, unsigned short buttons, unsigned short sequence)
+{
+    unsigned char *report = buf + WIRELESS_INPUT_DATA;
+
+    memset(buf, 0, WIRELESS_MSG_LENGTH);
+    buf[WIRELESS_MSG_TYPE] = WIRELESS_TYPE_INPUT;
+    buf[WIRELESS_UPDATE_KIND] = WIRELESS_INPUT_REPORT;
+    // Same layout as the wired report: type, length, buttons, triggers, sticks
+    report[0] = 0x00;
+    report[1] = WIRELESS_SIM_REPORT;
+    report[2] = (unsigned char)(buttons & 0xff);
+    report[3] = (unsigned char)(buttons >> 8);
+    report[6] = (unsigned char)(sequence & 0xff);
+    report[7] = (unsigned char)(sequence >> 8);
+    return WIRELESS_MSG_LENGTH;
+}
+
+int WirelessSim::ChatPad(unsigned char *buf, unsigned char modifiers, const unsigned char keys[3])
+{
+    unsigned char *report = buf + WIRELESS_CHATPAD_DATA;
+
+    memset(buf, 0, WIRELESS_MSG_LENGTH);
+    buf[WIRELESS_MSG_TYPE] = WIRELESS_TYPE_CHATPAD;
+    report[0] = 0x00;
+    report[1] = modifiers;
+    memcpy(report + 2, keys, 3);
+    return WIRELESS_MSG_LENGTH;
+}
+
+unsigned short WirelessSim::Sequence(const unsigned char *buf)
+{
+    return buf[WIRELESS_INPUT_DATA + 6] | (buf[WIRELESS_INPUT_DATA + 7] << 8);
+}
+
+// xorshift, so runs repeat exactly for a seed on every host
+unsigned int WirelessSim::Random(void)
+{
+    state ^= state << 13;
+    state ^= state >> 17;
+    state ^= state << 5;
+    return state;
+}
+
+double WirelessSim::Uniform(double low, double high)
+{
+    return low + ((high - low) * (Random() % 100000) / 100000.);
+}
+
+void WirelessSim::Start(int count, int corruptRate)
+{
+    connections = (count > 4) ? 4 : count;
+    corrupt = corruptRate;
+    for (int i = 0; i < connections; i++)
+    {
+        controllers[i].attached = false;
+        controllers[i].next = Uniform(0, 0.5);
+        controllers[i].sequence = 0;
+        controllers[i].battery = 0xc0 + (Random() % 0x40);
+    }
+}
+
+// The next message from one controller, which also decides when it sends again
+void WirelessSim::Step(int index, WIRELESS_FRAME *frame)
+{
+    SIM_CONTROLLER *controller = &controllers[index];
+    unsigned int roll = Random() % 1000;
+
+    frame->index = index;
+    frame->time = controller->next;
+    if (!controller->attached)
+    {
+        // A new controller announces itself, then sends its info
+        frame->length = Status(frame->data, WIRELESS_STATUS_CONTROLLER);
+        controller->attached = true;
+        controller->next += 0.002;
+        controller->sequence = 0;
+        return;
+    }
+    if (controller->sequence == 0)
+    {
+        frame->length = Info(frame->data, 0x10000000 + index, controller->battery);
+        controller->sequence = 1;
+        controller->next += 0.008;
+        return;
+    }
+    if (roll < 1)
+    {
+        // Switched off or out of range, it comes back a little later
+        frame->length = Status(frame->data, WIRELESS_STATUS_NONE);
+        controller->attached = false;
+        controller->next += Uniform(0.1, 1.0);
+        return;
+    }
+    if (roll < 3)
+    {
+        if (controller->battery > 0)
+            controller->battery--;
+        frame->length = Battery(frame->data, (unsigned char)controller->battery);
+    }
+    else if (roll < 13)
+    {
+        const unsigned char keys[3] = {(unsigned char)(0x11 + (Random() % 0x60)), 0x00, 0x00};
+
+        frame->length = ChatPad(frame->data, 0x00, keys);
+    }
+    else
+    {
+        frame->length = Input(frame->data, (unsigned short)Random(), controller->sequence++);
+        if ((unsigned int)(Random() % 1000) < (unsigned int)corrupt)
+        {
+            frame->data[WIRELESS_INPUT_LENGTH] = WIRELESS_MSG_LENGTH;
+            corrupted++;
+        }
+    }
+    // Reports are about 8 ms apart, with the jitter of a radio link
+    controller->next += Uniform(0.006, 0.010);
+}
+
+void WirelessSim::Next(WIRELESS_FRAME *frame)
+{
+    int earliest = 0;
+
+    for (int i = 1; i < connections; i++)
+    {
+        if (controllers[i].next < controllers[earliest].next)
+            earliest = i;
+    }
+    Step(earliest, frame);
+}
+
+bool WirelessReadFrames(const char *path, std::vector<WIRELESS_FRAME> *frames)
+{
+    FILE *file = fopen(path, "r");
+    char line[512];
+
+    if (file == NULL)
+        return false;
+    while (fgets(line, sizeof(line), file) != NULL)
+    {
+        WIRELESS_FRAME frame;
+        char *p = line, *end;
+
+        while (isspace((unsigned char)*p))
+            p++;
+        if ((*p == '\0') || (*p == '#'))
+            continue;
+        memset(&frame, 0, sizeof(frame));
+        frame.index = (int)strtol(p, &end, 10);
+        frame.time = frames->size() * 0.008;
+        p = end;
+        for (;;)
+        {
+            long value = strtol(p, &end, 16);
+
+            if (end == p)
+                break;
+            if (frame.length == WIRELESS_PACKET_SIZE)
+            {
+                fclose(file);
+                return false;
+            }
+            frame.data[frame.length++] = (unsigned char)value;
+            p = end;
+        }
+        frames->push_back(frame);
+    }
+    fclose(file);
+    return true;
+}
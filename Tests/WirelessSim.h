@@ -0,0 +1,90 @@
+/*
+    MICE Xbox 360 Controller driver for Mac OS X
+    Copyright (C) 2006-2013 Colin Munro
+
+    WirelessSim.h - generates wireless receiver traffic on the host
+
+    This file is part of Xbox360Controller.
+
+    Xbox360Controller is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    Xbox360Controller is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Foobar; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+#ifndef __WIRELESSSIM_H__
+#define __WIRELESSSIM_H__
+
+#include <vector>
+#include "../WirelessGamingReceiver/protocol.h"
+
+// One message as read from a controller pipe of the receiver
+typedef struct WIRELESS_FRAME
+{
+    int index;              // Connection the message arrived on
+    double time;            // Seconds since the start of the traffic
+    int length;
+    unsigned char data[WIRELESS_PACKET_SIZE];
+} WIRELESS_FRAME;
+
+// Length of the input report a wired or wireless 360 controller sends
+#define WIRELESS_SIM_REPORT 0x13
+
+// Builds messages in the receiver's format, and produces seeded random traffic
+// from up to four controllers. Input reports carry a sequence number in the left
+// stick's X axis so a consumer can check their order
+class WirelessSim
+{
+public:
+    WirelessSim(unsigned int seed);
+
+    // Messages, each returns its length
+    static int Status(unsigned char *buf, unsigned char attached);
+    static int Info(unsigned char *buf, unsigned long serial, int battery);
+    static int Battery(unsigned char *buf, unsigned char level);
+    static int Input(unsigned char *buf, unsigned short buttons, unsigned short sequence);
+    static int ChatPad(unsigned char *buf, unsigned char modifiers, const unsigned char keys[3]);
+
+    // Sequence number of an input message built by Input
+    static unsigned short Sequence(const unsigned char *buf);
+
+    // Traffic for this many connections, each controller going through connect, info,
+    // reports at about 125 Hz, battery updates, ChatPad keys and the odd disconnect.
+    // Corrupt sets how often, out of 1000, an input report claims more bytes than it has
+    void Start(int connections, int corrupt);
+    void Next(WIRELESS_FRAME *frame);
+
+    // Input reports sent with a bad length so far
+    int Corrupted(void) const { return corrupted; }
+
+private:
+    typedef struct SIM_CONTROLLER
+    {
+        bool attached;
+        double next;
+        unsigned short sequence;
+        int battery;
+    } SIM_CONTROLLER;
+
+    unsigned int Random(void);
+    double Uniform(double low, double high);
+    void Step(int index, WIRELESS_FRAME *frame);
+
+    unsigned int state;
+    int connections, corrupt, corrupted;
+    SIM_CONTROLLER controllers[4];
+};
+
+// Reads frames saved one per line as a connection number followed by the bytes
+// in hex, so captured traffic can be replayed. Blank lines and # comments are skipped
+bool WirelessReadFrames(const char *path, std::vector<WIRELESS_FRAME> *frames);
+
+#endif // __WIRELESSSIM_H__
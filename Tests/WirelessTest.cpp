@@ -0,0 +1,432 @@
+/*
+    MICE Xbox 360 Controller driver for Mac OS X
+    Copyright (C) 2006-2013 Colin Munro
+
+    WirelessTest.cpp - receiver message handling against simulated traffic
+
+    This file is part of Xbox360Controller.
+
+    Xbox360Controller is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    Xbox360Controller is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Foobar; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+#include <string.h>
+#include <time.h>
+#include <vector>
+#include "TestCommon.h"
+#include "WirelessSim.h"
+#include "../WirelessGamingReceiver/WirelessQueue.h"
+#include "../WirelessGamingReceiver/WirelessDispatch.h"
+
+// What the device side made of the messages it was given, decoded by
+// WirelessDecode as WirelessHIDDevice does
+typedef struct SIM_DEVICE
+{
+    unsigned long serial;
+    int battery;
+    int batteryReadings;
+    int inputs;
+    int rejected;
+    int chatPadKeys;
+    unsigned short lastSequence;
+    bool outOfOrder;
+
+    void receivedSerial(const unsigned char *data)
+    {
+        serial = 0;
+        for (int i = 0; i < 4; i++)
+            serial = (serial << 8) | data[i];
+        lastSequence = 0;
+    }
+
+    void receivedUpdate(unsigned char type, unsigned char *data)
+    {
+        if (type == WIRELESS_UPDATE_BATTERY)
+        {
+            battery = data[0];
+            batteryReadings++;
+        }
+    }
+
+    void receivedHIDupdate(unsigned char *data, int length)
+    {
+        // Sequence reads the report through the message it sits in
+        unsigned short sequence = WirelessSim::Sequence(data - WIRELESS_INPUT_DATA);
+
+        CHECK_EQUAL(WIRELESS_SIM_REPORT, length);
+
+        if (sequence <= lastSequence)
+            outOfOrder = true;
+        lastSequence = sequence;
+        inputs++;
+    }
+
+    void receivedChatPad(unsigned char *data, int length)
+    {
+        CHECK_EQUAL(WIRELESS_CHATPAD_LENGTH, length);
+        CHECK_EQUAL(0, data[0]);
+        chatPadKeys++;
+    }
+} SIM_DEVICE;
+
+// The receiver's side of one connection
+typedef struct SIM_CONNECTION
+{
+    WirelessQueue queue;
+    bool attached;
+    int connects, disconnects;
+    bool stalled;
+    double stallEnd;
+    SIM_DEVICE device;
+    int pushed, popped;
+    int controlPushed, controlPopped;
+} SIM_CONNECTION;
+
+static void Receive(SIM_DEVICE *device, unsigned char *buf, int length)
+{
+    if (!WirelessDecode(device, buf, length, WIRELESS_CHATPAD_DATA) && WirelessIsInput(buf, length))
+        device->rejected++;
+}
+
+static void Drain(SIM_CONNECTION *connection)
+{
+    unsigned char buf[WIRELESS_PACKET_SIZE];
+    int length;
+
+    while ((length = connection->queue.Pop(buf, sizeof(buf))) != 0)
+    {
+        connection->popped++;
+        if (!WirelessIsInput(buf, length))
+            connection->controlPopped++;
+        Receive(&connection->device, buf, length);
+    }
+}
+
+// The receiver, routed by WirelessDispatch as WirelessGamingReceiver does. A
+// stalled device refuses everything handed to it
+typedef struct SIM_RECEIVER
+{
+    SIM_CONNECTION *connections;
+    int limit;
+    WIRELESS_OVERFLOW overflow;
+
+    void DeviceDetached(int index)
+    {
+        connections[index].attached = false;
+        connections[index].disconnects++;
+    }
+
+    void DeviceAttached(int index)
+    {
+        if (!connections[index].attached)
+        {
+            connections[index].attached = true;
+            connections[index].connects++;
+        }
+    }
+
+    bool IsDataQueued(int index)
+    {
+        return connections[index].queue.Count() > 0;
+    }
+
+    bool DeliverMessage(int index, unsigned char *data, int length)
+    {
+        if (connections[index].stalled)
+            return false;
+        Receive(&connections[index].device, data, length);
+        return true;
+    }
+
+    void DeferMessage(int index, unsigned char *data, int length)
+    {
+        SIM_CONNECTION *connection = &connections[index];
+
+        connection->pushed++;
+        if (!WirelessIsInput(data, length))
+            connection->controlPushed++;
+        connection->queue.Push(data, length, limit, overflow);
+        CHECK(connection->queue.Count() <= limit);
+        if (!connection->stalled)
+            Drain(connection);
+    }
+} SIM_RECEIVER;
+
+static void Process(SIM_RECEIVER *receiver, WIRELESS_FRAME *frame)
+{
+    WirelessDispatch(receiver, frame->index, frame->data, frame->length);
+}
+
+static void Reset(SIM_RECEIVER *receiver, SIM_CONNECTION *connections, int count, WIRELESS_OVERFLOW overflow)
+{
+    for (int i = 0; i < count; i++)
+    {
+        memset(&connections[i], 0, sizeof(connections[i]));
+        connections[i].queue.Reset();
+    }
+    receiver->connections = connections;
+    receiver->limit = WIRELESS_QUEUE_DEFAULT;
+    receiver->overflow = overflow;
+}
+
+// A short session saved in the receiver's format
+static void TestSession(const char *path)
+{
+    std::vector<WIRELESS_FRAME> frames;
+    SIM_CONNECTION connections[2];
+    SIM_RECEIVER receiver;
+
+    CHECK(WirelessReadFrames(path, &frames));
+    Reset(&receiver, connections, 2, woDropOldestInput);
+    for (size_t i = 0; i < frames.size(); i++)
+    {
+        CHECK(frames[i].index < 2);
+        Process(&receiver, &frames[i]);
+    }
+    CHECK_EQUAL(0x1234ABCD, connections[0].device.serial);
+    CHECK_EQUAL(0xc4, connections[0].device.battery);
+    CHECK_EQUAL(2, connections[0].device.batteryReadings);
+    CHECK_EQUAL(5, connections[0].device.inputs);
+    CHECK_EQUAL(1, connections[0].device.chatPadKeys);
+    CHECK(!connections[0].attached);
+    CHECK_EQUAL(0x00C0FFEE, connections[1].device.serial);
+    CHECK_EQUAL(0, connections[1].device.batteryReadings);
+    CHECK_EQUAL(2, connections[1].device.inputs);
+    CHECK(connections[1].attached);
+}
+
+// The overflow policies, one case each
+static void TestOverflow(void)
+{
+    WirelessQueue queue;
+    unsigned char buf[WIRELESS_PACKET_SIZE];
+    unsigned char battery[WIRELESS_PACKET_SIZE];
+    int length;
+
+    // A control message takes the place of the oldest input report
+    queue.Reset();
+    for (int i = 1; i <= 4; i++)
+    {
+        length = WirelessSim::Input(buf, 0, i);
+        queue.Push(buf, length, 4, woDropNewestInput);
+    }
+    length = WirelessSim::Battery(battery, 0x80);
+    queue.Push(battery, length, 4, woDropNewestInput);
+    CHECK_EQUAL(4, queue.Count());
+    CHECK_EQUAL(1, queue.inputDropped);
+    CHECK_EQUAL(WIRELESS_MSG_LENGTH, queue.Pop(buf, sizeof(buf)));
+    CHECK_EQUAL(2, WirelessSim::Sequence(buf));
+
+    // Dropping the newest keeps what is already queued
+    length = WirelessSim::Input(buf, 0, 5);
+    queue.Push(buf, length, 3, woDropNewestInput);
+    CHECK_EQUAL(3, queue.Count());
+    CHECK_EQUAL(2, queue.inputDropped);
+
+    // Dropping the oldest makes room for the new one, keeping the order
+    queue.Reset();
+    for (int i = 1; i <= 5; i++)
+    {
+        length = WirelessSim::Input(buf, 0, i);
+        queue.Push(buf, length, 3, woDropOldestInput);
+    }
+    CHECK_EQUAL(3, queue.Count());
+    CHECK_EQUAL(2, queue.inputDropped);
+    for (int i = 3; i <= 5; i++)
+    {
+        queue.Pop(buf, sizeof(buf));
+        CHECK_EQUAL(i, WirelessSim::Sequence(buf));
+    }
+
+    // Only control messages waiting, so the oldest of those goes
+    queue.Reset();
+    for (int i = 0; i < 3; i++)
+    {
+        length = WirelessSim::Battery(battery, (unsigned char)i);
+        queue.Push(battery, length, 2, woDropOldestInput);
+    }
+    CHECK_EQUAL(1, queue.controlDropped);
+    queue.Pop(buf, sizeof(buf));
+    CHECK_EQUAL(1, buf[WIRELESS_UPDATE_DATA]);
+    CHECK_EQUAL(2, queue.highWater);
+
+    // The info message is found anywhere in the ring
+    queue.Reset();
+    CHECK(!queue.IsInfoQueued());
+    length = WirelessSim::Input(buf, 0, 1);
+    queue.Push(buf, length, 4, woDropOldestInput);
+    length = WirelessSim::Info(buf, 1, -1);
+    queue.Push(buf, length, 4, woDropOldestInput);
+    CHECK(queue.IsInfoQueued());
+
+    // Messages too big for a packet are refused
+    queue.Reset();
+    queue.Push(buf, WIRELESS_PACKET_SIZE + 1, 4, woDropOldestInput);
+    CHECK_EQUAL(0, queue.Count());
+}
+
+// The report length byte is checked against the bytes that arrived
+static void TestInputLength(void)
+{
+    unsigned char buf[WIRELESS_PACKET_SIZE];
+    const unsigned char *report;
+    int length, reportLength = 0;
+
+    length = WirelessSim::Input(buf, 0, 1);
+    report = WirelessInputReport(buf, length, &reportLength);
+    CHECK(report == buf + WIRELESS_INPUT_DATA);
+    CHECK_EQUAL(WIRELESS_SIM_REPORT, reportLength);
+
+    // The largest report that fits, then one byte more
+    buf[WIRELESS_INPUT_LENGTH] = WIRELESS_MSG_LENGTH - WIRELESS_INPUT_DATA;
+    CHECK(WirelessInputReport(buf, length, &reportLength) != NULL);
+    buf[WIRELESS_INPUT_LENGTH]++;
+    CHECK(WirelessInputReport(buf, length, &reportLength) == NULL);
+
+    // A length that fits the largest packet but not what arrived
+    buf[WIRELESS_INPUT_LENGTH] = WIRELESS_SIM_REPORT;
+    CHECK(WirelessInputReport(buf, WIRELESS_INPUT_DATA + WIRELESS_SIM_REPORT - 1, &reportLength) == NULL);
+
+    // Too short to hold even the report header
+    buf[WIRELESS_INPUT_LENGTH] = 1;
+    CHECK(WirelessInputReport(buf, length, &reportLength) == NULL);
+    CHECK(WirelessInputReport(buf, WIRELESS_INPUT_DATA + 1, &reportLength) == NULL);
+
+    // Other input kinds carry no report
+    length = WirelessSim::Input(buf, 0, 1);
+    buf[WIRELESS_UPDATE_KIND] = 0x00;
+    CHECK(WirelessInputReport(buf, length, &reportLength) == NULL);
+}
+
+// Four controllers for a simulated minute, with devices that stall for up to
+// 300 ms at a time. Nothing but input reports may be lost, and those that get
+// through must stay in order
+static void TestSoak(WIRELESS_OVERFLOW overflow, unsigned int seed, int corrupt)
+{
+    WirelessSim sim(seed);
+    SIM_CONNECTION connections[4];
+    SIM_RECEIVER receiver;
+    WIRELESS_FRAME frame;
+    unsigned int roll = seed;
+    int frames = 0, rejected = 0;
+
+    Reset(&receiver, connections, 4, overflow);
+    sim.Start(4, corrupt);
+    do
+    {
+        sim.Next(&frame);
+        frames++;
+        SIM_CONNECTION *connection = &connections[frame.index];
+        if (connection->stalled && (frame.time >= connection->stallEnd))
+        {
+            connection->stalled = false;
+            Drain(connection);
+        }
+        roll = (roll * 1103515245) + 12345;
+        if (!connection->stalled && (((roll >> 16) % 500) == 0))
+        {
+            connection->stalled = true;
+            connection->stallEnd = frame.time + (0.3 * ((roll >> 8) % 100) / 100.);
+        }
+        Process(&receiver, &frame);
+    }
+    while (frame.time < 60.);
+
+    CHECK(frames > 4 * 60 * 100);
+    for (int i = 0; i < 4; i++)
+    {
+        SIM_CONNECTION *connection = &connections[i];
+
+        connection->stalled = false;
+        Drain(connection);
+        CHECK(connection->connects > 0);
+        CHECK(connection->device.inputs > 0);
+        CHECK(!connection->device.outOfOrder);
+        CHECK_EQUAL(0, connection->queue.controlDropped);
+        CHECK_EQUAL(connection->controlPushed, connection->controlPopped);
+        CHECK_EQUAL(connection->pushed, connection->popped + (int)connection->queue.inputDropped);
+        CHECK(connection->queue.highWater <= WIRELESS_QUEUE_DEFAULT);
+        rejected += connection->device.rejected;
+    }
+    // Bad reports may also be dropped from a full queue, but never decoded
+    CHECK(rejected <= sim.Corrupted());
+    CHECK((corrupt == 0) || (rejected > 0));
+}
+
+static double Seconds(void)
+{
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec + (now.tv_nsec / 1e9);
+}
+
+// Time per input message on the device side: handed over in place, copied
+// into a separate report buffer first, or queued and read back
+static void Bench(void)
+{
+    const int count = 4000000, messages = 256;
+    static unsigned char buf[messages][WIRELESS_PACKET_SIZE];
+    unsigned char copy[WIRELESS_PACKET_SIZE];
+    WirelessQueue queue;
+    volatile unsigned int sink = 0;
+    double start;
+    int length = 0, reportLength;
+
+    for (int i = 0; i < messages; i++)
+        length = WirelessSim::Input(buf[i], 0, (unsigned short)i);
+
+    start = Seconds();
+    for (int i = 0; i < count; i++)
+    {
+        const unsigned char *report = WirelessInputReport(buf[i % messages], length, &reportLength);
+        sink = sink + report[6] + reportLength;
+    }
+    printf("in place: %.1f ns per report\n", (Seconds() - start) * 1e9 / count);
+
+    start = Seconds();
+    for (int i = 0; i < count; i++)
+    {
+        const unsigned char *report = WirelessInputReport(buf[i % messages], length, &reportLength);
+        memcpy(copy, report, reportLength);
+        sink = sink + copy[6] + reportLength;
+    }
+    printf("copied:   %.1f ns per report\n", (Seconds() - start) * 1e9 / count);
+
+    queue.Reset();
+    start = Seconds();
+    for (int i = 0; i < count; i++)
+    {
+        queue.Push(buf[i % messages], length, WIRELESS_QUEUE_DEFAULT, woDropOldestInput);
+        int popped = queue.Pop(copy, sizeof(copy));
+        const unsigned char *report = WirelessInputReport(copy, popped, &reportLength);
+        sink = sink + report[6] + reportLength;
+    }
+    printf("queued:   %.1f ns per report\n", (Seconds() - start) * 1e9 / count);
+}
+
+int main(int argc, char **argv)
+{
+    if ((argc > 1) && (strcmp(argv[1], "--bench") == 0))
+    {
+        Bench();
+        return 0;
+    }
+    TestSession((argc > 1) ? argv[1] : "data/wireless-session.txt");
+    TestOverflow();
+    TestInputLength();
+    TestSoak(woDropOldestInput, 1, 0);
+    TestSoak(woDropNewestInput, 2, 0);
+    TestSoak(woDropOldestInput, 3, 5);
+    return TestResult("wireless");
+}
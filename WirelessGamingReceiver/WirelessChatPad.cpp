@@ -0,0 +1,109 @@
+/*
+    MICE Xbox 360 Controller driver for Mac OS X
+    Copyright (C) 2006-2013 Colin Munro
+
+    WirelessChatPad.cpp - implementation of the ChatPad keyboard on a wireless controller
+
+    This file is part of Xbox360Controller.
+
+    Xbox360Controller is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    Xbox360Controller is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Foobar; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+#include "WirelessChatPad.h"
+#include "WirelessHIDDevice.h"
+#include "../360Controller/chatpadkeyboard.h"
+
+// Keeps the ChatPad's location clear of the other controllers on the receiver
+#define CHATPAD_LOCATION_OFFSET 0x10
+
+OSDefineMetaClassAndStructors(WirelessChatPad, IOHIDDevice)
+
+IOReturn WirelessChatPad::newReportDescriptor(IOMemoryDescriptor **descriptor) const
+{
+    return ChatPadNewReportDescriptor(descriptor);
+}
+
+IOReturn WirelessChatPad::setReport(IOMemoryDescriptor *report, IOHIDReportType reportType, IOOptionBits options)
+{
+    return kIOReturnUnsupported;
+}
+
+IOReturn WirelessChatPad::getReport(IOMemoryDescriptor *report, IOHIDReportType reportType, IOOptionBits options)
+{
+    return kIOReturnUnsupported;
+}
+
+// Reports have the same layout as the wired ChatPad's, keys are translated in place
+IOReturn WirelessChatPad::handleReport(IOMemoryDescriptor *report, IOHIDReportType reportType, IOOptionBits options)
+{
+    ChatPadTranslate(report);
+    return IOHIDDevice::handleReport(report, reportType, options);
+}
+
+OSNumber* WirelessChatPad::newPrimaryUsageNumber() const
+{
+    return ChatPadNewPrimaryUsageNumber();
+}
+
+OSNumber* WirelessChatPad::newPrimaryUsagePageNumber() const
+{
+    return ChatPadNewPrimaryUsagePageNumber();
+}
+
+OSString* WirelessChatPad::newProductString() const
+{
+    return ChatPadNewProductString();
+}
+
+OSString* WirelessChatPad::newTransportString() const
+{
+    return OSString::withCString("Wireless");
+}
+
+OSNumber* WirelessChatPad::newVendorIDNumber() const
+{
+    return ChatPadNewVendorIDNumber();
+}
+
+OSNumber* WirelessChatPad::newProductIDNumber() const
+{
+    return ChatPadNewProductIDNumber();
+}
+
+static IOHIDDevice* GetParent(const IOService *current)
+{
+    return OSDynamicCast(WirelessHIDDevice, current->getProvider());
+}
+
+bool WirelessChatPad::start(IOService *provider)
+{
+    if (OSDynamicCast(WirelessHIDDevice, provider) == NULL)
+        return false;
+    return IOHIDDevice::start(provider);
+}
+
+OSString* WirelessChatPad::newManufacturerString() const
+{
+    return ChatPadNewManufacturerString(GetParent(this));
+}
+
+OSString* WirelessChatPad::newSerialNumberString() const
+{
+    return ChatPadNewSerialNumberString(GetParent(this));
+}
+
+OSNumber* WirelessChatPad::newLocationIDNumber() const
+{
+    return ChatPadNewLocationIDNumber(GetParent(this), CHATPAD_LOCATION_OFFSET);
+}
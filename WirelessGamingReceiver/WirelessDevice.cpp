@@ -33,6 +33,7 @@ bool WirelessDevice::init(OSDictionary *dictionary)
         return false;
     index = -1;
     function = NULL;
+    handler = NULL;
     return true;
 }
 
@@ -47,15 +48,15 @@ bool WirelessDevice::IsDataAvailable(void)
     return receiver->IsDataQueued(index);
 }
 
-// Gets the next item from our buffer
-IOMemoryDescriptor* WirelessDevice::NextPacket(void)
+// Copies the next item from our buffer, returning its length or 0 if there is none
+size_t WirelessDevice::NextPacket(void *buffer, size_t length)
 {
     if (index == -1)
-        return NULL;
+        return 0;
     WirelessGamingReceiver *receiver = OSDynamicCast(WirelessGamingReceiver, getProvider());
     if (receiver == NULL)
-        return NULL;
-    return receiver->ReadBuffer(index);
+        return 0;
+    return receiver->ReadPacket(index, buffer, length);
 }
 
 // Sends a buffer for this controller
@@ -69,12 +70,24 @@ void WirelessDevice::SendPacket(const void *data, size_t length)
     receiver->QueueWrite(index, data, (UInt32)length);
 }
 
-// Registers a callback function
-void WirelessDevice::RegisterWatcher(void *target, WirelessDeviceWatcher function, void *parameter)
+// Restarts the countdown to turning the controller off
+void WirelessDevice::ResetIdle(void)
+{
+    if (index == -1)
+        return;
+    WirelessGamingReceiver *receiver = OSDynamicCast(WirelessGamingReceiver, getProvider());
+    if (receiver == NULL)
+        return;
+    receiver->ResetIdle(index);
+}
+
+// Registers a callback function, and optionally one that takes packets without them being queued
+void WirelessDevice::RegisterWatcher(void *target, WirelessDeviceWatcher function, void *parameter, WirelessDeviceHandler handler)
 {
     this->target = target;
     this->parameter = parameter;
     this->function = function;
+    this->handler = handler;
     if ((function != NULL) && IsDataAvailable())
         NewData();
 }
@@ -92,6 +105,15 @@ void WirelessDevice::NewData(void)
         function(target, this, parameter);
 }
 
+// Called with a packet that can be handled in place, returns false if it needs queueing instead
+bool WirelessDevice::Deliver(unsigned char *data, size_t length)
+{
+    if (handler == NULL)
+        return false;
+    handler(target, this, data, length);
+    return true;
+}
+
 // Gets the location ID for this device
 OSNumber* WirelessDevice::newLocationIDNumber() const
 {
@@ -24,10 +24,12 @@
 #define __WIRELESSDEVICE_H__
 
 #include <IOKit/IOService.h>
+#include "protocol.h"
 
 class WirelessDevice;
 
 typedef void (*WirelessDeviceWatcher)(void *target, WirelessDevice *sender, void *parameter);
+typedef void (*WirelessDeviceHandler)(void *target, WirelessDevice *sender, unsigned char *data, size_t length);
 
 class WirelessDevice : public IOService
 {
@@ -38,11 +40,12 @@ public:
 
     // Controller interface
     bool IsDataAvailable(void);
-    IOMemoryDescriptor* NextPacket(void);
+    size_t NextPacket(void *buffer, size_t length);
 
     void SendPacket(const void *data, size_t length);
+    void ResetIdle(void);
 
-    void RegisterWatcher(void *target, WirelessDeviceWatcher function, void *parameter);
+    void RegisterWatcher(void *target, WirelessDeviceWatcher function, void *parameter, WirelessDeviceHandler handler = NULL);
 
     OSNumber* newLocationIDNumber() const;
 
@@ -50,10 +53,12 @@ private:
     friend class WirelessGamingReceiver;
     void SetIndex(int i);
     void NewData(void);
+    bool Deliver(unsigned char *data, size_t length);
     int index;
     // callback
     void *target, *parameter;
     WirelessDeviceWatcher function;
+    WirelessDeviceHandler handler;
 };
 
 #endif // __WIRELESSDEVICE_H__
@@ -0,0 +1,109 @@
+/*
+    MICE Xbox 360 Controller driver for Mac OS X
+    Copyright (C) 2006-2013 Colin Munro
+
+    WirelessDispatch.h - routing and decoding of receiver messages
+
+    This file is part of Xbox360Controller.
+
+    Xbox360Controller is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    Xbox360Controller is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Foobar; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+#ifndef __WIRELESSDISPATCH_H__
+#define __WIRELESSDISPATCH_H__
+
+#include "protocol.h"
+
+// The decisions the receiver and the device make about each message, kept
+// apart from what they do about them. WirelessGamingReceiver and
+// WirelessHIDDevice pass themselves in, and the host tests pass a model of
+// each, so both run the same routing and decoding
+
+// Route one message from a controller pipe on the receiver. Receiver provides
+//   void DeviceDetached(int index)
+//   void DeviceAttached(int index)
+//   bool IsDataQueued(int index)
+//   bool DeliverMessage(int index, unsigned char *data, int length)
+//   void DeferMessage(int index, unsigned char *data, int length)
+// Returns false for a status message, which the receiver handles itself
+template<class Receiver>
+bool WirelessDispatch(Receiver *receiver, int index, unsigned char *data, int length)
+{
+    if (WirelessIsStatus(data, length))
+    {
+        if (data[1] == WIRELESS_STATUS_NONE)
+            receiver->DeviceDetached(index);
+        else
+            receiver->DeviceAttached(index);
+        return false;
+    }
+
+    // Straight to the device if nothing is waiting ahead of it, otherwise queued
+    if (receiver->IsDataQueued(index) || !receiver->DeliverMessage(index, data, length))
+        receiver->DeferMessage(index, data, length);
+    return true;
+}
+
+// Decode one message on the device, which may translate it in place. Device provides
+//   void receivedSerial(const unsigned char *serial)
+//   void receivedUpdate(unsigned char type, unsigned char *data)
+//   void receivedHIDupdate(unsigned char *data, int length)
+//   void receivedChatPad(unsigned char *data, int length)
+// Returns false if the message was malformed and dropped
+template<class Device>
+bool WirelessDecode(Device *device, unsigned char *buf, int length, int chatPadOffset)
+{
+    if (length != WIRELESS_MSG_LENGTH)
+        return false;
+
+    switch (buf[WIRELESS_MSG_TYPE])
+    {
+        case WIRELESS_TYPE_INFO:    // Initial info
+            if (buf[WIRELESS_INFO_KIND] == WIRELESS_UPDATE_BATTERY)
+                device->receivedUpdate(WIRELESS_UPDATE_BATTERY, buf + WIRELESS_INFO_DATA);
+            device->receivedSerial(buf + WIRELESS_INFO_SERIAL);
+            break;
+
+        case WIRELESS_TYPE_INPUT:   // HID info update
+            {
+                int reportLength;
+                unsigned char *report = (unsigned char*)WirelessInputReport(buf, length, &reportLength);
+
+                if (report == 0)
+                    return false;
+                device->receivedHIDupdate(report, reportLength);
+            }
+            break;
+
+        case WIRELESS_TYPE_CHATPAD: // ChatPad keys
+            {
+                unsigned char *report = (unsigned char*)WirelessChatPadReport(buf, length, chatPadOffset);
+
+                if (report == 0)
+                    return false;
+                device->receivedChatPad(report, WIRELESS_CHATPAD_LENGTH);
+            }
+            break;
+
+        case WIRELESS_TYPE_UPDATE:  // Info update
+            device->receivedUpdate(buf[WIRELESS_UPDATE_KIND], buf + WIRELESS_UPDATE_DATA);
+            break;
+
+        default:
+            break;
+    }
+    return true;
+}
+
+#endif // __WIRELESSDISPATCH_H__
@@ -20,20 +20,68 @@
     along with Foobar; if not, write to the Free Software
     Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
 */
+#include <kern/clock.h>
 #include "WirelessGamingReceiver.h"
 #include "WirelessDevice.h"
 #include "devices.h"
+#include "protocol.h"
+#include "WirelessDispatch.h"
 
 //#define PROTOCOL_DEBUG
 
+#define kQueueLengthKey         "InputQueueLength"
+#define kQueueOverflowKey       "InputQueueOverflow"
+
+// Global slot registry, receiver n owns slots n * WIRELESS_CONNECTIONS onwards.
+// Places remember the USB location of their last receiver, so a receiver put
+// back in the same port gets the same slots
+typedef struct WIRELESS_RECEIVER_PLACE
+{
+    WirelessGamingReceiver *receiver;
+    UInt32 location;
+} WIRELESS_RECEIVER_PLACE;
+
+static WIRELESS_RECEIVER_PLACE receivers[WIRELESS_RECEIVERS];
+
 OSDefineMetaClassAndStructors(WirelessGamingReceiver, IOService)
 
-// Holds data for asynchronous reads
-typedef struct WGRREAD
+// Add a counter to a statistics dictionary
+static void SetStatistic(OSDictionary *dictionary, const char *key, UInt64 value)
+{
+    OSNumber *number = OSNumber::withNumber(value, 64);
+
+    if (number != NULL)
+    {
+        dictionary->setObject(key, number);
+        number->release();
+    }
+}
+
+// Current uptime in milliseconds, for telemetry
+static UInt64 UptimeMilliseconds(void)
 {
-    int index;
-    IOBufferMemoryDescriptor *buffer;
-} WGRREAD;
+    UInt64 now, ns;
+
+    clock_get_uptime(&now);
+    absolutetime_to_nanoseconds(now, &ns);
+    return ns / 1000000;
+}
+
+// Check if a command can take the place of one still waiting to be sent
+static bool IsSameCommand(const WIRELESS_PACKET *pending, const unsigned char *data, UInt32 length)
+{
+    if (pending->length != length)
+        return false;
+    if (memcmp(pending->data, data, length) == 0)
+        return true;
+    if (length < 4)
+        return false;
+    if (WIRELESS_IS_LED(pending->data) && WIRELESS_IS_LED(data))
+        return true;
+    if (WIRELESS_IS_RUMBLE(pending->data) && WIRELESS_IS_RUMBLE(data))
+        return true;
+    return false;
+}
 
 // Get maximum packet size for a pipe
 static UInt32 GetMaxPacketSize(IOUSBPipe *pipe)
@@ -59,6 +107,18 @@ bool WirelessGamingReceiver::start(IOService *provider)
         return false;
     }
 
+    receiverIndex = -1;
+    if (queueLock == NULL)
+    {
+        queueLock = IOLockAlloc();
+        if (queueLock == NULL)
+        {
+            // IOLog("start - failed to allocate queue lock\n");
+            return false;
+        }
+    }
+    ReadSettings();
+
     device = OSDynamicCast(IOUSBDevice, provider);
     if (device == NULL)
     {
@@ -103,9 +163,32 @@ bool WirelessGamingReceiver::start(IOService *provider)
         connections[i].other = NULL;
         connections[i].otherIn = NULL;
         connections[i].otherOut = NULL;
-        connections[i].inputArray = NULL;
         connections[i].service = NULL;
         connections[i].controllerStarted = false;
+        for (int j = 0; j < WIRELESS_READS; j++)
+        {
+            connections[i].reads[j].index = i;
+            connections[i].reads[j].buffer = NULL;
+        }
+        connections[i].input.Reset();
+        connections[i].outputHead = 0;
+        connections[i].outputCount = 0;
+        connections[i].readBuffersAllocated = 0;
+        connections[i].packetsReceived = 0;
+        connections[i].readErrors = 0;
+        connections[i].writesCoalesced = 0;
+        connections[i].writesDropped = 0;
+        connections[i].writeErrors = 0;
+        connections[i].lastInputTime = 0;
+        connections[i].rateStart = 0;
+        connections[i].rateCount = 0;
+        connections[i].inputRate = 0;
+        connections[i].gapHead = 0;
+        connections[i].gapCount = 0;
+        connections[i].maxGap = 0;
+        connections[i].eventHead = 0;
+        connections[i].eventCount = 0;
+        connections[i].idleDeadline = 0;
     }
 
     pipeRequest.interval = 0;
@@ -188,18 +271,60 @@ bool WirelessGamingReceiver::start(IOService *provider)
         IOLog("start - interface mismatch?\n");
     connectionCount = iConnection;
 
+    if (!RegisterReceiver())
+        IOLog("start - too many receivers, controllers will not have global slots\n");
+
+    idleArmed = false;
+    idleTimer = IOTimerEventSource::timerEventSource(this, _IdleTimeout);
+    if (idleTimer == NULL)
+    {
+        // IOLog("start: Failed to create idle timer\n");
+        goto fail;
+    }
+    if ((getWorkLoop() == NULL) || (getWorkLoop()->addEventSource(idleTimer) != kIOReturnSuccess))
+    {
+        // IOLog("start: Failed to connect idle timer\n");
+        idleTimer->release();
+        idleTimer = NULL;
+        goto fail;
+    }
+
+    // Armed by StatisticsChanged
+    statisticsArmed = 0;
+    statisticsTimer = IOTimerEventSource::timerEventSource(this, _StatisticsTimeout);
+    if (statisticsTimer == NULL)
+    {
+        // IOLog("start: Failed to create statistics timer\n");
+        goto fail;
+    }
+    if (getWorkLoop()->addEventSource(statisticsTimer) != kIOReturnSuccess)
+    {
+        // IOLog("start: Failed to connect statistics timer\n");
+        statisticsTimer->release();
+        statisticsTimer = NULL;
+        goto fail;
+    }
+
+    if (!AllocateWrites())
+    {
+        // IOLog("start: Failed to allocate write buffers\n");
+        goto fail;
+    }
+
     for (i = 0; i < connectionCount; i++)
     {
-        connections[i].inputArray = OSArray::withCapacity(5);
-        if (connections[i].inputArray == NULL)
+        if (!AllocateReads(i))
         {
-            // IOLog("start: Failed to allocate packet buffer %d\n", i);
+            // IOLog("start: Failed to allocate read buffers %d\n", i);
             goto fail;
         }
-        if (!QueueRead(i))
+        for (int j = 0; j < WIRELESS_READS; j++)
         {
-            // IOLog("start: Failed to start read %d\n", i);
-            goto fail;
+            if (!QueueRead(&connections[i].reads[j]))
+            {
+                // IOLog("start: Failed to start read %d\n", i);
+                goto fail;
+            }
         }
     }
 
@@ -218,6 +343,38 @@ void WirelessGamingReceiver::stop(IOService *provider)
     IOService::stop(provider);
 }
 
+// Free the driver
+void WirelessGamingReceiver::free(void)
+{
+    if (queueLock != NULL)
+    {
+        IOLockFree(queueLock);
+        queueLock = NULL;
+    }
+    IOService::free();
+}
+
+// Read the queue settings from our personality
+void WirelessGamingReceiver::ReadSettings(void)
+{
+    OSNumber *number;
+    OSString *string;
+
+    queueLength = WIRELESS_QUEUE_DEFAULT;
+    number = OSDynamicCast(OSNumber, getProperty(kQueueLengthKey));
+    if (number != NULL)
+        queueLength = number->unsigned32BitValue();
+    if (queueLength < 1)
+        queueLength = 1;
+    if (queueLength > WIRELESS_QUEUE_MAX)
+        queueLength = WIRELESS_QUEUE_MAX;
+
+    queueOverflow = woDropOldestInput;
+    string = OSDynamicCast(OSString, getProperty(kQueueOverflowKey));
+    if ((string != NULL) && string->isEqualTo("DropNewest"))
+        queueOverflow = woDropNewestInput;
+}
+
 // Handle termination
 bool WirelessGamingReceiver::didTerminate(IOService *provider, IOOptionBits options, bool *defer)
 {
@@ -245,34 +402,42 @@ IOReturn WirelessGamingReceiver::message(UInt32 type,IOService *provider,void *a
 #endif
 }
 
+// Allocate the read contexts for a controller, which are reused until the connection is released
+bool WirelessGamingReceiver::AllocateReads(int index)
+{
+    UInt32 size = GetMaxPacketSize(connections[index].controllerIn);
+
+    for (int i = 0; i < WIRELESS_READS; i++)
+    {
+        WGRREAD *read = &connections[index].reads[i];
+
+        read->index = index;
+        read->buffer = IOBufferMemoryDescriptor::inTaskWithOptions(kernel_task, kIODirectionIn, size);
+        if (read->buffer == NULL)
+            return false;
+        connections[index].readBuffersAllocated++;
+    }
+    return true;
+}
+
 // Queue a read on a controller
-bool WirelessGamingReceiver::QueueRead(int index)
+bool WirelessGamingReceiver::QueueRead(WGRREAD *read)
 {
     IOUSBCompletion complete;
     IOReturn err;
-    WGRREAD *data = (WGRREAD*)IOMalloc(sizeof(WGRREAD));
+    IOUSBPipe *pipe = connections[read->index].controllerIn;
 
-    if (data == NULL)
+    if ((pipe == NULL) || (read->buffer == NULL))
         return false;
-    data->index = index;
-    data->buffer = IOBufferMemoryDescriptor::inTaskWithOptions(kernel_task, kIODirectionIn, GetMaxPacketSize(connections[index].controllerIn));
-    if (data->buffer == NULL)
-    {
-        IOFree(data, sizeof(WGRREAD));
-        return false;
-    }
 
     complete.target = this;
     complete.action = _ReadComplete;
-    complete.parameter = data;
+    complete.parameter = read;
 
-    err = connections[index].controllerIn->Read(data->buffer, 0, 0, data->buffer->getLength(), &complete);
+    err = pipe->Read(read->buffer, 0, 0, read->buffer->getLength(), &complete);
     if (err == kIOReturnSuccess)
         return true;
 
-    data->buffer->release();
-    IOFree(data, sizeof(WGRREAD));
-
     // IOLog("read - failed to start (0x%.8x)\n", err);
     return false;
 }
@@ -280,77 +445,216 @@ bool WirelessGamingReceiver::QueueRead(int index)
 // Handle a completed read on a controller
 void WirelessGamingReceiver::ReadComplete(void *parameter, IOReturn status, UInt32 bufferSizeRemaining)
 {
-    WGRREAD *data = (WGRREAD*)parameter;
+    WGRREAD *read = (WGRREAD*)parameter;
+    WIRELESS_CONNECTION *connection = &connections[read->index];
     bool reread = true;
 
+    if (read->buffer == NULL)
+        return;
+
     switch (status)
     {
         case kIOReturnOverrun:
             // IOLog("read - kIOReturnOverrun, clearing stall\n");
-            connections[data->index].controllerIn->ClearStall();
+            if (connection->controllerIn != NULL)
+                connection->controllerIn->ClearStall();
             // fall through
         case kIOReturnSuccess:
-            ProcessMessage(data->index, (unsigned char*)data->buffer->getBytesNoCopy(), (int)data->buffer->getLength() - bufferSizeRemaining);
+            connection->packetsReceived++;
+            ProcessMessage(read->index, (unsigned char*)read->buffer->getBytesNoCopy(), (int)read->buffer->getLength() - bufferSizeRemaining);
             break;
 
         case kIOReturnNotResponding:
             // IOLog("read - kIOReturnNotResponding\n");
             // fall through
         default:
+            connection->readErrors++;
             reread = false;
             break;
     }
-
-    int newIndex = data->index;
-    data->buffer->release();
-    IOFree(data, sizeof(WGRREAD));
+    StatisticsChanged();
 
     if (reread)
-        QueueRead(newIndex);
+        QueueRead(read);
 }
 
-// Queue an asynchronous write on a controller
+// Queues a command for a controller, replacing any pending command it supersedes
 bool WirelessGamingReceiver::QueueWrite(int index, const void *bytes, UInt32 length)
 {
-    IOBufferMemoryDescriptor *outBuffer;
-    IOUSBCompletion complete;
-    IOReturn err;
+    WIRELESS_CONNECTION *connection = &connections[index];
+    bool queued = true;
+    bool replaced = false;
+    int i;
 
-    outBuffer = IOBufferMemoryDescriptor::inTaskWithOptions(kernel_task, kIODirectionOut, length);
-    if (outBuffer == NULL)
-    {
-        // IOLog("send - unable to allocate buffer\n");
+    if (length > WIRELESS_PACKET_SIZE)
         return false;
+
+    IOLockLock(queueLock);
+    for (i = 0; i < connection->outputCount; i++)
+    {
+        WIRELESS_PACKET *pending = &connection->output[(connection->outputHead + i) % WIRELESS_OUTPUT_MAX];
+
+        if (IsSameCommand(pending, (const unsigned char*)bytes, length))
+        {
+            memcpy(pending->data, bytes, length);
+            connection->writesCoalesced++;
+            replaced = true;
+            break;
+        }
+    }
+    if (i == connection->outputCount)
+    {
+        if (connection->outputCount == WIRELESS_OUTPUT_MAX)
+        {
+            connection->writesDropped++;
+            queued = false;
+        }
+        else
+        {
+            WIRELESS_PACKET *packet = &connection->output[(connection->outputHead + connection->outputCount) % WIRELESS_OUTPUT_MAX];
+
+            packet->length = length;
+            memcpy(packet->data, bytes, length);
+            connection->outputCount++;
+        }
     }
-    outBuffer->writeBytes(0, bytes, length);
+    IOLockUnlock(queueLock);
 
-    complete.target = this;
-    complete.action = _WriteComplete;
-    complete.parameter = outBuffer;
+    if (replaced || !queued)
+        StatisticsChanged();
+    if (queued)
+        PumpWrites();
+    return queued;
+}
 
-    err = connections[index].controllerOut->Write(outBuffer, 0, 0, length, &complete);
-    if (err == kIOReturnSuccess)
-        return true;
-    else
+// Allocate the write buffers shared by all the controllers
+bool WirelessGamingReceiver::AllocateWrites(void)
+{
+    writeNext = 0;
+    for (int i = 0; i < WIRELESS_WRITES; i++)
     {
-        // IOLog("send - failed to start (0x%.8x)\n",err);
-        return false;
+        writes[i].index = -1;
+        writes[i].busy = false;
+        writes[i].buffer = IOBufferMemoryDescriptor::inTaskWithOptions(kernel_task, kIODirectionOut, WIRELESS_PACKET_SIZE);
+        if (writes[i].buffer == NULL)
+            return false;
     }
+    return true;
 }
 
-// Handle a completed write on a controller
+// Start writes while there are free buffers, taking a command from each controller in turn
+void WirelessGamingReceiver::PumpWrites(void)
+{
+    IOUSBCompletion complete;
+    IOReturn err;
+
+    for (;;)
+    {
+        WGRWRITE *write = NULL;
+        IOUSBPipe *pipe = NULL;
+        UInt32 length = 0;
+        int index = -1;
+
+        IOLockLock(queueLock);
+        for (int i = 0; i < WIRELESS_WRITES; i++)
+        {
+            if ((writes[i].buffer != NULL) && !writes[i].busy)
+            {
+                write = &writes[i];
+                break;
+            }
+        }
+        for (int i = 0; (write != NULL) && (i < connectionCount); i++)
+        {
+            int j = (writeNext + i) % connectionCount;
+
+            if ((connections[j].outputCount > 0) && (connections[j].controllerOut != NULL))
+            {
+                index = j;
+                break;
+            }
+        }
+        if (index != -1)
+        {
+            WIRELESS_CONNECTION *connection = &connections[index];
+            WIRELESS_PACKET *packet = &connection->output[connection->outputHead];
+
+            length = packet->length;
+            memcpy(write->buffer->getBytesNoCopy(), packet->data, length);
+            connection->outputHead = (connection->outputHead + 1) % WIRELESS_OUTPUT_MAX;
+            connection->outputCount--;
+            write->index = index;
+            write->busy = true;
+            pipe = connection->controllerOut;
+            writeNext = (index + 1) % connectionCount;
+        }
+        IOLockUnlock(queueLock);
+        if (index == -1)
+            return;
+
+        complete.target = this;
+        complete.action = _WriteComplete;
+        complete.parameter = write;
+
+        err = pipe->Write(write->buffer, 0, 0, length, &complete);
+        if (err != kIOReturnSuccess)
+        {
+            // IOLog("send - failed to start (0x%.8x)\n",err);
+            IOLockLock(queueLock);
+            write->busy = false;
+            connections[index].writeErrors++;
+            IOLockUnlock(queueLock);
+            StatisticsChanged();
+            return;
+        }
+    }
+}
+
+// Handle a completed write on a controller, then reuse the buffer for the next command
 void WirelessGamingReceiver::WriteComplete(void *parameter,IOReturn status,UInt32 bufferSizeRemaining)
 {
-    IOMemoryDescriptor *memory=(IOMemoryDescriptor*)parameter;
-    if(status!=kIOReturnSuccess) {
-        IOLog("write - Error writing: 0x%.8x\n",status);
+    WGRWRITE *write = (WGRWRITE*)parameter;
+    bool counted = false;
+
+    IOLockLock(queueLock);
+    if (status != kIOReturnSuccess)
+    {
+        if (write->index != -1)
+        {
+            connections[write->index].writeErrors++;
+            counted = true;
+        }
+        if (status != kIOReturnAborted)
+            IOLog("write - Error writing: 0x%.8x\n",status);
     }
-    memory->release();
+    write->busy = false;
+    IOLockUnlock(queueLock);
+    if (counted)
+        StatisticsChanged();
+    if (status != kIOReturnAborted)
+        PumpWrites();
 }
 
 // Release any allocated objects
 void WirelessGamingReceiver::ReleaseAll(void)
 {
+    if (idleTimer != NULL)
+    {
+        idleTimer->cancelTimeout();
+        if (getWorkLoop() != NULL)
+            getWorkLoop()->removeEventSource(idleTimer);
+        idleTimer->release();
+        idleTimer = NULL;
+    }
+    idleArmed = false;
+    if (statisticsTimer != NULL)
+    {
+        statisticsTimer->cancelTimeout();
+        if (getWorkLoop() != NULL)
+            getWorkLoop()->removeEventSource(statisticsTimer);
+        statisticsTimer->release();
+        statisticsTimer = NULL;
+    }
     for (int i = 0; i < connectionCount; i++)
     {
         if (connections[i].service != NULL)
@@ -366,6 +670,18 @@ void WirelessGamingReceiver::ReleaseAll(void)
             connections[i].controllerIn->release();
             connections[i].controllerIn = NULL;
         }
+        for (int j = 0; j < WIRELESS_READS; j++)
+        {
+            if (connections[i].reads[j].buffer != NULL)
+            {
+                connections[i].reads[j].buffer->release();
+                connections[i].reads[j].buffer = NULL;
+            }
+        }
+        IOLockLock(queueLock);
+        connections[i].outputHead = 0;
+        connections[i].outputCount = 0;
+        IOLockUnlock(queueLock);
         if (connections[i].controllerOut != NULL)
         {
             connections[i].controllerOut->Abort();
@@ -394,18 +710,171 @@ void WirelessGamingReceiver::ReleaseAll(void)
             connections[i].other->close(this);
             connections[i].other = NULL;
         }
-        if (connections[i].inputArray != NULL)
+        connections[i].input.Reset();
+        connections[i].idleDeadline = 0;
+        connections[i].controllerStarted = false;
+    }
+    for (int i = 0; i < WIRELESS_WRITES; i++)
+    {
+        if (writes[i].buffer != NULL)
         {
-            connections[i].inputArray->release();
-            connections[i].inputArray = NULL;
+            writes[i].buffer->release();
+            writes[i].buffer = NULL;
         }
-        connections[i].controllerStarted = false;
+        writes[i].busy = false;
     }
     if (device != NULL)
     {
         device->close(this);
         device = NULL;
     }
+    UnregisterReceiver();
+}
+
+// Claim a place in the global slot registry, preferring the one last used from
+// our port, then one never used, then any that is free
+bool WirelessGamingReceiver::RegisterReceiver(void)
+{
+    UInt32 location = GetLocation();
+
+    if (receiverIndex != -1)
+        return true;
+    for (int pass = (location == 0) ? 1 : 0; pass < 3; pass++)
+    {
+        for (int i = 0; i < WIRELESS_RECEIVERS; i++)
+        {
+            if ((pass == 0) && (receivers[i].location != location))
+                continue;
+            if ((pass == 1) && (receivers[i].location != 0))
+                continue;
+            if (OSCompareAndSwapPtr(NULL, this, &receivers[i].receiver))
+            {
+                receivers[i].location = location;
+                receiverIndex = i;
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+// Give up our place in the global slot registry
+void WirelessGamingReceiver::UnregisterReceiver(void)
+{
+    if (receiverIndex == -1)
+        return;
+    OSCompareAndSwapPtr(this, NULL, &receivers[receiverIndex].receiver);
+    receiverIndex = -1;
+}
+
+// Get the global slot of one of our controllers, or -1 if we have no place in the registry
+int WirelessGamingReceiver::SlotForIndex(int index) const
+{
+    if ((receiverIndex == -1) || (index < 0) || (index >= WIRELESS_CONNECTIONS))
+        return -1;
+    return (receiverIndex * WIRELESS_CONNECTIONS) + index;
+}
+
+// Publish the per-connection counters
+void WirelessGamingReceiver::UpdateStatistics(void)
+{
+    OSArray *array = OSArray::withCapacity(WIRELESS_CONNECTIONS);
+
+    if (array == NULL)
+        return;
+    for (int i = 0; i < connectionCount; i++)
+    {
+        OSDictionary *dictionary = OSDictionary::withCapacity(15);
+        OSArray *gaps, *events;
+
+        if (dictionary == NULL)
+            continue;
+        SetStatistic(dictionary, "ReadBuffersAllocated", connections[i].readBuffersAllocated);
+        SetStatistic(dictionary, "PacketsReceived", connections[i].packetsReceived);
+        SetStatistic(dictionary, "ReadErrors", connections[i].readErrors);
+        SetStatistic(dictionary, "QueueLength", connections[i].input.Count());
+        SetStatistic(dictionary, "QueueHighWater", connections[i].input.highWater);
+        SetStatistic(dictionary, "InputDropped", connections[i].input.inputDropped);
+        SetStatistic(dictionary, "ControlDropped", connections[i].input.controlDropped);
+        SetStatistic(dictionary, "OutputQueueLength", connections[i].outputCount);
+        SetStatistic(dictionary, "WritesCoalesced", connections[i].writesCoalesced);
+        SetStatistic(dictionary, "WritesDropped", connections[i].writesDropped);
+        SetStatistic(dictionary, "WriteErrors", connections[i].writeErrors);
+        SetStatistic(dictionary, "InputRate", connections[i].inputRate);
+        SetStatistic(dictionary, "MaxInputGap", connections[i].maxGap);
+        gaps = OSArray::withCapacity(connections[i].gapCount);
+        if (gaps != NULL)
+        {
+            for (int j = 0; j < connections[i].gapCount; j++)
+            {
+                int k = (connections[i].gapHead - connections[i].gapCount + j + WIRELESS_GAP_HISTORY) % WIRELESS_GAP_HISTORY;
+                OSNumber *number = OSNumber::withNumber(connections[i].gaps[k], 32);
+
+                if (number != NULL)
+                {
+                    gaps->setObject(number);
+                    number->release();
+                }
+            }
+            dictionary->setObject("InputGaps", gaps);
+            gaps->release();
+        }
+        events = OSArray::withCapacity(connections[i].eventCount);
+        if (events != NULL)
+        {
+            for (int j = 0; j < connections[i].eventCount; j++)
+            {
+                int k = (connections[i].eventHead - connections[i].eventCount + j + WIRELESS_EVENT_HISTORY) % WIRELESS_EVENT_HISTORY;
+                OSDictionary *event = OSDictionary::withCapacity(2);
+
+                if (event != NULL)
+                {
+                    SetStatistic(event, "Time", connections[i].events[k].time);
+                    SetStatistic(event, "Status", connections[i].events[k].status);
+                    events->setObject(event);
+                    event->release();
+                }
+            }
+            dictionary->setObject("LinkEvents", events);
+            events->release();
+        }
+        array->setObject(dictionary);
+        dictionary->release();
+    }
+    setProperty(kIOWirelessStatistics, array);
+    array->release();
+}
+
+// Republish the counters a second after they start moving, so a single
+// property lookup sees figures that are at most that old
+void WirelessGamingReceiver::StatisticsTimeout(void)
+{
+    // Cleared first, so counters that move while publishing arm it again
+    statisticsArmed = 0;
+    UpdateStatistics();
+}
+
+// Counters have moved, so arm the statistics timer unless it already is.
+// Nothing is armed while the receiver is quiet.
+void WirelessGamingReceiver::StatisticsChanged(void)
+{
+    if ((statisticsTimer != NULL) && OSCompareAndSwap(0, 1, &statisticsArmed))
+        statisticsTimer->setTimeoutMS(WIRELESS_STATISTICS_INTERVAL);
+}
+
+void WirelessGamingReceiver::_StatisticsTimeout(OSObject *owner, IOTimerEventSource *sender)
+{
+    WirelessGamingReceiver *receiver = OSDynamicCast(WirelessGamingReceiver, owner);
+
+    if (receiver != NULL)
+        receiver->StatisticsTimeout();
+}
+
+// Refresh the counters only when someone looks at the registry, keeping the read path free of allocations
+bool WirelessGamingReceiver::serializeProperties(OSSerialize *s) const
+{
+    const_cast<WirelessGamingReceiver*>(this)->UpdateStatistics();
+    return IOService::serializeProperties(s);
 }
 
 // Static wrapper for read notifications
@@ -422,8 +891,119 @@ void WirelessGamingReceiver::_WriteComplete(void *target, void *parameter, IORet
         ((WirelessGamingReceiver*)target)->WriteComplete(parameter, status, bufferSizeRemaining);
 }
 
+// Push back a controller's idle deadline, only touching the timer if it isn't already running
+void WirelessGamingReceiver::ResetIdle(int index)
+{
+    bool arm;
+
+    if (idleTimer == NULL)
+        return;
+    IOLockLock(queueLock);
+    connections[index].idleDeadline = UptimeMilliseconds() + WIRELESS_IDLE_TIMEOUT;
+    arm = !idleArmed;
+    idleArmed = true;
+    IOLockUnlock(queueLock);
+    if (arm)
+        idleTimer->setTimeoutMS(WIRELESS_IDLE_TIMEOUT);
+}
+
+// Stop tracking a controller's idle deadline
+void WirelessGamingReceiver::ClearIdle(int index)
+{
+    IOLockLock(queueLock);
+    connections[index].idleDeadline = 0;
+    IOLockUnlock(queueLock);
+}
+
+// Turn off any controllers that have been idle too long, then sleep until the next deadline
+void WirelessGamingReceiver::IdleTimeout(void)
+{
+    static const unsigned char powerOff[] = {WIRELESS_POWEROFF};
+    bool expired[WIRELESS_CONNECTIONS];
+    UInt64 now = UptimeMilliseconds(), next = 0;
+
+    IOLockLock(queueLock);
+    for (int i = 0; i < connectionCount; i++)
+    {
+        UInt64 deadline = connections[i].idleDeadline;
+
+        expired[i] = (deadline != 0) && (deadline <= now);
+        if (expired[i])
+            connections[i].idleDeadline = 0;
+        else if ((deadline != 0) && ((next == 0) || (deadline < next)))
+            next = deadline;
+    }
+    idleArmed = (next != 0);
+    IOLockUnlock(queueLock);
+
+    for (int i = 0; i < connectionCount; i++)
+    {
+        if (expired[i])
+            QueueWrite(i, powerOff, sizeof(powerOff));
+    }
+    if ((next != 0) && (idleTimer != NULL))
+        idleTimer->setTimeoutMS((UInt32)(next - now));
+}
+
+// Static wrapper for the idle timer
+void WirelessGamingReceiver::_IdleTimeout(OSObject *owner, IOTimerEventSource *sender)
+{
+    WirelessGamingReceiver *receiver = OSDynamicCast(WirelessGamingReceiver, owner);
+
+    if (receiver != NULL)
+        receiver->IdleTimeout();
+}
+
+// Track the input report rate and the gaps between reports
+void WirelessGamingReceiver::RecordInput(int index)
+{
+    WIRELESS_CONNECTION *connection = &connections[index];
+    UInt64 now = UptimeMilliseconds();
+
+    if (connection->lastInputTime != 0)
+    {
+        UInt32 gap = (UInt32)(now - connection->lastInputTime);
+
+        connection->gaps[connection->gapHead] = gap;
+        connection->gapHead = (connection->gapHead + 1) % WIRELESS_GAP_HISTORY;
+        if (connection->gapCount < WIRELESS_GAP_HISTORY)
+            connection->gapCount++;
+        if (gap > connection->maxGap)
+            connection->maxGap = gap;
+    }
+    connection->lastInputTime = now;
+
+    if (connection->rateStart == 0)
+        connection->rateStart = now;
+    connection->rateCount++;
+    if ((now - connection->rateStart) >= WIRELESS_RATE_WINDOW)
+    {
+        connection->inputRate = (UInt32)((connection->rateCount * 1000ULL) / (now - connection->rateStart));
+        connection->rateStart = now;
+        connection->rateCount = 0;
+    }
+}
+
+// Remember a connection status change, restarting the input timing
+void WirelessGamingReceiver::RecordLinkEvent(int index, UInt8 status)
+{
+    WIRELESS_CONNECTION *connection = &connections[index];
+
+    connection->events[connection->eventHead].time = UptimeMilliseconds();
+    connection->events[connection->eventHead].status = status;
+    connection->eventHead = (connection->eventHead + 1) % WIRELESS_EVENT_HISTORY;
+    if (connection->eventCount < WIRELESS_EVENT_HISTORY)
+        connection->eventCount++;
+
+    // A gap across a reconnect says nothing about the link
+    connection->lastInputTime = 0;
+    connection->rateStart = 0;
+    connection->rateCount = 0;
+    connection->inputRate = 0;
+}
+
 // Processes a message for a controller
-void WirelessGamingReceiver::ProcessMessage(int index, const unsigned char *data, int length)
+void WirelessGamingReceiver::ProcessMessage(int index, unsigned char *data, int length)
 {
 #ifdef PROTOCOL_DEBUG
     char s[1024];
@@ -437,87 +1017,104 @@ void WirelessGamingReceiver::ProcessMessage(int index, const unsigned char *data
     s[i * 2] = '\0';
     IOLog("Got data (%d, %d bytes): %s\n", index, length, s);
 #endif
-    // Handle device connections
-    if ((length == 2) && (data[0] == 0x08))
+    if (WirelessIsInput(data, length))
+        RecordInput(index);
+    if (WirelessIsStatus(data, length))
+        RecordLinkEvent(index, data[1]);
+
+    // Status messages are handled by the receiver, anything else goes to the device
+    if (!WirelessDispatch(this, index, data, length))
+        return;
+    if (connections[index].service != NULL)
     {
-        if (data[1] == 0x00)
+        if (!connections[index].controllerStarted)
         {
-            // Device disconnected
+            if (WirelessIsInfo(data, length))
+            {
 #ifdef PROTOCOL_DEBUG
-            IOLog("process: Device detached\n");
+                IOLog("Registering wireless device");
 #endif
-            if (connections[index].service != NULL)
-            {
-                connections[index].service->SetIndex(-1);
-                if (connections[index].controllerStarted)
-                    connections[index].service->terminate(kIOServiceRequired | kIOServiceSynchronous);
-                connections[index].service->detach(this);
-                connections[index].service->release();
-                connections[index].service = NULL;
-                connections[index].controllerStarted = false;
+                connections[index].controllerStarted = true;
+                connections[index].service->registerService();
             }
         }
-        else
-        {
-            // Device connected
+    }
+}
+
+// Device disconnected
+void WirelessGamingReceiver::DeviceDetached(int index)
+{
 #ifdef PROTOCOL_DEBUG
-            IOLog("process: Attempting to add new device\n");
+    IOLog("process: Device detached\n");
 #endif
-            if (connections[index].service == NULL)
-            {
-                bool ready;
-                int i, j;
-                IOMemoryDescriptor *data;
-                char c;
-
-                ready = false;
-                j = connections[index].inputArray->getCount();
-                for (i = 0; !ready && (i < j); i++)
-                {
-                    data = OSDynamicCast(IOMemoryDescriptor, connections[index].inputArray->getObject(i));
-                    data->readBytes(1, &c, 1);
-                    if (c == 0x0f)
-                        ready = true;
-                }
-                InstantiateService(index);
-                if (ready && connections[index].service != NULL)
-                {
+    ClearIdle(index);
+    if (connections[index].service != NULL)
+    {
+        connections[index].service->SetIndex(-1);
+        if (connections[index].controllerStarted)
+            connections[index].service->terminate(kIOServiceRequired | kIOServiceSynchronous);
+        connections[index].service->detach(this);
+        connections[index].service->release();
+        connections[index].service = NULL;
+        connections[index].controllerStarted = false;
+    }
+}
+
+// Device connected
+void WirelessGamingReceiver::DeviceAttached(int index)
+{
 #ifdef PROTOCOL_DEBUG
-                    IOLog("Registering wireless device");
+    IOLog("process: Attempting to add new device\n");
 #endif
-                    connections[index].controllerStarted = true;
-                    connections[index].service->registerService();
-                }
-            }
+    if (connections[index].service == NULL)
+    {
+        bool ready = IsInfoQueued(index);
+
+        InstantiateService(index);
+        if (ready && connections[index].service != NULL)
+        {
+#ifdef PROTOCOL_DEBUG
+            IOLog("Registering wireless device");
+#endif
+            connections[index].controllerStarted = true;
+            connections[index].service->registerService();
         }
-        return;
     }
+}
+
+// Hand a message straight to the device, if there is one and it will take it
+bool WirelessGamingReceiver::DeliverMessage(int index, unsigned char *data, int length)
+{
+    return (connections[index].service != NULL) && connections[index].service->Deliver(data, length);
+}
 
-    // Add anything else to the queue
-    IOMemoryDescriptor *copy = IOBufferMemoryDescriptor::inTaskWithOptions(kernel_task, kIODirectionOut, length);
-    copy->writeBytes(0, data, length);
-    connections[index].inputArray->setObject(copy);
+// Queue a message the device could not take, and let the device know it is there
+void WirelessGamingReceiver::DeferMessage(int index, unsigned char *data, int length)
+{
+    QueueMessage(index, data, length);
     if (connections[index].service == NULL)
         InstantiateService(index);
     if (connections[index].service != NULL)
-    {
         connections[index].service->NewData();
-        if (!connections[index].controllerStarted)
-        {
-            char c;
+}
 
-            copy->readBytes(1, &c, 1);
-            if (c == 0x0f)
-            {
-#ifdef PROTOCOL_DEBUG
-                IOLog("Registering wireless device");
-#endif
-                connections[index].controllerStarted = true;
-                connections[index].service->registerService();
-            }
-        }
-    }
-    copy->release();
+// Add a message to a controller's queue, applying the overflow policy if it is full
+void WirelessGamingReceiver::QueueMessage(int index, const unsigned char *data, int length)
+{
+    IOLockLock(queueLock);
+    connections[index].input.Push(data, length, queueLength, queueOverflow);
+    IOLockUnlock(queueLock);
+}
+
+// Check if the controller's info message has been queued
+bool WirelessGamingReceiver::IsInfoQueued(int index)
+{
+    bool found;
+
+    IOLockLock(queueLock);
+    found = connections[index].input.IsInfoQueued();
+    IOLockUnlock(queueLock);
+    return found;
 }
 
 // Create a new node for the attached controller
@@ -526,14 +1123,24 @@ void WirelessGamingReceiver::InstantiateService(int index)
     connections[index].service = new WirelessDevice;
     if (connections[index].service != NULL)
     {
-        const OSString *keys[1] = {
+        const OSString *keys[2] = {
             OSString::withCString(kIOWirelessDeviceType),
+            OSString::withCString(kIOWirelessSlot),
         };
-        const OSObject *objects[1] = {
+        const OSObject *objects[2] = {
             OSNumber::withNumber((unsigned long long)0, 32),
+            OSNumber::withNumber((long long)SlotForIndex(index), 32),
         };
-        OSDictionary *dictionary = OSDictionary::withObjects(objects, keys, 1, 0);
-        if (connections[index].service->init(dictionary))
+        OSDictionary *dictionary = OSDictionary::withObjects(objects, keys, 2, 0);
+        for (int i = 0; i < 2; i++)
+        {
+            keys[i]->release();
+            objects[i]->release();
+        }
+        bool ready = connections[index].service->init(dictionary);
+        if (dictionary != NULL)
+            dictionary->release();
+        if (ready)
         {
             connections[index].service->attach(this);
             connections[index].service->SetIndex(index);
@@ -555,42 +1162,46 @@ void WirelessGamingReceiver::InstantiateService(int index)
 // Check a controller's queue
 bool WirelessGamingReceiver::IsDataQueued(int index)
 {
-    return connections[index].inputArray->getCount() > 0;
+    return connections[index].input.Count() > 0;
 }
 
-// Read a controller's queue
-IOMemoryDescriptor* WirelessGamingReceiver::ReadBuffer(int index)
+// Read a controller's queue, returning the length copied or 0 if it is empty
+size_t WirelessGamingReceiver::ReadPacket(int index, void *buffer, size_t length)
 {
-    IOMemoryDescriptor *data;
+    int copied;
 
-    data = OSDynamicCast(IOMemoryDescriptor, connections[index].inputArray->getObject(0));
-    if (data != NULL)
-        data->retain();
-    connections[index].inputArray->removeObject(0);
-    return data;
+    IOLockLock(queueLock);
+    copied = connections[index].input.Pop(buffer, (int)length);
+    IOLockUnlock(queueLock);
+    return copied;
+}
+
+// Get the USB location of the receiver, or 0 if it has none
+UInt32 WirelessGamingReceiver::GetLocation(void) const
+{
+    OSNumber *number;
+
+    if (device == NULL)
+        return 0;
+    if ((number = OSDynamicCast(OSNumber, device->getProperty("locationID"))))
+        return number->unsigned32BitValue();
+    return device->GetLocationID();
 }
 
 // Get our location ID
 OSNumber* WirelessGamingReceiver::newLocationIDNumber() const
 {
     OSNumber *number;
-    UInt32    location = 0;
+    UInt32    location = GetLocation();
 
-    if (device)
+    if ((location == 0) && device)
     {
-        if ((number = OSDynamicCast(OSNumber, device->getProperty("locationID"))))
-        {
-            location = number->unsigned32BitValue();
-        }
-        else
-        {
-            // Make up an address
-            if ((number = OSDynamicCast(OSNumber, device->getProperty("USB Address"))))
-                location |= number->unsigned8BitValue() << 24;
+        // Make up an address
+        if ((number = OSDynamicCast(OSNumber, device->getProperty("USB Address"))))
+            location |= number->unsigned8BitValue() << 24;
 
-            if ((number = OSDynamicCast(OSNumber, device->getProperty("idProduct"))))
-                location |= number->unsigned8BitValue() << 16;
-        }
+        if ((number = OSDynamicCast(OSNumber, device->getProperty("idProduct"))))
+            location |= number->unsigned8BitValue() << 16;
     }
 
     return OSNumber::withNumber(location, 32);
@@ -25,11 +25,56 @@
 
 #include <IOKit/usb/IOUSBDevice.h>
 #include <IOKit/usb/IOUSBInterface.h>
+#include <IOKit/IOBufferMemoryDescriptor.h>
+#include <IOKit/IOLocks.h>
+#include <IOKit/IOTimerEventSource.h>
+#include "WirelessDevice.h"
+#include "WirelessQueue.h"
 
 // This value is defined by the hardware and fixed
 #define WIRELESS_CONNECTIONS        4
 
-class WirelessDevice;
+// Receivers tracked in the global slot registry, giving 16 controllers in total
+#define WIRELESS_RECEIVERS          4
+#define WIRELESS_SLOTS              (WIRELESS_RECEIVERS * WIRELESS_CONNECTIONS)
+
+// Number of reads kept outstanding on each controller pipe
+#define WIRELESS_READS              2
+
+// Write buffers shared by all the controllers, and the commands each may have waiting for one
+#define WIRELESS_WRITES             8
+#define WIRELESS_OUTPUT_MAX         8
+
+// Link telemetry kept per connection
+#define WIRELESS_GAP_HISTORY        32
+#define WIRELESS_EVENT_HISTORY      16
+#define WIRELESS_RATE_WINDOW        1000    // ms
+#define WIRELESS_STATISTICS_INTERVAL 1000   // ms from a counter moving to the published figures catching up
+
+// Controllers are turned off after this long without an input report
+#define WIRELESS_IDLE_TIMEOUT       (15 * 60 * 1000)    // ms
+
+// A write buffer from the shared pool
+typedef struct WGRWRITE
+{
+    int index;
+    bool busy;
+    IOBufferMemoryDescriptor *buffer;
+} WGRWRITE;
+
+// A connection status change, as reported by the 0x08 messages
+typedef struct WIRELESS_LINK_EVENT
+{
+    UInt64 time;            // ms of uptime
+    UInt8 status;           // 0x00 for disconnected
+} WIRELESS_LINK_EVENT;
+
+// Holds data for asynchronous reads, reused for the life of the connection
+typedef struct WGRREAD
+{
+    int index;
+    IOBufferMemoryDescriptor *buffer;
+} WGRREAD;
 
 typedef struct WIRELESS_CONNECTION
 {
@@ -42,9 +87,36 @@ typedef struct WIRELESS_CONNECTION
     IOUSBPipe *otherIn, *otherOut;
 
     // Runtime data
-    OSArray *inputArray;
     WirelessDevice *service;
     bool controllerStarted;
+    WGRREAD reads[WIRELESS_READS];
+
+    // Input queue, guarded by queueLock
+    WirelessQueue input;
+
+    // Output queue, commands waiting for a write buffer
+    WIRELESS_PACKET output[WIRELESS_OUTPUT_MAX];
+    int outputHead, outputCount;
+
+    // Statistics
+    UInt32 readBuffersAllocated;
+    UInt64 packetsReceived;
+    UInt32 readErrors;
+    UInt32 writesCoalesced;
+    UInt32 writesDropped;
+    UInt32 writeErrors;
+
+    // Telemetry, the histories are rings of Count entries ending before Head
+    UInt64 lastInputTime, rateStart;
+    UInt32 rateCount, inputRate;
+    UInt32 gaps[WIRELESS_GAP_HISTORY];
+    int gapHead, gapCount;
+    UInt32 maxGap;
+    WIRELESS_LINK_EVENT events[WIRELESS_EVENT_HISTORY];
+    int eventHead, eventCount;
+
+    // Uptime in ms at which the controller is turned off, or 0 for never
+    UInt64 idleDeadline;
 }
 WIRELESS_CONNECTION;
 
@@ -54,34 +126,85 @@ class WirelessGamingReceiver : public IOService
 public:
     bool start(IOService *provider);
     void stop(IOService *provider);
+    void free(void);
 
     IOReturn message(UInt32 type,IOService *provider,void *argument);
 
+    bool serializeProperties(OSSerialize *s) const;
+
     // For WirelessDevice to use
     OSNumber* newLocationIDNumber() const;
+    int SlotForIndex(int index) const;
 
 private:
     friend class WirelessDevice;
     bool IsDataQueued(int index);
-    IOMemoryDescriptor* ReadBuffer(int index);
+    size_t ReadPacket(int index, void *buffer, size_t length);
     bool QueueWrite(int index, const void *bytes, UInt32 length);
+    void ResetIdle(int index);
+    void ClearIdle(int index);
 
 private:
     IOUSBDevice *device;
     WIRELESS_CONNECTION connections[WIRELESS_CONNECTIONS];
     int connectionCount;
+    int receiverIndex;
+
+    bool RegisterReceiver(void);
+    void UnregisterReceiver(void);
+    UInt32 GetLocation(void) const;
+
+    IOLock *queueLock;
+    int queueLength;
+    WIRELESS_OVERFLOW queueOverflow;
+
+    void ReadSettings(void);
+
+    // One timer for every controller's idle deadline, armed only while one is pending
+    IOTimerEventSource *idleTimer;
+    bool idleArmed;
+    void IdleTimeout(void);
+    static void _IdleTimeout(OSObject *owner, IOTimerEventSource *sender);
 
     void InstantiateService(int index);
 
-    void ProcessMessage(int index, const unsigned char *data, int length);
+    void ProcessMessage(int index, unsigned char *data, int length);
 
-    bool QueueRead(int index);
+    // Called back by WirelessDispatch
+    template<class Receiver> friend bool WirelessDispatch(Receiver *receiver, int index, unsigned char *data, int length);
+    void DeviceDetached(int index);
+    void DeviceAttached(int index);
+    bool DeliverMessage(int index, unsigned char *data, int length);
+    void DeferMessage(int index, unsigned char *data, int length);
+
+    void RecordInput(int index);
+    void RecordLinkEvent(int index, UInt8 status);
+
+    void QueueMessage(int index, const unsigned char *data, int length);
+    bool IsInfoQueued(int index);
+
+    WGRWRITE writes[WIRELESS_WRITES];
+    int writeNext;
+    bool AllocateWrites(void);
+    void PumpWrites(void);
+
+    bool AllocateReads(int index);
+    bool QueueRead(WGRREAD *read);
     void ReadComplete(void *parameter, IOReturn status, UInt32 bufferSizeRemaining);
 
     void WriteComplete(void *parameter, IOReturn status, UInt32 bufferSizeRemaining);
 
     void ReleaseAll(void);
 
+    // Keeps the published statistics fresh for readers that fetch just that
+    // property, armed only while the counters are moving
+    IOTimerEventSource *statisticsTimer;
+    volatile UInt32 statisticsArmed;
+    void UpdateStatistics(void);
+    void StatisticsChanged(void);
+    void StatisticsTimeout(void);
+    static void _StatisticsTimeout(OSObject *owner, IOTimerEventSource *sender);
+
     bool didTerminate(IOService *provider, IOOptionBits options, bool *defer);
 
     static void _ReadComplete(void *target, void *parameter, IOReturn status, UInt32 bufferSizeRemaining);
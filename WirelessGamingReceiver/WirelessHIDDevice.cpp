@@ -21,39 +21,34 @@
     Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
 */
 #include <IOKit/IOLib.h>
-#include <IOKit/IOTimerEventSource.h>
+#include <kern/clock.h>
 #include "WirelessHIDDevice.h"
+#include "WirelessChatPad.h"
 #include "WirelessDevice.h"
 #include "devices.h"
-
-#define POWEROFF_TIMEOUT (15 * 60)
+#include "protocol.h"
+#include "WirelessDispatch.h"
 
 OSDefineMetaClassAndAbstractStructors(WirelessHIDDevice, IOHIDDevice)
 #define super IOHIDDevice
 
+// Personality setting for where ChatPad messages carry the key report
+#define kChatPadDataOffsetKey   "ChatPadDataOffset"
+
 // Some sort of message to send
 const char weirdStart[] = {0x00, 0x00, 0x00, 0x40, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00};
 
-void WirelessHIDDevice::ChatPadTimerActionWrapper(OSObject *owner, IOTimerEventSource *sender)
-{
-	WirelessHIDDevice *device = OSDynamicCast(WirelessHIDDevice, owner);
-
-    // Automatic shutoff
-    device->serialTimerCount++;
-    if (device->serialTimerCount > POWEROFF_TIMEOUT)
-        device->PowerOff();
-    // Reset
-    sender->setTimeoutMS(1000);
-}
-
-// Sets the LED with the same format as the wired controller
+// Sets the LED with the same format as the wired controller, skipping it if nothing would change
 void WirelessHIDDevice::SetLEDs(int mode)
 {
     unsigned char buf[] = {0x00, 0x00, 0x08, (unsigned char)(0x40 + (mode % 0x0e)), 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00};
     WirelessDevice *device = OSDynamicCast(WirelessDevice, getProvider());
 
+    if ((mode % 0x0e) == ledMode)
+        return;
     if (device != NULL)
     {
+        ledMode = mode % 0x0e;
         device->SendPacket(buf, sizeof(buf));
         device->SendPacket(weirdStart, sizeof(weirdStart));
     }
@@ -67,7 +62,7 @@ unsigned char WirelessHIDDevice::GetBatteryLevel(void)
 
 void WirelessHIDDevice::PowerOff(void)
 {
-    static const unsigned char buf[] = {0x00, 0x00, 0x08, 0xC0, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00};
+    static const unsigned char buf[] = {WIRELESS_POWEROFF};
     WirelessDevice *device = OSDynamicCast(WirelessDevice, getProvider());
 
     if (device != NULL)
@@ -104,7 +99,6 @@ IOReturn WirelessHIDDevice::setReport(IOMemoryDescriptor *report, IOHIDReportTyp
 bool WirelessHIDDevice::handleStart(IOService *provider)
 {
     WirelessDevice *device;
-    IOWorkLoop *workloop;
 
     if (!super::handleStart(provider))
         goto fail;
@@ -113,26 +107,70 @@ bool WirelessHIDDevice::handleStart(IOService *provider)
     if (device == NULL)
         goto fail;
 
-    serialTimerCount = 0;
+    ledMode = -1;
+    batteryHead = 0;
+    batteryCount = 0;
+    batteryPublished = -1;
+    batteryPublishTime = 0;
+    batteryUpdates = 0;
+    batterySuppressed = 0;
+    batteryDeadline = 0;
+
+    batteryTimer = IOTimerEventSource::timerEventSource(this, _BatteryTimeout);
+    if (batteryTimer == NULL)
+    {
+        IOLog("start - failed to create battery timer\n");
+        goto fail;
+    }
+    if ((getWorkLoop() == NULL) || (getWorkLoop()->addEventSource(batteryTimer) != kIOReturnSuccess))
+    {
+        IOLog("start - failed to connect battery timer\n");
+        batteryTimer->release();
+        batteryTimer = NULL;
+        goto fail;
+    }
+
+    reportDescriptor = IOMemoryDescriptor::withAddress(packetBuffer, sizeof(packetBuffer), kIODirectionOut);
+    if (reportDescriptor == NULL)
+    {
+        IOLog("start - failed to allocate report descriptor\n");
+        goto fail;
+    }
+    chatPad = NULL;
+    chatPadBuffer = NULL;
+    chatPadOffset = WIRELESS_CHATPAD_DATA;
+    {
+        OSNumber *number = OSDynamicCast(OSNumber, getProperty(kChatPadDataOffsetKey));
+        if ((number != NULL) && (number->unsigned32BitValue() > WIRELESS_MSG_TYPE)
+            && (number->unsigned32BitValue() <= WIRELESS_MSG_LENGTH - WIRELESS_CHATPAD_LENGTH))
+            chatPadOffset = number->unsigned32BitValue();
+    }
 
-	serialTimer = IOTimerEventSource::timerEventSource(this, ChatPadTimerActionWrapper);
-	if (serialTimer == NULL)
-	{
-		IOLog("start - failed to create timer for chatpad\n");
-		goto fail;
-	}
-    workloop = getWorkLoop();
-	if ((workloop == NULL) || (workloop->addEventSource(serialTimer) != kIOReturnSuccess))
-	{
-		IOLog("start - failed to connect timer for chatpad\n");
-		goto fail;
-	}
+    // Armed by ChatPadConnect
+    chatPadToggle = false;
+    chatPadTimer = IOTimerEventSource::timerEventSource(this, _ChatPadKeepAlive);
+    if (chatPadTimer == NULL)
+    {
+        IOLog("start - failed to create ChatPad timer\n");
+        goto fail;
+    }
+    if ((getWorkLoop() == NULL) || (getWorkLoop()->addEventSource(chatPadTimer) != kIOReturnSuccess))
+    {
+        IOLog("start - failed to connect ChatPad timer\n");
+        chatPadTimer->release();
+        chatPadTimer = NULL;
+        goto fail;
+    }
 
-    device->RegisterWatcher(this, _receivedData, NULL);
+    device->RegisterWatcher(this, _receivedData, NULL, _receivedMessage);
 
     device->SendPacket(weirdStart, sizeof(weirdStart));
 
-    serialTimer->setTimeoutMS(1000);
+    // One wake-up for a ChatPad that may be attached, the keep-alives only
+    // start once one has reported
+    ChatPadCommand(WIRELESS_CHATPAD_INIT);
+
+    device->ResetIdle();
 
     return true;
 
@@ -148,13 +186,34 @@ void WirelessHIDDevice::handleStop(IOService *provider)
     if (device != NULL)
         device->RegisterWatcher(NULL, NULL, NULL);
 
-    if (serialTimer != NULL) {
-        serialTimer->cancelTimeout();
-        IOWorkLoop *workloop = getWorkLoop();
-        if (workloop != NULL)
-            workloop->removeEventSource(serialTimer);
-        serialTimer->release();
-        serialTimer = NULL;
+    if (chatPadTimer != NULL)
+    {
+        chatPadTimer->cancelTimeout();
+        if (getWorkLoop() != NULL)
+            getWorkLoop()->removeEventSource(chatPadTimer);
+        chatPadTimer->release();
+        chatPadTimer = NULL;
+    }
+    ChatPadDisconnect();
+    if (chatPadBuffer != NULL)
+    {
+        chatPadBuffer->release();
+        chatPadBuffer = NULL;
+    }
+
+    if (batteryTimer != NULL)
+    {
+        batteryTimer->cancelTimeout();
+        if (getWorkLoop() != NULL)
+            getWorkLoop()->removeEventSource(batteryTimer);
+        batteryTimer->release();
+        batteryTimer = NULL;
+    }
+
+    if (reportDescriptor != NULL)
+    {
+        reportDescriptor->release();
+        reportDescriptor = NULL;
     }
 
     super::handleStop(provider);
@@ -163,59 +222,46 @@ void WirelessHIDDevice::handleStop(IOService *provider)
 // Handle new data from the device
 void WirelessHIDDevice::receivedData(void)
 {
-    IOMemoryDescriptor *data;
+    size_t length;
     WirelessDevice *device = OSDynamicCast(WirelessDevice, getProvider());
     if (device == NULL)
         return;
 
-    while ((data = device->NextPacket()) != NULL)
-    {
-        receivedMessage(data);
-        data->release();
-    }
+    while ((length = device->NextPacket(packetBuffer, sizeof(packetBuffer))) != 0)
+        receivedMessage(packetBuffer, length);
 }
 
 const char *HexData = "0123456789ABCDEF";
 
-// Process new data
-void WirelessHIDDevice::receivedMessage(IOMemoryDescriptor *data)
+// Current uptime in milliseconds
+static UInt64 UptimeMilliseconds(void)
 {
-    unsigned char buf[29];
-
-    if (data->getLength() != 29)
-        return;
-
-    data->readBytes(0, buf, 29);
+    UInt64 now, ns;
 
-    switch (buf[1])
-    {
-        case 0x0f:  // Initial info
-            if (buf[16] == 0x13)
-                receivedUpdate(0x13, buf + 17);
-            serialString[0] = HexData[(buf[0x0A] & 0xF0) >> 4];
-            serialString[1] = HexData[buf[0x0A] & 0x0F];
-            serialString[2] = HexData[(buf[0x0B] & 0xF0) >> 4];
-            serialString[3] = HexData[buf[0x0B] & 0x0F];
-            serialString[4] = HexData[(buf[0x0C] & 0xF0) >> 4];
-            serialString[5] = HexData[buf[0x0C] & 0x0F];
-            serialString[6] = HexData[(buf[0x0D] & 0xF0) >> 4];
-            serialString[7] = HexData[buf[0x0D] & 0x0F];
-            serialString[8] = '\0';
-            IOLog("Got serial number: %s", serialString);
-            break;
-
-        case 0x01:  // HID info update
-            if (buf[3] == 0xf0)
-                receivedHIDupdate(buf + 4, buf[5]);
-            break;
+    clock_get_uptime(&now);
+    absolutetime_to_nanoseconds(now, &ns);
+    return ns / 1000000;
+}
 
-        case 0x00:  // Info update
-            receivedUpdate(buf[3], buf + 4);
-            break;
+// Process new data, which may be translated in place
+void WirelessHIDDevice::receivedMessage(unsigned char *buf, size_t length)
+{
+    WirelessDecode(this, buf, (int)length, chatPadOffset);
+}
 
-        default:
-            break;
-    }
+// Received the serial number from the controller's info message
+void WirelessHIDDevice::receivedSerial(const unsigned char *serial)
+{
+    serialString[0] = HexData[(serial[0] & 0xF0) >> 4];
+    serialString[1] = HexData[serial[0] & 0x0F];
+    serialString[2] = HexData[(serial[1] & 0xF0) >> 4];
+    serialString[3] = HexData[serial[1] & 0x0F];
+    serialString[4] = HexData[(serial[2] & 0xF0) >> 4];
+    serialString[5] = HexData[serial[2] & 0x0F];
+    serialString[6] = HexData[(serial[3] & 0xF0) >> 4];
+    serialString[7] = HexData[serial[3] & 0x0F];
+    serialString[8] = '\0';
+    IOLog("Got serial number: %s", serialString);
 }
 
 // Received an update of a specific value
@@ -223,15 +269,18 @@ void WirelessHIDDevice::receivedUpdate(unsigned char type, unsigned char *data)
 {
     switch (type)
     {
-        case 0x13:  // Battery level
+        case WIRELESS_UPDATE_BATTERY:   // Battery level
             battery = data[0];
             {
-                OSObject *prop = OSNumber::withNumber(battery, 8);
-                if (prop != NULL)
-                {
-                    setProperty(kIOWirelessBatteryLevel, prop);
-                    prop->release();
-                }
+                UInt64 now = UptimeMilliseconds();
+
+                batteryHistory[batteryHead].time = now;
+                batteryHistory[batteryHead].level = battery;
+                batteryHead = (batteryHead + 1) % WIRELESS_BATTERY_HISTORY;
+                if (batteryCount < WIRELESS_BATTERY_HISTORY)
+                    batteryCount++;
+                PublishBattery(now);
+                ArmBatteryTimer(now, now + WIRELESS_BATTERY_DELAY);
             }
             break;
 
@@ -240,26 +289,235 @@ void WirelessHIDDevice::receivedUpdate(unsigned char type, unsigned char *data)
     }
 }
 
+// Count a new battery reading, and publish it unless it has to wait
+void WirelessHIDDevice::PublishBattery(UInt64 now)
+{
+    batteryUpdates++;
+    if (!PublishBatteryLevel(now))
+        batterySuppressed++;
+}
+
+// Update the battery level property, skipping readings that would only make observers flap.
+// A real change that comes too soon is left for the battery timer, which publishes the
+// latest reading once the interval is up
+bool WirelessHIDDevice::PublishBatteryLevel(UInt64 now)
+{
+    int change;
+
+    if (batteryPublished >= 0)
+    {
+        change = battery - batteryPublished;
+        if (change < 0)
+            change = -change;
+        if (change < WIRELESS_BATTERY_HYSTERESIS)
+            return false;
+        if ((now - batteryPublishTime) < WIRELESS_BATTERY_INTERVAL)
+        {
+            ArmBatteryTimer(now, batteryPublishTime + WIRELESS_BATTERY_INTERVAL);
+            return false;
+        }
+    }
+
+    OSObject *prop = OSNumber::withNumber(battery, 8);
+    if (prop == NULL)
+        return false;
+    setProperty(kIOWirelessBatteryLevel, prop);
+    prop->release();
+    batteryPublished = battery;
+    batteryPublishTime = now;
+    return true;
+}
+
+// Publish the battery readings, oldest first
+void WirelessHIDDevice::UpdateBatteryHistory(void)
+{
+    OSArray *array = OSArray::withCapacity(batteryCount);
+
+    if (array == NULL)
+        return;
+    for (int i = 0; i < batteryCount; i++)
+    {
+        int j = (batteryHead - batteryCount + i + WIRELESS_BATTERY_HISTORY) % WIRELESS_BATTERY_HISTORY;
+        OSDictionary *sample = OSDictionary::withCapacity(2);
+        OSNumber *time = OSNumber::withNumber(batteryHistory[j].time, 64);
+        OSNumber *level = OSNumber::withNumber(batteryHistory[j].level, 8);
+
+        if ((sample != NULL) && (time != NULL) && (level != NULL))
+        {
+            sample->setObject("Time", time);
+            sample->setObject("Level", level);
+            array->setObject(sample);
+        }
+        if (sample != NULL) sample->release();
+        if (time != NULL) time->release();
+        if (level != NULL) level->release();
+    }
+    setProperty(kIOWirelessBatteryHistory, array);
+    array->release();
+
+    OSNumber *number = OSNumber::withNumber(batteryUpdates, 32);
+    if (number != NULL)
+    {
+        setProperty(kIOWirelessBatteryUpdates, number);
+        number->release();
+    }
+    number = OSNumber::withNumber(batterySuppressed, 32);
+    if (number != NULL)
+    {
+        setProperty(kIOWirelessBatterySuppressed, number);
+        number->release();
+    }
+}
+
+// Make sure the battery timer fires by the deadline
+void WirelessHIDDevice::ArmBatteryTimer(UInt64 now, UInt64 deadline)
+{
+    if (batteryTimer == NULL)
+        return;
+    if ((batteryDeadline != 0) && (batteryDeadline <= deadline))
+        return;
+    batteryDeadline = deadline;
+    batteryTimer->setTimeoutMS((UInt32)(deadline - now));
+}
+
+// Publish what the receive path has recorded since the last time
+void WirelessHIDDevice::BatteryTimeout(void)
+{
+    batteryDeadline = 0;
+    PublishBatteryLevel(UptimeMilliseconds());
+    UpdateBatteryHistory();
+}
+
+void WirelessHIDDevice::_BatteryTimeout(OSObject *owner, IOTimerEventSource *sender)
+{
+    WirelessHIDDevice *device = OSDynamicCast(WirelessHIDDevice, owner);
+
+    if (device != NULL)
+        device->BatteryTimeout();
+}
+
+// Also build the history and counters when someone reads the whole registry entry
+bool WirelessHIDDevice::serializeProperties(OSSerialize *s) const
+{
+    const_cast<WirelessHIDDevice*>(this)->UpdateBatteryHistory();
+    return super::serializeProperties(s);
+}
+
 // Received a normal HID update from the device
 void WirelessHIDDevice::receivedHIDupdate(unsigned char *data, int length)
 {
     IOReturn err;
-    IOMemoryDescriptor *report;
+    WirelessDevice *device = OSDynamicCast(WirelessDevice, getProvider());
 
-    serialTimerCount = 0;
-    report = IOMemoryDescriptor::withAddress(data, length, kIODirectionNone);
-    err = handleReport(report);
-    report->release();
+    if (device != NULL)
+        device->ResetIdle();
+    if (reportDescriptor == NULL)
+        return;
+    // The report stays in the packet it arrived in, either our own buffer or the receiver's read buffer
+    IOVirtualRange range = {(IOVirtualAddress)data, (IOByteCount)length};
+    if (!reportDescriptor->initWithOptions(&range, 1, 0, kernel_task, kIOMemoryTypeVirtual | kIODirectionOut, NULL))
+        return;
+    err = handleReport(reportDescriptor);
     if (err != kIOReturnSuccess)
         IOLog("handleReport return: 0x%.8x\n", err);
 }
 
+// Received a key report from an attached ChatPad
+void WirelessHIDDevice::receivedChatPad(unsigned char *data, int length)
+{
+    if (data[0] != 0x00)
+        return;
+    if (chatPad == NULL)
+        ChatPadConnect();
+    if ((chatPad == NULL) || (chatPadBuffer == NULL) || (length > (int)chatPadBuffer->getCapacity()))
+        return;
+    memcpy(chatPadBuffer->getBytesNoCopy(), data, length);
+    chatPadBuffer->setLength(length);
+    chatPad->handleReport(chatPadBuffer, kIOHIDReportTypeInput);
+}
+
+// Create the keyboard for an attached ChatPad
+void WirelessHIDDevice::ChatPadConnect(void)
+{
+    if (chatPadBuffer == NULL)
+    {
+        chatPadBuffer = IOBufferMemoryDescriptor::inTaskWithOptions(kernel_task, kIODirectionNone, WIRELESS_CHATPAD_LENGTH);
+        if (chatPadBuffer == NULL)
+            return;
+    }
+    chatPad = new WirelessChatPad;
+    if (chatPad == NULL)
+        return;
+    if (!chatPad->init(NULL) || !chatPad->attach(this))
+    {
+        chatPad->release();
+        chatPad = NULL;
+        return;
+    }
+    if (!chatPad->start(this))
+    {
+        chatPad->detach(this);
+        chatPad->release();
+        chatPad = NULL;
+        return;
+    }
+    chatPadToggle = false;
+    if (chatPadTimer != NULL)
+        chatPadTimer->setTimeoutMS(WIRELESS_CHATPAD_INTERVAL);
+}
+
+// Send a ChatPad control command through the controller
+void WirelessHIDDevice::ChatPadCommand(unsigned char command)
+{
+    const unsigned char buf[] = {WIRELESS_CHATPAD(command)};
+    WirelessDevice *device = OSDynamicCast(WirelessDevice, getProvider());
+
+    if (device != NULL)
+        device->SendPacket(buf, sizeof(buf));
+}
+
+// Alternate the keep-alive commands, like the wired driver's toggle state
+void WirelessHIDDevice::ChatPadKeepAlive(void)
+{
+    chatPadToggle = !chatPadToggle;
+    ChatPadCommand(chatPadToggle ? WIRELESS_CHATPAD_KEEPALIVE1 : WIRELESS_CHATPAD_KEEPALIVE2);
+    if (chatPadTimer != NULL)
+        chatPadTimer->setTimeoutMS(WIRELESS_CHATPAD_INTERVAL);
+}
+
+void WirelessHIDDevice::_ChatPadKeepAlive(OSObject *owner, IOTimerEventSource *sender)
+{
+    WirelessHIDDevice *device = OSDynamicCast(WirelessHIDDevice, owner);
+
+    if (device != NULL)
+        device->ChatPadKeepAlive();
+}
+
+// Remove the ChatPad keyboard, if there is one
+void WirelessHIDDevice::ChatPadDisconnect(void)
+{
+    if (chatPadTimer != NULL)
+        chatPadTimer->cancelTimeout();
+    if (chatPad != NULL)
+    {
+        chatPad->terminate(kIOServiceRequired | kIOServiceSynchronous);
+        chatPad->release();
+        chatPad = NULL;
+    }
+}
+
 // Wrapper for notification of receiving data
 void WirelessHIDDevice::_receivedData(void *target, WirelessDevice *sender, void *parameter)
 {
     ((WirelessHIDDevice*)target)->receivedData();
 }
 
+// Wrapper for packets delivered without being queued
+void WirelessHIDDevice::_receivedMessage(void *target, WirelessDevice *sender, unsigned char *data, size_t length)
+{
+    ((WirelessHIDDevice*)target)->receivedMessage(data, length);
+}
+
 // Get a location ID for this device, as some games require it
 OSNumber* WirelessHIDDevice::newLocationIDNumber() const
 {
@@ -24,8 +24,27 @@
 #define __WIRELESSHIDDEVICE_H__
 
 #include <IOKit/hid/IOHIDDevice.h>
+#include <IOKit/IOBufferMemoryDescriptor.h>
+#include <IOKit/IOTimerEventSource.h>
+#include "WirelessDevice.h"
 
-class WirelessDevice;
+class WirelessChatPad;
+
+// Battery readings kept for the registry
+#define WIRELESS_BATTERY_HISTORY    16
+
+// The battery level property only changes by at least this much, and no more often than this
+#define WIRELESS_BATTERY_HYSTERESIS 4
+#define WIRELESS_BATTERY_INTERVAL   5000    // ms
+
+// The history is republished this long after a new reading
+#define WIRELESS_BATTERY_DELAY      1000    // ms
+
+typedef struct WIRELESS_BATTERY_SAMPLE
+{
+    UInt64 time;            // ms of uptime
+    UInt8 level;
+} WIRELESS_BATTERY_SAMPLE;
 
 class WirelessHIDDevice : public IOHIDDevice
 {
@@ -39,21 +58,60 @@ public:
 
     OSNumber* newLocationIDNumber() const;
     OSString* newSerialNumberString() const;
+
+    bool serializeProperties(OSSerialize *s) const;
 protected:
     bool handleStart(IOService *provider);
     void handleStop(IOService *provider);
     virtual void receivedData(void);
-    virtual void receivedMessage(IOMemoryDescriptor *data);
+    virtual void receivedMessage(unsigned char *data, size_t length);
     virtual void receivedUpdate(unsigned char type, unsigned char *data);
     virtual void receivedHIDupdate(unsigned char *data, int length);
+    virtual void receivedChatPad(unsigned char *data, int length);
 private:
+    template<class Device> friend bool WirelessDecode(Device *device, unsigned char *buf, int length, int chatPadOffset);
+    void receivedSerial(const unsigned char *serial);
+
     static void _receivedData(void *target, WirelessDevice *sender, void *parameter);
-    static void ChatPadTimerActionWrapper(OSObject *owner, IOTimerEventSource *sender);
+    static void _receivedMessage(void *target, WirelessDevice *sender, unsigned char *data, size_t length);
+
+    unsigned char packetBuffer[WIRELESS_PACKET_SIZE];
+    // Pointed at each report where it lies, so handleReport reads it without a copy
+    IOMemoryDescriptor *reportDescriptor;
+
+    // Created when the first ChatPad report arrives
+    WirelessChatPad *chatPad;
+    IOBufferMemoryDescriptor *chatPadBuffer;
+    int chatPadOffset;
+    void ChatPadConnect(void);
+    void ChatPadDisconnect(void);
 
-	IOTimerEventSource *serialTimer;
-    int serialTimerCount;
+    // Keeps an attached ChatPad awake, as the wired driver does, only
+    // running between ChatPadConnect and ChatPadDisconnect
+    IOTimerEventSource *chatPadTimer;
+    bool chatPadToggle;
+    void ChatPadCommand(unsigned char command);
+    void ChatPadKeepAlive(void);
+    static void _ChatPadKeepAlive(OSObject *owner, IOTimerEventSource *sender);
+
+    int ledMode;
 
     unsigned char battery;
+    WIRELESS_BATTERY_SAMPLE batteryHistory[WIRELESS_BATTERY_HISTORY];
+    int batteryHead, batteryCount;
+    int batteryPublished;
+    UInt64 batteryPublishTime;
+    UInt32 batteryUpdates, batterySuppressed;
+    void PublishBattery(UInt64 now);
+    bool PublishBatteryLevel(UInt64 now);
+    void UpdateBatteryHistory(void);
+
+    // Publishes battery figures outside the receive path, armed only while some are waiting
+    IOTimerEventSource *batteryTimer;
+    UInt64 batteryDeadline;
+    void ArmBatteryTimer(UInt64 now, UInt64 deadline);
+    void BatteryTimeout(void);
+    static void _BatteryTimeout(OSObject *owner, IOTimerEventSource *sender);
     char serialString[10];
 };
 
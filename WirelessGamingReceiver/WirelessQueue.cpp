@@ -0,0 +1,123 @@
+/*
+    MICE Xbox 360 Controller driver for Mac OS X
+    Copyright (C) 2006-2013 Colin Munro
+
+    WirelessQueue.cpp - per-controller queue of receiver messages
+
+    This file is part of Xbox360Controller.
+
+    Xbox360Controller is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    Xbox360Controller is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Foobar; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+#include <string.h>
+#include "WirelessQueue.h"
+
+void WirelessQueue::Reset(void)
+{
+    head = 0;
+    count = 0;
+    highWater = 0;
+    inputDropped = 0;
+    controlDropped = 0;
+}
+
+const WIRELESS_PACKET* WirelessQueue::At(int position) const
+{
+    return &packets[(head + position) % WIRELESS_QUEUE_MAX];
+}
+
+// Take a message out of the middle of the ring, keeping the others in order
+void WirelessQueue::Remove(int position)
+{
+    for (int i = position; i > 0; i--)
+        packets[(head + i) % WIRELESS_QUEUE_MAX] = packets[(head + i - 1) % WIRELESS_QUEUE_MAX];
+    head = (head + 1) % WIRELESS_QUEUE_MAX;
+    count--;
+}
+
+void WirelessQueue::Push(const unsigned char *data, int length, int limit, WIRELESS_OVERFLOW overflow)
+{
+    WIRELESS_PACKET *packet;
+    bool input = WirelessIsInput(data, length);
+
+    if ((length <= 0) || (length > WIRELESS_PACKET_SIZE))
+        return;
+    if (limit > WIRELESS_QUEUE_MAX)
+        limit = WIRELESS_QUEUE_MAX;
+
+    if (count >= limit)
+    {
+        int victim = -1;
+
+        // Control and status messages always displace an input report, regardless of policy
+        if (!input || (overflow == woDropOldestInput))
+        {
+            for (int i = 0; i < count; i++)
+            {
+                if (WirelessIsInput(At(i)->data, At(i)->length))
+                {
+                    victim = i;
+                    break;
+                }
+            }
+        }
+        if (victim != -1)
+        {
+            inputDropped++;
+        }
+        else if (input)
+        {
+            inputDropped++;
+            return;
+        }
+        else
+        {
+            // Nothing but control messages queued, so the oldest has to go
+            victim = 0;
+            controlDropped++;
+        }
+        Remove(victim);
+    }
+    packet = &packets[(head + count) % WIRELESS_QUEUE_MAX];
+    packet->length = (unsigned char)length;
+    memcpy(packet->data, data, length);
+    count++;
+    if ((unsigned int)count > highWater)
+        highWater = count;
+}
+
+int WirelessQueue::Pop(void *buffer, int length)
+{
+    const WIRELESS_PACKET *packet;
+
+    if (count == 0)
+        return 0;
+    packet = At(0);
+    if (length > packet->length)
+        length = packet->length;
+    memcpy(buffer, packet->data, length);
+    head = (head + 1) % WIRELESS_QUEUE_MAX;
+    count--;
+    return length;
+}
+
+bool WirelessQueue::IsInfoQueued(void) const
+{
+    for (int i = 0; i < count; i++)
+    {
+        if (WirelessIsInfo(At(i)->data, At(i)->length))
+            return true;
+    }
+    return false;
+}
@@ -0,0 +1,74 @@
+/*
+    MICE Xbox 360 Controller driver for Mac OS X
+    Copyright (C) 2006-2013 Colin Munro
+
+    WirelessQueue.h - per-controller queue of receiver messages
+
+    This file is part of Xbox360Controller.
+
+    Xbox360Controller is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    Xbox360Controller is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Foobar; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+#ifndef __WIRELESSQUEUE_H__
+#define __WIRELESSQUEUE_H__
+
+#include "protocol.h"
+
+// Messages held for a controller whose device is not draining them
+#define WIRELESS_QUEUE_DEFAULT      16
+#define WIRELESS_QUEUE_MAX          64
+
+// What to throw away when a controller's queue is full
+typedef enum WIRELESS_OVERFLOW {
+    woDropOldestInput,      // Replace the oldest input report
+    woDropNewestInput,      // Discard the incoming input report
+} WIRELESS_OVERFLOW;
+
+// A queued message, stored inline so queueing never allocates
+typedef struct WIRELESS_PACKET
+{
+    unsigned char length;
+    unsigned char data[WIRELESS_PACKET_SIZE];
+} WIRELESS_PACKET;
+
+// A ring of messages for one controller. Like protocol.h this uses no kernel
+// types, so the host tests run the same queueing as the receiver. The caller
+// does any locking
+class WirelessQueue
+{
+public:
+    void Reset(void);
+
+    // Add a message, making room according to the policy if limit are already waiting
+    void Push(const unsigned char *data, int length, int limit, WIRELESS_OVERFLOW overflow);
+    // Take the oldest message, returning the length copied or 0 if the queue is empty
+    int Pop(void *buffer, int length);
+
+    int Count(void) const { return count; }
+    bool IsInfoQueued(void) const;
+
+    // Statistics
+    unsigned int highWater;
+    unsigned int inputDropped;
+    unsigned int controlDropped;
+
+private:
+    const WIRELESS_PACKET* At(int position) const;
+    void Remove(int position);
+
+    WIRELESS_PACKET packets[WIRELESS_QUEUE_MAX];
+    int head, count;
+};
+
+#endif // __WIRELESSQUEUE_H__
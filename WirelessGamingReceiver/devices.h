@@ -26,5 +26,12 @@
 #define kIOWirelessDeviceType   "Wireless360Device"
 
 #define kIOWirelessBatteryLevel "BatteryLevel"
+#define kIOWirelessBatteryHistory "BatteryHistory"
+#define kIOWirelessBatteryUpdates "BatteryUpdates"
+#define kIOWirelessBatterySuppressed "BatterySuppressed"
+
+#define kIOWirelessStatistics   "WirelessStatistics"
+
+#define kIOWirelessSlot         "WirelessSlot"
 
 #endif // __DEVICES_H__
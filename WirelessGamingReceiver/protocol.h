@@ -0,0 +1,129 @@
+/*
+    MICE Xbox 360 Controller driver for Mac OS X
+    Copyright (C) 2006-2013 Colin Munro
+
+    protocol.h - layout of the messages sent by the wireless receiver
+
+    This file is part of Xbox360Controller.
+
+    Xbox360Controller is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    Xbox360Controller is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Foobar; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+#ifndef __PROTOCOL_H__
+#define __PROTOCOL_H__
+
+// Kept free of kernel headers, so anything that needs to produce or parse
+// the receiver's message stream can share it
+
+// Largest message the receiver sends on a controller pipe
+#define WIRELESS_PACKET_SIZE        32
+
+// Connection status, two bytes: WIRELESS_MSG_STATUS then the attached devices
+#define WIRELESS_MSG_STATUS         0x08
+#define WIRELESS_STATUS_LENGTH      2
+#define WIRELESS_STATUS_NONE        0x00
+#define WIRELESS_STATUS_CONTROLLER  0x80
+#define WIRELESS_STATUS_HEADSET     0x40
+
+// Everything else is a fixed size message, typed by its second byte
+#define WIRELESS_MSG_LENGTH         29
+#define WIRELESS_MSG_TYPE           1
+
+#define WIRELESS_TYPE_UPDATE        0x00    // Value update, kind at byte 3 and data from byte 4
+#define WIRELESS_TYPE_INPUT         0x01    // HID report from byte 4 when byte 3 is WIRELESS_INPUT_REPORT
+#define WIRELESS_TYPE_CHATPAD       0x02    // ChatPad report, by default at WIRELESS_CHATPAD_DATA
+#define WIRELESS_TYPE_INFO          0x0f    // Device info, sent once on connection
+
+#define WIRELESS_UPDATE_KIND        3
+#define WIRELESS_UPDATE_DATA        4
+#define WIRELESS_UPDATE_BATTERY     0x13
+
+#define WIRELESS_INPUT_REPORT       0xf0
+#define WIRELESS_INPUT_DATA         4
+#define WIRELESS_INPUT_LENGTH       5       // Length of the report, which includes its own header
+
+// Same five byte layout as the wired ChatPad's reports, a zero followed by modifiers and three keys.
+// UNVERIFIED: the offset comes from a single capture, so the driver lets its personality override it
+#define WIRELESS_CHATPAD_DATA       24
+#define WIRELESS_CHATPAD_LENGTH     5
+
+#define WIRELESS_INFO_SERIAL        0x0a    // Four bytes of serial number
+#define WIRELESS_INFO_KIND          16      // Optional value update carried with the info
+#define WIRELESS_INFO_DATA          17
+
+// Output commands
+#define WIRELESS_POWEROFF           0x00, 0x00, 0x08, 0xC0, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00
+
+// ChatPad control, 0x0C then a command. UNVERIFIED: 0x0C comes from the same single capture,
+// and the commands are the ones the wired controller takes as vendor requests, on the assumption
+// that the controller passes them on to the ChatPad the same way. The init wakes it up, and it
+// goes back to sleep without a keep-alive every second
+#define WIRELESS_CHATPAD(c)         0x00, 0x00, 0x0C, (c), 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00
+#define WIRELESS_CHATPAD_INIT       0x1B
+#define WIRELESS_CHATPAD_KEEPALIVE1 0x1F    // Alternated with the next
+#define WIRELESS_CHATPAD_KEEPALIVE2 0x1E
+#define WIRELESS_CHATPAD_INTERVAL   1000    // ms
+
+// Commands that set a state, so only the newest one waiting to be sent matters
+#define WIRELESS_IS_LED(b)          (((b)[2] == 0x08) && (((b)[3] & 0xC0) == 0x40))
+#define WIRELESS_IS_RUMBLE(b)       (((b)[1] == 0x01) && ((b)[2] == 0x0f))
+
+// Connection status change
+static inline bool WirelessIsStatus(const unsigned char *data, int length)
+{
+    return (length == WIRELESS_STATUS_LENGTH) && (data[0] == WIRELESS_MSG_STATUS);
+}
+
+// Input report, which is superseded by the next one
+static inline bool WirelessIsInput(const unsigned char *data, int length)
+{
+    return (length > WIRELESS_MSG_TYPE) && (data[WIRELESS_MSG_TYPE] == WIRELESS_TYPE_INPUT);
+}
+
+// Find the HID report in an input message, or NULL if it is not one or its
+// length byte claims more than arrived
+static inline const unsigned char* WirelessInputReport(const unsigned char *data, int length, int *reportLength)
+{
+    int report;
+
+    if ((length < WIRELESS_INPUT_DATA + 2) || (data[WIRELESS_MSG_TYPE] != WIRELESS_TYPE_INPUT)
+        || (data[WIRELESS_UPDATE_KIND] != WIRELESS_INPUT_REPORT))
+        return 0;
+    report = data[WIRELESS_INPUT_LENGTH];
+    if ((report < 2) || (report > length - WIRELESS_INPUT_DATA))
+        return 0;
+    *reportLength = report;
+    return data + WIRELESS_INPUT_DATA;
+}
+
+// Find the key report in a ChatPad message with the report at offset, or NULL if it is
+// not one or the offset does not leave room for it
+static inline const unsigned char* WirelessChatPadReport(const unsigned char *data, int length, int offset)
+{
+    if ((length <= WIRELESS_MSG_TYPE) || (data[WIRELESS_MSG_TYPE] != WIRELESS_TYPE_CHATPAD))
+        return 0;
+    if ((offset <= WIRELESS_MSG_TYPE) || (offset > length - WIRELESS_CHATPAD_LENGTH))
+        return 0;
+    if (data[offset] != 0x00)
+        return 0;
+    return data + offset;
+}
+
+// Device info, which a controller sends before it is usable
+static inline bool WirelessIsInfo(const unsigned char *data, int length)
+{
+    return (length > WIRELESS_MSG_TYPE) && (data[WIRELESS_MSG_TYPE] == WIRELESS_TYPE_INFO);
+}
+
+#endif // __PROTOCOL_H__
@@ -8,8 +8,10 @@
 
 #include <ForceFeedback/IOForceFeedbackLib.h>
 #include <IOKit/IOCFPlugIn.h>
+#include <IOKit/hid/IOHIDUsageTables.h>
 #include "FFDriver.h"
 #include "XBoxOneBTHID.h"
+#include "XboxOnePulse.h"
 #include <mach/mach.h>
 #include <mach/mach_time.h>
 using std::max;
@@ -41,8 +43,6 @@ static bool goodProbe(io_service_t theService)
 	return true;
 }
 
-#define LoopGranularity 10000 // Microseconds
-
 double CurrentTimeUsingMach()
 {
 	static mach_timebase_info_data_t info = {0};
@@ -99,11 +99,9 @@ static IOForceFeedbackDeviceInterface functionMapXBOBT_IOForceFeedbackDeviceInte
 	&FeedbackXBOBT::sStopEffect
 };
 
-FeedbackXBOBT::FeedbackXBOBT() : fRefCount(1),  EffectIndex(1), Stopped(true),
-Paused(false), PausedTime(0), LastTime(0), Gain(10000), PrvLeftLevel(0),
-PrvRightLevel(0), Actuator(true), Manual(false)
+FeedbackXBOBT::FeedbackXBOBT() : fRefCount(1), Engine(this), Manual(false), ButtonList(NULL)
 {
-	EffectList = FeedbackXBOEffectVector();
+	memset(ButtonElement, 0, sizeof(ButtonElement));
 	
 	iIOCFPlugInInterface.pseudoVTable = (IUnknownVTbl *) &functionMapXBOBT_IOCFPlugInInterface;
 	iIOCFPlugInInterface.obj = this;
@@ -195,233 +193,27 @@ IOReturn FeedbackXBOBT::Stop(void)
 
 HRESULT FeedbackXBOBT::SetProperty(FFProperty property, void *value)
 {
-	if(property != FFPROP_FFGAIN) {
-		return FFERR_UNSUPPORTED;
-	}
-	
-	UInt32 NewGain = *((UInt32*)value);
-	__block HRESULT Result = FF_OK;
-	
-	dispatch_sync(Queue, ^{
-		if (1 <= NewGain && NewGain <= 10000)
-		{
-			Gain = NewGain;
-		} else {
-			Gain = max((UInt32)1, min(NewGain, (UInt32)10000));
-			Result = FF_TRUNCATED;
-		}
-	});
-	
-	return Result;
+	return Engine.SetProperty(property, value);
 }
 
 HRESULT FeedbackXBOBT::StartEffect(FFEffectDownloadID EffectHandle, FFEffectStartFlag Mode, UInt32 Count)
 {
-	dispatch_sync(Queue, ^{
-		for (FeedbackXBOEffectIterator effectIterator = EffectList.begin() ; effectIterator != EffectList.end(); ++effectIterator)
-		{
-			if (effectIterator->Handle == EffectHandle)
-			{
-				effectIterator->Status  = FFEGES_PLAYING;
-				effectIterator->PlayCount = Count;
-				effectIterator->StartTime = CurrentTimeUsingMach();
-				Stopped = false;
-			} else {
-				if (Mode & FFES_SOLO) {
-					effectIterator->Status = NULL;
-				}
-			}
-		}
-	});
-	return FF_OK;
+	return Engine.StartEffect(EffectHandle, Mode, Count);
 }
 
 HRESULT FeedbackXBOBT::StopEffect(UInt32 EffectHandle)
 {
-	dispatch_sync(Queue, ^{
-		for (FeedbackXBOEffectIterator effectIterator = EffectList.begin() ; effectIterator != EffectList.end(); ++effectIterator)
-		{
-			if (effectIterator->Handle == EffectHandle)
-			{
-				effectIterator->Status = NULL;
-				break;
-			}
-		}
-	});
-	return FF_OK;
+	return Engine.StopEffect(EffectHandle);
 }
 
 HRESULT FeedbackXBOBT::DownloadEffect(CFUUIDRef EffectType, FFEffectDownloadID *EffectHandle, FFEFFECT *DiEffect, FFEffectParameterFlag Flags)
 {
-	__block HRESULT Result = FF_OK;
-	
-	if (Flags & FFEP_NODOWNLOAD)
-	{
-		return FF_OK;
-	}
-	
-	dispatch_sync(Queue, ^{
-		FeedbackXBOEffect *Effect = NULL;
-		if (*EffectHandle == 0) {
-			EffectList.push_back(FeedbackXBOEffect(EffectIndex++));
-			Effect = &(EffectList.back());
-			*EffectHandle = Effect->Handle;
-		} else {
-			for (LONG Index = 0; Index < EffectList.size(); Index++) {
-				if (EffectList[Index].Handle == *EffectHandle) {
-					Effect = &(EffectList[Index]);
-					break;
-				}
-			}
-		}
-		
-		if (Effect == NULL || Result == -1) {
-			Result = FFERR_INTERNAL;
-		}
-		else {
-			Effect->Type = EffectType;
-			Effect->DiEffect.dwFlags = DiEffect->dwFlags;
-			
-			if( Flags & FFEP_DURATION )
-			{
-				Effect->DiEffect.dwDuration = DiEffect->dwDuration;
-			}
-			
-			if( Flags & FFEP_SAMPLEPERIOD )
-			{
-				Effect->DiEffect.dwSamplePeriod = DiEffect->dwSamplePeriod;
-			}
-			
-			if( Flags & FFEP_GAIN )
-			{
-				Effect->DiEffect.dwGain = DiEffect->dwGain;
-			}
-			
-			if( Flags & FFEP_TRIGGERBUTTON )
-			{
-				Effect->DiEffect.dwTriggerButton = DiEffect->dwTriggerButton;
-			}
-			
-			if( Flags & FFEP_TRIGGERREPEATINTERVAL )
-			{
-				Effect->DiEffect.dwTriggerRepeatInterval = DiEffect->dwTriggerRepeatInterval;
-			}
-			
-			if( Flags & FFEP_AXES )
-			{
-				Effect->DiEffect.cAxes  = DiEffect->cAxes;
-				Effect->DiEffect.rgdwAxes = NULL;
-			}
-			
-			if( Flags & FFEP_DIRECTION )
-			{
-				Effect->DiEffect.cAxes   = DiEffect->cAxes;
-				Effect->DiEffect.rglDirection = NULL;
-			}
-			
-			if( ( Flags & FFEP_ENVELOPE ) && DiEffect->lpEnvelope != NULL )
-			{
-				memcpy( &Effect->DiEnvelope, DiEffect->lpEnvelope, sizeof( FFENVELOPE ) );
-				if( Effect->DiEffect.dwDuration - Effect->DiEnvelope.dwFadeTime
-				   < Effect->DiEnvelope.dwAttackTime )
-				{
-					Effect->DiEnvelope.dwFadeTime = Effect->DiEnvelope.dwAttackTime;
-				}
-				Effect->DiEffect.lpEnvelope = &Effect->DiEnvelope;
-			}
-			
-			Effect->DiEffect.cbTypeSpecificParams = DiEffect->cbTypeSpecificParams;
-			
-			if( Flags & FFEP_TYPESPECIFICPARAMS )
-			{
-				if(CFEqual(EffectType, kFFEffectType_CustomForce_ID)) {
-					memcpy(
-						   &Effect->DiCustomForce
-						   ,DiEffect->lpvTypeSpecificParams
-						   ,DiEffect->cbTypeSpecificParams );
-					Effect->DiEffect.lpvTypeSpecificParams = &Effect->DiCustomForce;
-				}
-				
-				else if(CFEqual(EffectType, kFFEffectType_ConstantForce_ID)) {
-					memcpy(
-						   &Effect->DiConstantForce
-						   ,DiEffect->lpvTypeSpecificParams
-						   ,DiEffect->cbTypeSpecificParams );
-					Effect->DiEffect.lpvTypeSpecificParams = &Effect->DiConstantForce;
-				}
-				else if(CFEqual(EffectType, kFFEffectType_Square_ID) || CFEqual(EffectType, kFFEffectType_Sine_ID) || CFEqual(EffectType, kFFEffectType_Triangle_ID) || CFEqual(EffectType, kFFEffectType_SawtoothUp_ID) || CFEqual(EffectType, kFFEffectType_SawtoothDown_ID) ) {
-					memcpy(
-						   &Effect->DiPeriodic
-						   ,DiEffect->lpvTypeSpecificParams
-						   ,DiEffect->cbTypeSpecificParams );
-					Effect->DiEffect.lpvTypeSpecificParams = &Effect->DiPeriodic;
-				}
-				else if(CFEqual(EffectType, kFFEffectType_RampForce_ID)) {
-					memcpy(
-						   &Effect->DiRampforce
-						   ,DiEffect->lpvTypeSpecificParams
-						   ,DiEffect->cbTypeSpecificParams );
-					Effect->DiEffect.lpvTypeSpecificParams = &Effect->DiRampforce;
-				}
-			}
-			
-			if( Flags & FFEP_STARTDELAY )
-			{
-				Effect->DiEffect.dwStartDelay = DiEffect->dwStartDelay;
-			}
-			
-			if( Flags & FFEP_START )
-			{
-				Effect->Status  = FFEGES_PLAYING;
-				Effect->PlayCount = 1;
-				Effect->StartTime = CurrentTimeUsingMach();
-			}
-			
-			if( Flags & FFEP_NORESTART )
-			{
-				;
-			}
-			Result = FF_OK;
-		}
-	});
-	return Result;
+	return Engine.DownloadEffect(EffectType, EffectHandle, DiEffect, Flags);
 }
 
 HRESULT FeedbackXBOBT::GetForceFeedbackState(ForceFeedbackDeviceState *DeviceState)
 {
-	if (DeviceState->dwSize != sizeof(FFDEVICESTATE))
-	{
-		return FFERR_INVALIDPARAM;
-	}
-	
-	dispatch_sync(Queue, ^{
-		DeviceState->dwState = NULL;
-		if( EffectList.size() == 0 )
-		{
-			DeviceState->dwState |= FFGFFS_EMPTY;
-		}
-		if( Stopped == true )
-		{
-			DeviceState->dwState |= FFGFFS_STOPPED;
-		}
-		if( Paused == true )
-		{
-			DeviceState->dwState |= FFGFFS_PAUSED;
-		}
-		if (Actuator == true)
-		{
-			DeviceState->dwState |= FFGFFS_ACTUATORSON;
-		} else {
-			DeviceState->dwState |= FFGFFS_ACTUATORSOFF;
-		}
-		DeviceState->dwState |= FFGFFS_POWERON;
-		DeviceState->dwState |= FFGFFS_SAFETYSWITCHOFF;
-		DeviceState->dwState |= FFGFFS_USERFFSWITCHON;
-		
-		DeviceState->dwLoad  = 0;
-	});
-	
-	return FF_OK;
+	return Engine.GetForceFeedbackState(DeviceState);
 }
 
 HRESULT FeedbackXBOBT::GetForceFeedbackCapabilities(FFCAPABILITIES *capabilities)
@@ -457,53 +249,7 @@ HRESULT FeedbackXBOBT::GetForceFeedbackCapabilities(FFCAPABILITIES *capabilities
 
 HRESULT FeedbackXBOBT::SendForceFeedbackCommand(FFCommandFlag state)
 {
-	__block HRESULT Result = FF_OK;
-	
-	dispatch_sync(Queue, ^{
-		switch (state) {
-			case FFSFFC_RESET:
-				EffectList.clear();
-				Stopped = true;
-				Paused = false;
-				break;
-				
-			case FFSFFC_STOPALL:
-				for (FeedbackXBOEffectIterator effectIterator = EffectList.begin() ; effectIterator != EffectList.end(); ++effectIterator)
-				{
-					effectIterator->Status = NULL;
-				}
-				Stopped = true;
-				Paused = false;
-				break;
-				
-			case FFSFFC_PAUSE:
-				Paused  = true;
-				PausedTime = CurrentTimeUsingMach();
-				break;
-				
-			case FFSFFC_CONTINUE:
-				for (FeedbackXBOEffectIterator effectIterator = EffectList.begin() ; effectIterator != EffectList.end(); ++effectIterator)
-				{
-					effectIterator->StartTime += ( CurrentTimeUsingMach() - PausedTime );
-				}
-				Paused = false;
-				break;
-				
-			case FFSFFC_SETACTUATORSON:
-				Actuator = true;
-				break;
-				
-			case FFSFFC_SETACTUATORSOFF:
-				Actuator = false;
-				break;
-				
-			default:
-				Result = FFERR_INVALIDPARAM;
-				break;
-		}
-	});
-	//return Result;
-	return FF_OK;
+	return Engine.SendForceFeedbackCommand(state);
 }
 
 HRESULT FeedbackXBOBT::InitializeTerminate(NumVersion APIversion, io_object_t hidDevice, boolean_t begin)
@@ -527,17 +273,28 @@ HRESULT FeedbackXBOBT::InitializeTerminate(NumVersion APIversion, io_object_t hi
 			return FFERR_NOINTERFACE;
 		}
 		IOHIDDeviceOpen(this->device, 0);
-		Queue = dispatch_queue_create("com.mice.driver.FeedbackXBOBT", NULL);
-		Timer = dispatch_source_create(DISPATCH_SOURCE_TYPE_TIMER, 0, 0, Queue);
-		dispatch_source_set_timer(Timer, dispatch_walltime(NULL, 0), LoopGranularity*1000, 10);
-		dispatch_set_context(Timer, this);
-		dispatch_source_set_event_handler_f(Timer, EffectProc);
-		dispatch_resume(Timer);
+		ButtonList = IOHIDDeviceCopyMatchingElements(this->device, NULL, kIOHIDOptionsTypeNone);
+		if (ButtonList) {
+			for (CFIndex i = 0; i < CFArrayGetCount(ButtonList); i++) {
+				IOHIDElementRef element = (IOHIDElementRef)CFArrayGetValueAtIndex(ButtonList, i);
+				uint32_t usage = IOHIDElementGetUsage(element);
+				if (IOHIDElementGetUsagePage(element) == kHIDPage_Button && 1 <= usage && usage <= 32) {
+					ButtonElement[usage - 1] = element;
+				}
+			}
+		}
+		Engine.Start("com.mice.driver.FeedbackXBOBT");
+		Engine.SetRampStep(RAMP_STEP);
 	}
 	else {
-		dispatch_sync(Queue, ^{
-			dispatch_source_cancel(Timer);
-			SetForce(0, 0, 0, 0);
+		Engine.Terminate(^{
+			LONG Off[4] = {0, 0, 0, 0};
+			SetForce(Off);
+			memset(ButtonElement, 0, sizeof(ButtonElement));
+			if (ButtonList) {
+				CFRelease(ButtonList);
+				ButtonList = NULL;
+			}
 			IOHIDDeviceClose(this->device, 0);
 			CFRelease(this->device);
 		});
@@ -548,24 +305,15 @@ HRESULT FeedbackXBOBT::InitializeTerminate(NumVersion APIversion, io_object_t hi
 
 HRESULT FeedbackXBOBT::DestroyEffect(FFEffectDownloadID EffectHandle)
 {
-	__block HRESULT Result = FF_OK;
-	dispatch_sync(Queue, ^{
-		for (FeedbackXBOEffectIterator effectIterator = EffectList.begin() ; effectIterator != EffectList.end(); ++effectIterator)
-		{
-			if (effectIterator->Handle == EffectHandle)
-			{
-				EffectList.erase(effectIterator);
-				break;
-			}
-		}
-	});
-	return Result;
+	return Engine.DestroyEffect(EffectHandle);
 }
 
 HRESULT FeedbackXBOBT::Escape(FFEffectDownloadID downloadID, FFEFFESCAPE *escape)
 {
-	if (downloadID!=0) return FFERR_UNSUPPORTED;
 	if (escape->dwSize < sizeof(FFEFFESCAPE)) return FFERR_INVALIDPARAM;
+	if (downloadID!=0) return Engine.EffectEscape(downloadID, escape);
+	// Room the caller left for output, cbOutBuffer then says how much was used
+	DWORD OutSize = escape->cbOutBuffer;
 	escape->cbOutBuffer=0;
 	switch (escape->dwCommand) {
 #if 0
@@ -607,6 +355,30 @@ HRESULT FeedbackXBOBT::Escape(FFEffectDownloadID downloadID, FFEFFESCAPE *escape
 		}
 			break;
 #endif
+		case 0x04:  // Set tick period, in microseconds
+			if (escape->cbInBuffer!=sizeof(UInt32)) return FFERR_INVALIDPARAM;
+			Engine.SetTickPeriod(*(UInt32 *)escape->lpvInBuffer);
+			break;
+			
+		case 0x06:  // Set mixer knee, 0 to 10000
+			if (escape->cbInBuffer!=sizeof(UInt32)) return FFERR_INVALIDPARAM;
+			Engine.SetKnee((LONG)min(*(UInt32 *)escape->lpvInBuffer, (UInt32)LEVEL_MAX));
+			break;
+			
+		case 0x07:  // Set motor response curve
+			if (escape->cbInBuffer!=sizeof(Feedback360Curve)) return FFERR_INVALIDPARAM;
+			return Engine.SetCurve((Feedback360Curve *)escape->lpvInBuffer);
+			
+		case 0x08:  // Get effect loop statistics
+			if (escape->lpvOutBuffer == NULL || OutSize < sizeof(Feedback360EngineStats)) return FFERR_INVALIDPARAM;
+			Engine.GetStats((Feedback360EngineStats *)escape->lpvOutBuffer);
+			escape->cbOutBuffer = sizeof(Feedback360EngineStats);
+			break;
+			
+		case 0x09:  // Log effect loop statistics
+			Engine.LogStats("XboxOneBTController FF plugin");
+			break;
+			
 		default:
 			fprintf(stderr, "XboxOneBTController FF plugin: Unknown escape (%i)\n", (int)escape->dwCommand);
 			return FFERR_UNSUPPORTED;
@@ -614,18 +386,35 @@ HRESULT FeedbackXBOBT::Escape(FFEffectDownloadID downloadID, FFEFFESCAPE *escape
 	return FF_OK;
 }
 
-void FeedbackXBOBT::SetForce(LONG LeftLevel, LONG RightLevel, LONG ltLevel, LONG rtLevel)
+void FeedbackXBOBT::SetForce(const LONG *Levels)
+{
+	//fprintf(stderr, "LS: %d; RS: %d\n", Levels[0], Levels[1]);
+	// Outlasts any gap between ticks, the next report takes over
+	SendReport(Levels, 0x7f, 0, 10);
+}
+
+double FeedbackXBOBT::SetPulse(const LONG *Levels, double On, double Off, double Duration)
+{
+	XboxOnePulse Pulse;
+	double Covered = XboxOnePulseEncode(On, Off, Duration, &Pulse);
+	if (Covered > 0) {
+		SendReport(Levels, Pulse.Duration, Pulse.Delay, Pulse.Loops);
+	}
+	return Covered;
+}
+
+void FeedbackXBOBT::SendReport(const LONG *Levels, UInt32 Duration, UInt32 Delay, UInt32 Loops)
 {
-	//fprintf(stderr, "LS: %d; RS: %d\n", (unsigned char)MIN( 255, LeftLevel * Gain / 10000 ), (unsigned char)MIN( 255, RightLevel * Gain / 10000 ));
 	XboxOneBluetoothReport_t report = {0};
 	report.reportID = 0x03;
 	report.activationMask = 0x0f;
-	report.ltMagnitude = (unsigned char)min(SCALE_MAX, ltLevel * (LONG)Gain / 10000 );
-	report.rtMagnitude = (unsigned char)min(SCALE_MAX, rtLevel * (LONG)Gain / 10000 );
-	report.leftMagnitude = (unsigned char)min(SCALE_MAX, LeftLevel * (LONG)Gain / 10000 );
-	report.rightMagnitude = (unsigned char)min(SCALE_MAX, RightLevel * (LONG)Gain / 10000 );
-	report.duration = 0x7f;
-	report.loopCount = 10;
+	report.ltMagnitude = (unsigned char)Levels[2];
+	report.rtMagnitude = (unsigned char)Levels[3];
+	report.leftMagnitude = (unsigned char)Levels[0];
+	report.rightMagnitude = (unsigned char)Levels[1];
+	report.duration = (uint8_t)Duration;
+	report.startDelay = (uint8_t)Delay;
+	report.loopCount = (uint8_t)Loops;
 
 	if (!Manual) {
 		IOReturn retVal = IOHIDDeviceSetReport(device, kIOHIDReportTypeOutput, report.reportID, (const uint8_t*)&report, sizeof(XboxOneBluetoothReport_t));
@@ -635,50 +424,33 @@ void FeedbackXBOBT::SetForce(LONG LeftLevel, LONG RightLevel, LONG ltLevel, LONG
 	}
 }
 
-void FeedbackXBOBT::EffectProc( void *params )
+bool FeedbackXBOBT::ReadStick(SInt32 *X, SInt32 *Y)
 {
-	FeedbackXBOBT *cThis = (FeedbackXBOBT *)params;
-	
-	LONG LeftLevel = 0;
-	LONG RightLevel = 0;
-	LONG ltLevel = 0;
-	LONG rtLevel = 0;
-	LONG Gain  = cThis->Gain;
-	LONG CalcResult = 0;
-	
-	if (cThis->Actuator == true)
-	{
-		for (FeedbackXBOEffectIterator effectIterator = cThis->EffectList.begin(); effectIterator != cThis->EffectList.end(); ++effectIterator)
-		{
-			if(((CurrentTimeUsingMach() - cThis->LastTime)*1000*1000) >= effectIterator->DiEffect.dwSamplePeriod) {
-				CalcResult = effectIterator->Calc(&LeftLevel, &RightLevel, &ltLevel, &rtLevel);
-			}
+	// Condition effects are not offered on this controller
+	return false;
+}
+
+bool FeedbackXBOBT::ReadButtons(UInt32 *Buttons)
+{
+	*Buttons = 0;
+	for (int i = 0; i < 32; i++) {
+		if (ButtonElement[i] == NULL) {
+			continue;
+		}
+		IOHIDValueRef value = NULL;
+		if (IOHIDDeviceGetValue(device, ButtonElement[i], &value) != kIOReturnSuccess || value == NULL) {
+			return false;
+		}
+		if (IOHIDValueGetIntegerValue(value) != 0) {
+			*Buttons |= 1u << i;
 		}
 	}
-	
-	if ((cThis->PrvLeftLevel != LeftLevel || cThis->PrvRightLevel != RightLevel) && (CalcResult != -1))
-	{
-		//fprintf(stderr, "PL: %d, PR: %d; L: %d, R: %d; \n", cThis->PrvLeftLevel, cThis->PrvRightLevel, LeftLevel, RightLevel);
-		cThis->SetForce((unsigned char)min(SCALE_MAX, LeftLevel * Gain / 10000),(unsigned char)min(SCALE_MAX, RightLevel * Gain / 10000 ), (unsigned char)min(SCALE_MAX, ltLevel * Gain / 10000), (unsigned char)min(SCALE_MAX, rtLevel * Gain / 10000));
-		
-		cThis->PrvLeftLevel = LeftLevel;
-		cThis->PrvRightLevel = RightLevel;
-	}
+	return true;
 }
 
 HRESULT FeedbackXBOBT::GetEffectStatus(FFEffectDownloadID EffectHandle, FFEffectStatusFlag *Status)
 {
-	dispatch_sync(Queue, ^{
-		for (FeedbackXBOEffectIterator effectIterator = EffectList.begin() ; effectIterator != EffectList.end(); ++effectIterator)
-		{
-			if (effectIterator->Handle == EffectHandle)
-			{
-				*Status = effectIterator->Status;
-				break;
-			}
-		}
-	});
-	return FF_OK;
+	return Engine.GetEffectStatus(EffectHandle, Status);
 }
 
 HRESULT FeedbackXBOBT::GetVersion(ForceFeedbackVersion *version)
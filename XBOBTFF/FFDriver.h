@@ -13,8 +13,7 @@
 #include <CoreFoundation/CFPlugInCOM.h>
 #include <ForceFeedback/IOForceFeedbackLib.h>
 #include <IOKit/hid/IOHIDLib.h>
-#include <vector>
-#include "FeedbackXBOEffect.hpp"
+#include "../Feedback360/Feedback360Engine.h"
 
 // 0F793F56-8C17-4BA0-9201-D52FEC6C2702
 #define BTFFPLUGINTERFACE CFUUIDGetConstantUUIDWithBytes(kCFAllocatorSystemDefault, 0x0F, 0x79, 0x3F, 0x56, 0x8C, 0x17, 0x4B, 0xA0, 0x92, 0x01, 0xD5, 0x2F, 0xEC, 0x6C, 0x27, 0x02)
@@ -24,6 +23,9 @@
 #define FeedbackDriverVersionStage      developStage
 #define FeedbackDriverVersionNonRelRev  0
 
+#define SCALE_MAX (LONG)101
+#define RAMP_STEP 40000 // Envelope stairs in microseconds, each one a held pulse
+
 class FeedbackXBOBT : IUnknown
 {
 public:
@@ -75,8 +77,9 @@ public:
     virtual ULONG   Release(void);
     
 private:
-    typedef std::vector<FeedbackXBOEffect> FeedbackXBOEffectVector;
-    typedef FeedbackXBOEffectVector::iterator FeedbackXBOEffectIterator;
+    // Left and right rumble, then the left and right trigger motors
+    typedef Feedback360Engine<FeedbackXBOBT, 4, SCALE_MAX> FeedbackXBOEngine;
+    friend class Feedback360EngineCore<FeedbackXBOBT, 4, SCALE_MAX>;
     // helper function
     static inline FeedbackXBOBT *getThis (void *self) { return (FeedbackXBOBT *) ((XboxOneBTInterfaceMap *) self)->obj; }
     
@@ -84,30 +87,22 @@ private:
     XboxOneBTInterfaceMap iIOCFPlugInInterface;
     XboxOneBTInterfaceMap iIOForceFeedbackDeviceInterface;
     IOHIDDeviceRef      device;
-    
-    // GCD queue and timer
-    dispatch_queue_t    Queue;
-    dispatch_source_t   Timer;
+    CFArrayRef          ButtonList;         // Keeps the elements below alive
+    IOHIDElementRef     ButtonElement[32];  // Buttons 1 to 32, NULL if not found
     
     // effects handling
-    FeedbackXBOEffectVector EffectList;
-    UInt32              EffectIndex;
-    
-    DWORD   Gain;
-    bool    Actuator;
+    FeedbackXBOEngine   Engine;
     
-    LONG            PrvLeftLevel, PrvRightLevel;
-    bool            Stopped;
-    bool            Paused;
     bool            Manual;
-    double          LastTime;
-    double          PausedTime;
     CFUUIDRef       FactoryID;
     
-    void            SetForce(LONG LeftLevel, LONG RightLevel, LONG ltLevel, LONG rtLevel);
-    
-    // event loop func
-    static void EffectProc( void *params );
+    // Called by Engine on its queue
+    void            SetForce(const LONG *Levels);
+    double          SetPulse(const LONG *Levels, double On, double Off, double Duration);
+    bool            ReadStick(SInt32 *X, SInt32 *Y);
+    bool            ReadButtons(UInt32 *Buttons);
+
+    void            SendReport(const LONG *Levels, UInt32 Duration, UInt32 Delay, UInt32 Loops);
     
     // actual member functions ultimately called by the FF API (through the static functions)
     virtual IOReturn Probe ( CFDictionaryRef propertyTable, io_service_t service, SInt32 * order );
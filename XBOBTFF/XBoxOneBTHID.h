@@ -28,9 +28,9 @@ struct XboxOneBluetoothReport_t {
 	uint8_t				rtMagnitude;
 	uint8_t				leftMagnitude;
 	uint8_t				rightMagnitude;
-	uint8_t				duration;		//!< time in ms, 255 = 2.55s
-	uint8_t				startDelay;
-	uint8_t				loopCount;
+	uint8_t				duration;		//!< on time in 10 ms units, 255 = 2.55s
+	uint8_t				startDelay;		//!< off time after each on time, same units
+	uint8_t				loopCount;		//!< repeats after the first on and off
 };
 
 #pragma pack(pop)
@@ -0,0 +1,67 @@
+/*
+    MICE Xbox 360 Controller driver for Mac OS X
+    Force Feedback module
+    Copyright (C) 2013 David Ryskalczyk
+
+    XboxOnePulse.cpp - timing of the Bluetooth controller's rumble reports
+
+    This file is part of Xbox360Controller.
+
+    Xbox360Controller is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    Xbox360Controller is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Xbox360Controller; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+
+#include <algorithm>
+#include <math.h>
+#include "XboxOnePulse.h"
+using std::min;
+
+double XboxOnePulseEncode(double On, double Off, double Duration, XboxOnePulse *Pulse)
+{
+	// The controller counts in 10 ms units, up to 255 each for the on and
+	// off times, and plays the pair loopCount + 1 times
+	if (Off == 0) {
+		// Held levels, spread over as few pulses as it takes. One unit over,
+		// so the next report lands before the motors stop.
+		double Units = min(ceil(Duration * 100) + 1, 255. * 256);
+		UInt32 Loops = (UInt32)ceil(Units / 255);
+		UInt32 Length = (UInt32)ceil(Units / Loops);
+		Pulse->Duration = Length;
+		Pulse->Delay = 0;
+		Pulse->Loops = Loops - 1;
+		return min(Duration, (Length * Loops - 1) / 100.);
+	}
+
+	UInt32 OnUnits = (UInt32)lround(On * 100);
+	UInt32 OffUnits = (UInt32)lround(Off * 100);
+	if (OnUnits == 0 || OffUnits == 0 || OnUnits > 255 || OffUnits > 255) {
+		return 0;
+	}
+	// Whole units drift from the wave a little every cycle, so only hand
+	// over as many cycles as stay within half a unit of it
+	double Cycle = On + Off;
+	double Drift = fabs((OnUnits + OffUnits) / 100. - Cycle);
+	double Cycles = min(floor(Duration / Cycle), 256.);
+	if (Drift > 0) {
+		Cycles = min(Cycles, floor(0.005 / Drift));
+	}
+	if (Cycles < 2) {
+		return 0;
+	}
+	Pulse->Duration = OnUnits;
+	Pulse->Delay = OffUnits;
+	Pulse->Loops = (UInt32)Cycles - 1;
+	return Cycles * (OnUnits + OffUnits) / 100.;
+}
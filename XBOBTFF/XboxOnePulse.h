@@ -0,0 +1,45 @@
+/*
+    MICE Xbox 360 Controller driver for Mac OS X
+    Force Feedback module
+    Copyright (C) 2013 David Ryskalczyk
+
+    XboxOnePulse.h - timing of the Bluetooth controller's rumble reports
+
+    This file is part of Xbox360Controller.
+
+    Xbox360Controller is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    Xbox360Controller is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Xbox360Controller; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+
+#ifndef XboxOnePulse_h
+#define XboxOnePulse_h
+
+#include "../Feedback360/Feedback360Types.h"
+
+// The timing fields of a rumble report, in the controller's 10 ms units. The
+// controller plays the levels for Duration, then nothing for Delay, and
+// plays that pair Loops + 1 times.
+typedef struct {
+	UInt32	Duration;
+	UInt32	Delay;
+	UInt32	Loops;
+} XboxOnePulse;
+
+// Works out the report for Feedback360Engine's SetPulse, with On, Off and
+// Duration in seconds. Returns how long the controller then plays without
+// another report, or 0 when it can't follow the wave and SetForce is needed.
+double XboxOnePulseEncode(double On, double Off, double Duration, XboxOnePulse *Pulse);
+
+#endif